@@ -527,6 +527,22 @@ void glTexImage1D(GLint target, GLint level, GLint components, GLint width, GLin
 	gl_add_op(p);
 }
 
+void glTexSubImage2D(GLint target, GLint level, GLint xoffset, GLint yoffset, GLint width, GLint height, GLint format, GLint type, void* pixels) {
+	GLParam p[10];
+#include "error_check_no_context.h"
+	p[0].op = OP_TexSubImage2D;
+	p[1].i = target;
+	p[2].i = level;
+	p[3].i = xoffset;
+	p[4].i = yoffset;
+	p[5].i = width;
+	p[6].i = height;
+	p[7].i = format;
+	p[8].i = type;
+	p[9].p = pixels;
+	gl_add_op(p);
+}
+
 void glBindTexture(GLint target, GLint texture) {
 	GLParam p[3];
 #include "error_check_no_context.h"
@@ -632,7 +648,9 @@ void glCallList(GLuint list) {
 
 	gl_add_op(p);
 }
-void glFlush(void) { /* nothing to do */
+void glFlush(void) {
+	/* rasterize binned triangles */
+	ZB_flushTiles(gl_get_context()->zb);
 }
 
 void glHint(GLint target, GLint mode) {
@@ -6,18 +6,20 @@
 
 static GLint free_buffer(GLint handle) {
 	GLContext* c = gl_get_context();
-	GLSharedState* s = &(c->shared_state);
+	GLSharedState* s = c->shared_state;
+	GLBuffer* buf;
 	if (handle == 0 || handle > MAX_BUFFERS)
 		return 1; 
 
 	handle--;
-	if (s->buffers[handle]) { 
+	buf = gl_table_get(&s->buffers, handle);
+	if (buf) { 
 		if (c->boundarraybuffer == (handle + 1))
 			c->boundarraybuffer = 0;
-		if (s->buffers[handle]->data) 
+		if (buf->data) 
 		{
-			void* d = s->buffers[handle]->data;
-			gl_free(s->buffers[handle]->data); 
+			void* d = buf->data;
+			gl_free(buf->data); 
 			
 			if (c->vertex_array == d) {
 				c->vertex_array = NULL;
@@ -36,8 +38,8 @@ static GLint free_buffer(GLint handle) {
 				c->client_states &= ~TEXCOORD_ARRAY;
 			}
 		}
-		gl_free(s->buffers[handle]); 
-		s->buffers[handle] = NULL;   
+		gl_pool_free(&s->buffer_pool, buf);
+		gl_table_set(&s->buffers, handle, NULL);
 		return 0;
 	} else {
 		return 0;
@@ -45,11 +47,11 @@ static GLint free_buffer(GLint handle) {
 }
 static GLint check_buffer(GLint handle) { 
 	GLContext* c = gl_get_context();
-	GLSharedState* s = &(c->shared_state);
+	GLSharedState* s = c->shared_state;
 	if (handle == 0 || handle > MAX_BUFFERS)
 		return 2; 
 	handle--;
-	if (s->buffers[handle])
+	if (gl_table_get(&s->buffers, handle))
 		return 1;
 	return 0;
 }
@@ -63,24 +65,29 @@ static GLBuffer* get_buffer(GLint handle) {
 	GLContext* c;
 	GLSharedState* s;
 	c = gl_get_context();
-	s = &(c->shared_state);
+	s = c->shared_state;
 	if (handle == 0 || handle > MAX_BUFFERS)
 		return NULL;
 	handle--;
-	return s->buffers[handle];
+	return gl_table_get(&s->buffers, handle);
 }
 static GLint create_buffer(GLint handle) {
 	GLContext* c = gl_get_context();
-	GLSharedState* s = &(c->shared_state);
+	GLSharedState* s = c->shared_state;
+	GLBuffer* buf;
 	if (handle == 0 || handle > MAX_BUFFERS)
 		return 1; 
 	handle--;	 
-	if (s->buffers[handle])
+	if (gl_table_get(&s->buffers, handle))
 		free_buffer(handle + 1); 
 	
-	s->buffers[handle] = gl_zalloc(sizeof(GLBuffer));
+	buf = gl_pool_alloc(&s->buffer_pool, sizeof(GLBuffer));
+	if (buf && gl_table_set(&s->buffers, handle, buf)) {
+		gl_pool_free(&s->buffer_pool, buf);
+		buf = NULL;
+	}
 
-	if (!(s->buffers[handle])) {
+	if (!buf) {
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define ERROR_FLAG GL_OUT_OF_MEMORY
 #define RETVAL 1
@@ -89,8 +96,8 @@ static GLint create_buffer(GLint handle) {
 		gl_fatal_error("GL_OUT_OF_MEMORY");
 #endif
 	}
-	s->buffers[handle]->data = NULL;
-	s->buffers[handle]->size = 0;
+	buf->data = NULL;
+	buf->size = 0;
 	return 0;
 }
 
@@ -101,22 +108,15 @@ void glGenBuffers(GLsizei n, GLuint* buffers) {
 	if (n > MAX_BUFFERS)
 		goto error;
 
-	{
-		GLint n_left = n;
-		GLuint names[MAX_BUFFERS];
-		for (i = 1; i <= MAX_BUFFERS && n_left > 0; i++)
-			if (!check_buffer(i))
-				names[(n_left--) - 1] = i;
-
-		if (n_left)
-			goto error; 
-		for (i = 0; i < n; i++) {
-			create_buffer(names[i]);
-
-
-#include "error_check.h"
-			buffers[i] = names[i];
+	for (i = 0; i < n; i++) {
+		/* the lowest free handle, created right away so that the next one differs */
+		GLint h = gl_table_find_free(&c->shared_state->buffers, 1) + 1;
+		if (h == 0 || create_buffer(h)) {
+			while (i-- > 0)
+				free_buffer(buffers[i]);
+			goto error;
 		}
+		buffers[i] = h;
 	}
 	return;
 error:
@@ -195,7 +195,7 @@ void glBindBufferAsArray(GLenum target, GLuint buffer,
 		return;
 #endif
 	}
-	GLBuffer* buf = c->shared_state.buffers[buffer - 1];
+	GLBuffer* buf = get_buffer(buffer);
 	if (!buf || (buf->data == NULL) || (buf->size == 0)) {
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define ERROR_FLAG GL_INVALID_OPERATION
@@ -250,7 +250,7 @@ void* glMapBuffer(GLenum target, GLenum access) {
 		handle = c->boundcolorbuffer;
 	{
 		if (check_buffer(handle) == 1)
-			return c->shared_state.buffers[handle - 1]->data;
+			return get_buffer(handle)->data;
 	}
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define RETVAL NULL
@@ -278,7 +278,7 @@ void glBufferData(GLenum target, GLsizei size, const void* data,
 	if (target == GL_COLOR_BUFFER)
 		handle = c->boundcolorbuffer;
 	if (check_buffer(handle) == 1)
-		buf = c->shared_state.buffers[handle - 1];
+		buf = get_buffer(handle);
 	else {
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define ERROR_FLAG GL_INVALID_ENUM
@@ -307,21 +307,20 @@ void glBufferData(GLenum target, GLsizei size, const void* data,
 		memcpy(buf->data, data, size);
 }
 
-void glopArrayElement(GLParam* param) {
+/* makes the attributes of element idx current. Returns 1 with its position in p[1..4] if the vertex array is enabled. */
+static GLint gl_array_attribs(GLContext* c, GLint idx, GLParam* p) {
 	GLint i;
-	GLContext* c = gl_get_context();
 	GLint states = c->client_states;
-	GLint idx = param[1].i;
 
 	if (states & COLOR_ARRAY) {
-		GLParam p[5];
+		GLParam q[5];
 		GLint size = c->color_array_size;
 		i = idx * (size + c->color_array_stride);
-		p[1].f = c->color_array[i];
-		p[2].f = c->color_array[i + 1];
-		p[3].f = c->color_array[i + 2];
-		p[4].f = (size > 3) ? c->color_array[i + 3] : 1.0f;
-		glopColor(p);
+		q[1].f = c->color_array[i];
+		q[2].f = c->color_array[i + 1];
+		q[3].f = c->color_array[i + 2];
+		q[4].f = (size > 3) ? c->color_array[i + 3] : 1.0f;
+		glopColor(q);
 	}
 	if (states & NORMAL_ARRAY) {
 		i = idx * (3 + c->normal_array_stride);
@@ -339,15 +338,43 @@ void glopArrayElement(GLParam* param) {
 		c->current_tex_coord.W = (size > 3) ? c->texcoord_array[i + 3] : 1.0f;
 	}
 	if (states & VERTEX_ARRAY) {
-		GLParam p[5];
 		GLint size = c->vertex_array_size;
 		i = idx * (size + c->vertex_array_stride);
 		p[1].f = c->vertex_array[i];
 		p[2].f = c->vertex_array[i + 1];
 		p[3].f = (size > 2) ? c->vertex_array[i + 2] : 0.0f;
 		p[4].f = (size > 3) ? c->vertex_array[i + 3] : 1.0f;
-		glopVertex(p);
+		return 1;
 	}
+	return 0;
+}
+
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+/* a draw whose bounds are outside the view volume only leaves the attributes of its last element current */
+static GLint gl_arrays_culled(GLContext* c, GLint last) {
+	GLParam p[5];
+	if (!c->array_bounds_enabled || !gl_box_culled(c->array_bounds))
+		return 0;
+	if (last >= 0)
+		gl_array_attribs(c, last, p);
+	return 1;
+}
+
+void glArrayBounds(const GLfloat* box) {
+	GLContext* c = gl_get_context();
+	GLint i;
+#include "error_check.h"
+	c->array_bounds_enabled = (box != NULL);
+	if (box)
+		for (i = 0; i < 6; i++)
+			c->array_bounds[i] = box[i];
+}
+#endif
+
+void glopArrayElement(GLParam* param) {
+	GLParam p[5];
+	if (gl_array_attribs(gl_get_context(), param[1].i, p))
+		glopVertex(p);
 }
 
 void glArrayElement(GLint i) {
@@ -358,16 +385,139 @@ void glArrayElement(GLint i) {
 	gl_add_op(p);
 }
 
+void glopDrawArrays(GLParam* param) {
+	GLParam p[2];
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+	if (gl_arrays_culled(gl_get_context(), param[2].i + param[3].i - 1))
+		return;
+#endif
+	p[1].i = param[1].i;
+	glopBegin(p);
+#if TGL_FEATURE_BATCHED_ARRAYS == 1
+	gl_draw_arrays_batch(param[2].i, param[3].i);
+#else
+	{
+		GLint i, end = param[2].i + param[3].i;
+		for (i = param[2].i; i < end; i++) {
+			p[1].i = i;
+			glopArrayElement(p);
+		}
+	}
+#endif
+	glopEnd(p);
+}
+
 void glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+#if TGL_FEATURE_BATCHED_ARRAYS == 1
+	GLParam p[4];
+#include "error_check_no_context.h"
+	p[0].op = OP_DrawArrays;
+	p[1].i = mode;
+	p[2].i = first;
+	p[3].i = count;
+	gl_add_op(p);
+#else
 	GLint i;
 	GLint end;
 	
 #include "error_check_no_context.h"
 	end = first + count;
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+	if (!gl_get_context()->compile_flag && gl_arrays_culled(gl_get_context(), end - 1))
+		return;
+#endif
 	glBegin(mode);
 	for (i = first; i < end; i++)
 		glArrayElement(i);
 	glEnd();
+#endif
+}
+
+static GLint gl_element_index(const GLvoid* indices, GLenum type, GLint i) {
+	switch (type) {
+	case GL_UNSIGNED_BYTE:
+		return ((const GLubyte*)indices)[i];
+	case GL_UNSIGNED_SHORT:
+		return ((const GLushort*)indices)[i];
+	default:
+		return ((const GLuint*)indices)[i];
+	}
+}
+
+/*
+The vertices of an element only depend on its index during one call, so they are kept in a direct mapped
+post-transform cache and only transformed, lit and mapped to the viewport the first time.
+*/
+void glopDrawElements(GLParam* param) {
+	GLContext* c = gl_get_context();
+	GLint count = param[2].i, type = param[3].i, i;
+	const GLvoid* indices = param[4].p;
+	GLParam p[5];
+
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+	if (gl_arrays_culled(c, count > 0 ? gl_element_index(indices, type, count - 1) : -1))
+		return;
+#endif
+	p[1].i = param[1].i;
+	glopBegin(p);
+	for (i = 0; i < TGL_VERTEX_CACHE_SIZE; i++)
+		c->vertex_cache_tag[i] = -1;
+	for (i = 0; i < count; i++) {
+		GLint idx = gl_element_index(indices, type, i);
+		GLint slot = idx & (TGL_VERTEX_CACHE_SIZE - 1);
+		if (c->vertex_cache_tag[slot] == idx) {
+			gl_vertex_cached(&c->vertex_cache[slot]);
+			continue;
+		}
+		if (!gl_array_attribs(c, idx, p))
+			continue;
+		c->vertex_cache_tag[slot] = -1;
+		if (gl_vertex_compute(&c->vertex_cache[slot], p))
+			break;
+		c->vertex_cache_tag[slot] = idx;
+		gl_vertex_cached(&c->vertex_cache[slot]);
+	}
+	/* the hits skipped the attributes, the last element leaves its values current */
+	if (count > 0)
+		gl_array_attribs(c, gl_element_index(indices, type, count - 1), p);
+	glopEnd(p);
+}
+
+void glDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices) {
+	GLContext* c = gl_get_context();
+	GLParam p[5];
+	GLint i;
+#include "error_check.h"
+	if (type != GL_UNSIGNED_BYTE && type != GL_UNSIGNED_SHORT && type != GL_UNSIGNED_INT) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_INVALID_ENUM
+#include "error_check.h"
+#else
+		return;
+#endif
+	}
+	if (count < 0 || (count > 0 && indices == NULL)) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_INVALID_VALUE
+#include "error_check.h"
+#else
+		return;
+#endif
+	}
+	if (c->compile_flag) {
+		/* a display list can't keep the pointer, the indices are stored with it */
+		glBegin(mode);
+		for (i = 0; i < count; i++)
+			glArrayElement(gl_element_index(indices, type, i));
+		glEnd();
+		return;
+	}
+	p[0].op = OP_DrawElements;
+	p[1].i = mode;
+	p[2].i = count;
+	p[3].i = type;
+	p[4].p = (void*)indices;
+	gl_add_op(p);
 }
 
 void glopEnableClientState(GLParam* p) { gl_get_context()->client_states |= p[1].i; }
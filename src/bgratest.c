@@ -0,0 +1,117 @@
+/*
+ * bgratest.c -- uploads GL_BGRA textures whose alpha isn't 0 and checks the pixels drawn with them.
+ *
+ * The same color is uploaded as GL_RGB, then as GL_BGRA with GL_UNSIGNED_BYTE and GL_UNSIGNED_INT_8_8_8_8_REV,
+ * at a power of two size (the texels are taken as they are), at another size (they are resized) and through
+ * glTexSubImage2D. The texels stored, and the pixels of a textured quad drawn with each, must be those of the GL_RGB
+ * texture: the alpha of the source never reaches the frame buffer. Lit textures draw their texels multiplied by the
+ * color, build it with TGL_FEATURE_LIT_TEXTURES 0 in zfeatures.h as well to have them drawn as they are.
+ *
+ * gcc -O2 bgratest.c -o bgratest libTinyGL.a -lm && ./bgratest
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gl.h"
+#include "zbuffer.h"
+
+#define WIDTH 160
+#define HEIGHT 120
+
+#define RED 0x12
+#define GREEN 0x9a
+#define BLUE 0xf4
+#define ALPHA 0xc7
+
+static GLubyte black[64 * 64 * 3], rgb[64 * 64 * 3], bgra[64 * 64 * 4], argb[64 * 64 * 4];
+
+static void draw_quad(void) {
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_TEXTURE_2D);
+	glBegin(GL_QUADS);
+	glTexCoord2f(0, 0);
+	glVertex3f(-0.5f, -0.5f, 0);
+	glTexCoord2f(1, 0);
+	glVertex3f(0.5f, -0.5f, 0);
+	glTexCoord2f(1, 1);
+	glVertex3f(0.5f, 0.5f, 0);
+	glTexCoord2f(0, 1);
+	glVertex3f(-0.5f, 0.5f, 0);
+	glEnd();
+	glFinish();
+}
+
+/* pixels of the middle of the quad that aren't ref */
+static GLint wrong_pixels(ZBuffer* zb, PIXEL ref) {
+	GLint x, y, n = 0;
+	for (y = HEIGHT / 2 - 10; y < HEIGHT / 2 + 10; y++)
+		for (x = WIDTH / 2 - 20; x < WIDTH / 2 + 20; x++)
+			n += zb->pbuf[y * WIDTH + x] != ref;
+	return n;
+}
+
+int main(void) {
+	static const char* names[6] = {"BGRA", "BGRA resized", "BGRA sub image", "ARGB", "ARGB resized", "ARGB sub image"};
+	ZBuffer* zb = ZB_open(WIDTH, HEIGHT, TGL_FEATURE_RENDER_BITS == 16 ? ZB_MODE_5R6G5B : ZB_MODE_RGBA, 0);
+	GLuint tex;
+	GLuint v = ((GLuint)ALPHA << 24) | (RED << 16) | (GREEN << 8) | BLUE;
+	PIXEL ref, ref_texel;
+	GLint w, h;
+	GLint i, test, failed = 0;
+
+	for (i = 0; i < 64 * 64; i++) {
+		rgb[i * 3] = RED;
+		rgb[i * 3 + 1] = GREEN;
+		rgb[i * 3 + 2] = BLUE;
+		bgra[i * 4] = BLUE;
+		bgra[i * 4 + 1] = GREEN;
+		bgra[i * 4 + 2] = RED;
+		bgra[i * 4 + 3] = ALPHA;
+		/* GL_UNSIGNED_INT_8_8_8_8_REV texels are native 32 bit words */
+		memcpy(argb + i * 4, &v, 4);
+	}
+	glInit(zb);
+	glViewport(0, 0, WIDTH, HEIGHT);
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, 3, 64, 64, 0, GL_RGB, GL_UNSIGNED_BYTE, rgb);
+	draw_quad();
+	ref = zb->pbuf[HEIGHT / 2 * WIDTH + WIDTH / 2];
+	ref_texel = *(PIXEL*)glGetTexturePixmap(tex, 0, &w, &h);
+	printf("GL_RGB texels stored as %08x, drawn as %08x\n", (GLuint)ref_texel, (GLuint)ref);
+#if TGL_FEATURE_RENDER_BITS == 32
+	if (ref_texel >> 24 || ref >> 24)
+		failed++;
+#endif
+
+	for (test = 0; test < 6; test++) {
+		GLenum type = test < 3 ? GL_UNSIGNED_BYTE : GL_UNSIGNED_INT_8_8_8_8_REV;
+		GLubyte* pixels = test < 3 ? bgra : argb;
+		PIXEL texel;
+		GLint n;
+		switch (test % 3) {
+		case 0:
+			glTexImage2D(GL_TEXTURE_2D, 0, 3, 64, 64, 0, GL_BGRA, type, pixels);
+			break;
+		case 1:
+			glTexImage2D(GL_TEXTURE_2D, 0, 3, 48, 40, 0, GL_BGRA, type, pixels);
+			break;
+		default:
+			glTexImage2D(GL_TEXTURE_2D, 0, 3, 64, 64, 0, GL_RGB, GL_UNSIGNED_BYTE, black);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 64, 64, GL_BGRA, type, pixels);
+		}
+		draw_quad();
+		texel = *(PIXEL*)glGetTexturePixmap(tex, 0, &w, &h);
+		n = wrong_pixels(zb, ref);
+		printf("%-14s texels stored as %08x, %d pixels differ\n", names[test], (GLuint)texel, n);
+		failed += texel != ref_texel || n != 0;
+	}
+	failed += glGetError() != GL_NO_ERROR;
+
+	glDeleteTextures(1, &tex);
+	glClose();
+	ZB_close(zb);
+	printf(failed ? "FAILED\n" : "OK\n");
+	return failed ? 1 : 0;
+}
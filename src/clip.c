@@ -231,9 +231,144 @@ static void updateTmp(GLVertex* q, GLVertex* p0, GLVertex* p1, GLfloat t) {
 
 static void gl_draw_triangle_clip(GLVertex* p0, GLVertex* p1, GLVertex* p2, GLint clip_bit); 
 
+/* cull and draw a triangle whose screen coordinates are known */
+static void gl_draw_triangle_visible(GLVertex* p0, GLVertex* p1, GLVertex* p2) {
+	GLContext* c = gl_get_context();
+	GLint front;
+	GLfloat norm;
+	norm = (GLfloat)(p1->zp.x - p0->zp.x) * (GLfloat)(p2->zp.y - p0->zp.y) - (GLfloat)(p2->zp.x - p0->zp.x) * (GLfloat)(p1->zp.y - p0->zp.y);
+
+	if (norm == 0) 
+		return;
+
+	front = norm < 0.0;
+	front = front ^ c->current_front_face; 
+
+	/* back face culling */
+	if (c->cull_face_enabled) {
+		/* most used case first */
+		if (c->current_cull_face == GL_BACK) {
+			if (front == 0)
+				return;
+			c->draw_triangle_front(p0, p1, p2);
+		} else if (c->current_cull_face == GL_FRONT) {
+			if (front != 0)
+				return;
+			c->draw_triangle_back(p0, p1, p2);
+		} else {
+			return;
+		}
+	} else {
+		/* no culling */
+		if (front) {
+			c->draw_triangle_front(p0, p1, p2);
+		} else {
+			c->draw_triangle_back(p0, p1, p2);
+		}
+	}
+}
+
+#if TGL_FEATURE_GUARD_BAND == 1
+/*
+The rasterizer scissors filled triangles to the screen, so they only have to be clipped against the
+near and far planes and against the guard band, which is TGL_GUARD_BAND_SCALE times the viewport.
+Points and lines (also in polygon mode) still need the exact clipper.
+Texture coordinates are interpolated from screen z, which is only exact for small triangles,
+so textured triangles are clipped to the viewport itself to keep their mapping unchanged.
+*/
+#define GUARD_BAND_OK(c) ((c)->draw_triangle_front == gl_draw_triangle_fill && (c)->draw_triangle_back == gl_draw_triangle_fill)
+
+static GLint gl_in_guard_band(GLVertex* v, GLfloat band) {
+	GLfloat w = v->pc.W * band;
+	if (v->clip_code == 0)
+		return 1;
+	return (v->clip_code & (CLIP_ZMIN | CLIP_ZMAX)) == 0 && v->pc.W > 0 && v->pc.X >= -w && v->pc.X <= w && v->pc.Y >= -w && v->pc.Y <= w;
+}
+
+/* signed distance to a clip plane, inside when >= 0. The near and far planes come first, so W > 0 for the others. */
+static GLfloat gl_clip_distance(V4* v, GLint plane, GLfloat band) {
+	GLfloat w = v->W * band;
+	switch (plane) {
+	case 0:
+		return v->Z + v->W;
+	case 1:
+		return v->W - v->Z;
+	case 2:
+		return v->X + w;
+	case 3:
+		return w - v->X;
+	case 4:
+		return v->Y + w;
+	default:
+		return w - v->Y;
+	}
+}
+
+/*
+Sutherland-Hodgman. The triangle is clipped against all the planes in one pass and drawn as a fan.
+New vertices are always interpolated from the inside vertex, so triangles sharing an edge get the same ones.
+*/
+static void gl_draw_triangle_clip_polygon(GLVertex* p0, GLVertex* p1, GLVertex* p2, GLfloat band) {
+	/* every plane adds at most one vertex to the polygon, and creates at most two */
+	GLVertex tmp[12];
+	GLVertex* poly[2][9];
+	GLfloat d[9];
+	GLint n = 3, ntmp = 0, cur = 0, plane, i;
+
+	poly[0][0] = p0;
+	poly[0][1] = p1;
+	poly[0][2] = p2;
+	for (plane = 0; plane < 6; plane++) {
+		GLVertex** in = poly[cur];
+		GLVertex** out = poly[cur ^ 1];
+		GLint m = 0, nout = 0;
+		for (i = 0; i < n; i++) {
+			d[i] = gl_clip_distance(&in[i]->pc, plane, band);
+			nout += d[i] < 0;
+		}
+		if (nout == 0)
+			continue;
+		if (nout == n)
+			return;
+		for (i = 0; i < n; i++) {
+			GLint j = (i + 1 == n) ? 0 : i + 1;
+			if (d[i] >= 0)
+				out[m++] = in[i];
+			if ((d[i] >= 0) != (d[j] >= 0)) {
+				GLVertex *a = in[i], *b = in[j], *q = &tmp[ntmp++];
+				GLfloat t;
+				if (d[i] < 0) {
+					a = in[j];
+					b = in[i];
+					t = d[j] / (d[j] - d[i]);
+				} else {
+					t = d[i] / (d[i] - d[j]);
+				}
+				q->pc.X = a->pc.X + (b->pc.X - a->pc.X) * t;
+				q->pc.Y = a->pc.Y + (b->pc.Y - a->pc.Y) * t;
+				q->pc.Z = a->pc.Z + (b->pc.Z - a->pc.Z) * t;
+				q->pc.W = a->pc.W + (b->pc.W - a->pc.W) * t;
+				q->edge_flag = 1;
+				updateTmp(q, a, b, t);
+				out[m++] = q;
+			}
+		}
+		n = m;
+		cur ^= 1;
+	}
+	for (i = 0; i < n; i++)
+		if (poly[cur][i]->clip_code != 0)
+			gl_transform_to_viewport_clip_c(poly[cur][i]);
+	for (i = 1; i + 1 < n; i++)
+		gl_draw_triangle_visible(poly[cur][0], poly[cur][i], poly[cur][i + 1]);
+}
+#endif
+
 void gl_draw_triangle(GLVertex* p0, GLVertex* p1, GLVertex* p2) {
+#if TGL_FEATURE_GUARD_BAND == 1
 	GLContext* c = gl_get_context();
-	GLint co, cc[3], front;
+#endif
+	GLint co, cc[3];
 
 	cc[0] = p0->clip_code;
 	cc[1] = p1->clip_code;
@@ -241,39 +376,27 @@ void gl_draw_triangle(GLVertex* p0, GLVertex* p1, GLVertex* p2) {
 
 	co = cc[0] | cc[1] | cc[2];
 
-	/* we handle the non clipped case here to go faster */
-	if (co == 0) {
-		GLfloat norm;
-		norm = (GLfloat)(p1->zp.x - p0->zp.x) * (GLfloat)(p2->zp.y - p0->zp.y) - (GLfloat)(p2->zp.x - p0->zp.x) * (GLfloat)(p1->zp.y - p0->zp.y);
-
-		if (norm == 0) 
+#if TGL_FEATURE_GUARD_BAND == 1
+	if (co != 0 && (cc[0] & cc[1] & cc[2]) == 0 && GUARD_BAND_OK(c)) {
+		GLfloat band = c->texture_2d_enabled ? 1 : TGL_GUARD_BAND_SCALE;
+		if (!gl_in_guard_band(p0, band) || !gl_in_guard_band(p1, band) || !gl_in_guard_band(p2, band)) {
+			gl_draw_triangle_clip_polygon(p0, p1, p2, band);
 			return;
-
-		front = norm < 0.0;
-		front = front ^ c->current_front_face; 
-
-		/* back face culling */
-		if (c->cull_face_enabled) {
-			/* most used case first */
-			if (c->current_cull_face == GL_BACK) {
-				if (front == 0)
-					return;
-				c->draw_triangle_front(p0, p1, p2);
-			} else if (c->current_cull_face == GL_FRONT) {
-				if (front != 0)
-					return;
-				c->draw_triangle_back(p0, p1, p2);
-			} else {
-				return;
-			}
-		} else {
-			/* no culling */
-			if (front) {
-				c->draw_triangle_front(p0, p1, p2);
-			} else {
-				c->draw_triangle_back(p0, p1, p2);
-			}
 		}
+		/* the vertices outside of the viewport have no screen coordinates yet */
+		if (cc[0])
+			gl_transform_to_viewport_clip_c(p0);
+		if (cc[1])
+			gl_transform_to_viewport_clip_c(p1);
+		if (cc[2])
+			gl_transform_to_viewport_clip_c(p2);
+		co = 0;
+	}
+#endif
+
+	/* we handle the non clipped case here to go faster */
+	if (co == 0) {
+		gl_draw_triangle_visible(p0, p1, p2);
 	} else {
 		/* GLint c_and = cc[0] & cc[1] & cc[2];*/
 		if ((cc[0] & cc[1] & cc[2]) == 0) { /* Don't draw a triangle with no points*/
@@ -398,6 +521,7 @@ int count_triangles, count_triangles_textured, count_pixels;
 /* see vertex.c to see how the draw functions are assigned.*/
 void gl_draw_triangle_fill(GLVertex* p0, GLVertex* p1, GLVertex* p2) { 
 	GLContext* c = gl_get_context();
+	ZB_fillTriangleFunc fill;
 	if (c->texture_2d_enabled) {
 		/* if(c->current_texture)*/
 #if TGL_FEATURE_LIT_TEXTURES == 1
@@ -412,34 +536,68 @@ void gl_draw_triangle_fill(GLVertex* p0, GLVertex* p1, GLVertex* p2) {
 		}
 #endif
 
-		ZB_setTexture(c->zb, c->current_texture->images[0].pixmap);
+		{
+			/* sampled until an image is specified */
+			static const PIXEL no_image = 0;
+			GLImage* im = &c->current_texture->images[0];
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+			/* indices are sampled until a palette is specified */
+			static const PIXEL no_palette[256];
+			ZB_setTextureFormat(c->zb, im->pixmap ? im->format : ZB_TEXTURE_PIXEL,
+								c->current_texture->palette ? c->current_texture->palette : no_palette);
+#endif
+			if (im->pixmap)
+				ZB_setTexture(c->zb, im->pixmap, im->xsize_log2, im->ysize_log2);
+			else
+				ZB_setTexture(c->zb, &no_image, 0, 0);
+#if TGL_FEATURE_MIPMAPPING == 1
+			{
+				GLint level;
+				for (level = 1; level < MAX_TEXTURE_LEVELS && im[level].pixmap; level++)
+					ZB_setTextureLevel(c->zb, level, im[level].pixmap, im[level].xsize_log2, im[level].ysize_log2);
+			}
+#endif
+		}
 #if TGL_FEATURE_BLEND == 1
 		if (c->zb->enable_blend)
-			ZB_fillTriangleMappingPerspective(c->zb, &p0->zp, &p1->zp, &p2->zp);
+			fill = ZB_fillTriangleMappingPerspective;
 		else
-			ZB_fillTriangleMappingPerspectiveNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
+			fill = ZB_fillTriangleMappingPerspectiveNOBLEND;
 #else
-		ZB_fillTriangleMappingPerspectiveNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
+		fill = ZB_fillTriangleMappingPerspectiveNOBLEND;
 #endif
 	} else if (c->current_shade_model == GL_SMOOTH) {
 #if TGL_FEATURE_BLEND == 1
 		if (c->zb->enable_blend)
-			ZB_fillTriangleSmooth(c->zb, &p0->zp, &p1->zp, &p2->zp);
+			fill = ZB_fillTriangleSmooth;
 		else
-			ZB_fillTriangleSmoothNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
+			fill = ZB_fillTriangleSmoothNOBLEND;
 #else
-		ZB_fillTriangleSmoothNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
+		fill = ZB_fillTriangleSmoothNOBLEND;
 #endif
 	} else {
 #if TGL_FEATURE_BLEND == 1
 		if (c->zb->enable_blend)
-			ZB_fillTriangleFlat(c->zb, &p0->zp, &p1->zp, &p2->zp);
+			fill = ZB_fillTriangleFlat;
 		else
-			ZB_fillTriangleFlatNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
+			fill = ZB_fillTriangleFlatNOBLEND;
 #else
-		ZB_fillTriangleFlatNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
+		fill = ZB_fillTriangleFlatNOBLEND;
 #endif
 	}
+#if TGL_FEATURE_SPECIALIZED_KERNELS == 1
+	{
+		ZB_fillTriangleFunc kernel = ZB_selectTriangleFunc(
+			c->zb, c->texture_2d_enabled ? ZB_FILL_TEXTURE : (c->current_shade_model == GL_SMOOTH ? ZB_FILL_SMOOTH : ZB_FILL_FLAT));
+		if (kernel)
+			fill = kernel;
+	}
+#endif
+#if TGL_FEATURE_MULTITHREADED_TILED_RASTER == 1
+	ZB_binTriangle(c->zb, fill, &p0->zp, &p1->zp, &p2->zp);
+#else
+	fill(c->zb, &p0->zp, &p1->zp, &p2->zp);
+#endif
 }
 
 /* Render a clipped triangle in line mode */
@@ -473,3 +631,25 @@ void gl_draw_triangle_point(GLVertex* p0, GLVertex* p1, GLVertex* p2) {
 	if (p2->edge_flag)
 		ZB_plot(c->zb, &p2->zp);
 }
+
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+/* true if the box {xmin, ymin, zmin, xmax, ymax, zmax} is entirely outside one plane of the view volume */
+GLint gl_box_culled(const GLfloat* box) {
+	GLContext* c = gl_get_context();
+	GLint i, code = CLIP_XMIN | CLIP_XMAX | CLIP_YMIN | CLIP_YMAX | CLIP_ZMIN | CLIP_ZMAX;
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	GLfloat* m = &c->matrix_model_projection.m[0][0];
+	gl_compute_model_projection();
+#else
+	M4 mvp;
+	GLfloat* m = &mvp.m[0][0];
+	gl_M4_Mul(&mvp, c->matrix_stack_ptr[1], c->matrix_stack_ptr[0]);
+#endif
+	for (i = 0; i < 8 && code; i++) {
+		GLfloat x = box[(i & 1) ? 3 : 0], y = box[(i & 2) ? 4 : 1], z = box[(i & 4) ? 5 : 2];
+		code &= gl_clipcode(x * m[0] + y * m[1] + z * m[2] + m[3], x * m[4] + y * m[5] + z * m[6] + m[7],
+							x * m[8] + y * m[9] + z * m[10] + m[11], x * m[12] + y * m[13] + z * m[14] + m[15]);
+	}
+	return code != 0;
+}
+#endif
@@ -0,0 +1,179 @@
+/*
+ * fixedtest.c -- checks the fixed-point vertex pipeline against the float one.
+ *
+ * Needs TGL_FEATURE_FIXED_POINT and TGL_FEATURE_BATCHED_ARRAYS in zfeatures.h: glVertex then runs in Q16.16 while
+ * glDrawArrays stays float, so the same random vertices (lit and unlit, with point, directional and spot lights,
+ * specular and a texture matrix) go through both in one program. It fails when, for a vertex inside the view volume,
+ * the rasterizer inputs of the two paths differ by more than the bounds below.
+ *
+ * gcc -O2 fixedtest.c -o fixedtest libTinyGL.a -lm && ./fixedtest
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "zgl.h"
+
+#if TGL_FEATURE_FIXED_POINT == 1 && TGL_FEATURE_BATCHED_ARRAYS == 1
+
+/* window x and y, in pixels */
+#define MAX_XY_DIFF 1
+/* depth, in steps of the zbuffer */
+#define MAX_Z_DIFF (2.5 * (1 << ZB_POINT_Z_FRAC_BITS))
+/* colors, below one 8 bit level */
+#define MAX_COLOR_DIFF ((COLOR_MASK + 1) / 256 - 1)
+/* texture coordinates, in texels of a TGL_FEATURE_TEXTURE_DIM texture */
+#define MAX_TEXEL_DIFF 0.02
+
+#define NB_VERTICES 2000
+
+static GLfloat frand(void) { return (rand() % 20000) / 10000.0f - 1; }
+
+static GLint idiff(GLint a, GLint b) { return a > b ? a - b : b - a; }
+
+/* a vertex so close to a clip plane that the two paths may put it on different sides */
+static GLint on_plane(GLVertex* v) {
+	GLfloat eps = (v->pc.W > 0 ? v->pc.W : -v->pc.W) / 4096;
+	GLint i;
+	for (i = 0; i < 3; i++) {
+		GLfloat d1 = v->pc.v[i] - v->pc.W, d2 = v->pc.v[i] + v->pc.W;
+		if ((d1 > -eps && d1 < eps) || (d2 > -eps && d2 < eps))
+			return 1;
+	}
+	return 0;
+}
+
+int main(void) {
+	ZBuffer* zb = ZB_open(320, 240, TGL_FEATURE_RENDER_BITS == 16 ? ZB_MODE_5R6G5B : ZB_MODE_RGBA, 0);
+	GLfloat amb[4] = {0.2f, 0.2f, 0.2f, 1}, pos[4] = {1, 1, 2, 1}, dir[4] = {-1, 0.5f, 1, 0}, spec[4] = {1, 1, 1, 1};
+	GLfloat va[3], ca[3], na[3], ta[2];
+	GLint max_xy = 0, max_z = 0, max_color = 0, max_s = 0, max_t = 0;
+	GLint i, lit, tested = 0, failed = 0;
+	GLfloat texel_s = (GLfloat)(ZB_POINT_S_MAX - ZB_POINT_S_MIN) / TGL_FEATURE_TEXTURE_DIM;
+	GLfloat texel_t = (GLfloat)(ZB_POINT_T_MAX - ZB_POINT_T_MIN) / TGL_FEATURE_TEXTURE_DIM;
+
+	glInit(zb);
+	glViewport(0, 0, 320, 240);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glFrustum(-1, 1, -1, 1, 1, 20);
+	glMatrixMode(GL_TEXTURE);
+	glLoadIdentity();
+	glRotatef(30, 0, 0, 1);
+	glScalef(2, 2, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glTranslatef(0.3f, -0.2f, -4);
+	glRotatef(40, 1, 1, 0);
+	glScalef(1.5f, 1, 1);
+	glLightfv(GL_LIGHT0, GL_POSITION, pos);
+	glLightf(GL_LIGHT0, GL_LINEAR_ATTENUATION, 0.1f);
+	glLightfv(GL_LIGHT1, GL_POSITION, dir);
+	glLightfv(GL_LIGHT1, GL_SPECULAR, spec);
+	glLightfv(GL_LIGHT1, GL_AMBIENT, amb);
+	glLightfv(GL_LIGHT2, GL_POSITION, pos);
+	glLightf(GL_LIGHT2, GL_SPOT_CUTOFF, 60);
+	/* the fixed-point path rounds spot exponents to integers */
+	glLightf(GL_LIGHT2, GL_SPOT_EXPONENT, 4);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, spec);
+	glMaterialf(GL_FRONT, GL_SHININESS, 20);
+	glEnable(GL_LIGHT0);
+	glEnable(GL_LIGHT1);
+	glEnable(GL_LIGHT2);
+	glEnable(GL_NORMALIZE);
+	glEnable(GL_TEXTURE_2D);
+	glSetEnableSpecular(GL_TRUE);
+
+	glVertexPointer(3, GL_FLOAT, 0, va);
+	glColorPointer(3, GL_FLOAT, 0, ca);
+	glNormalPointer(GL_FLOAT, 0, na);
+	glTexCoordPointer(2, GL_FLOAT, 0, ta);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	srand(3);
+	for (lit = 0; lit < 2; lit++) {
+		if (lit)
+			glEnable(GL_LIGHTING);
+		for (i = 0; i < NB_VERTICES; i++) {
+			/* the points are drawn one at a time, from the first vertex slot */
+			GLVertex* v = &gl_get_context()->vertex[0];
+			GLVertex fx, fl;
+			GLint d;
+			ca[0] = frand() * 0.5f + 0.5f;
+			ca[1] = frand() * 0.5f + 0.5f;
+			ca[2] = frand() * 0.5f + 0.5f;
+			na[0] = frand();
+			na[1] = frand();
+			na[2] = frand();
+			ta[0] = frand();
+			ta[1] = frand();
+			va[0] = frand() * 2;
+			va[1] = frand() * 2;
+			va[2] = frand() * 2;
+
+			glBegin(GL_POINTS);
+			glColor3fv(ca);
+			glNormal3fv(na);
+			glTexCoord2fv(ta);
+			glVertex3fv(va);
+			glEnd();
+			fx = *v;
+			glDrawArrays(GL_POINTS, 0, 1);
+			fl = *v;
+
+			if (fx.clip_code != fl.clip_code) {
+				if (!on_plane(&fl)) {
+					printf("vertex %d: clip code %d instead of %d\n", i, fx.clip_code, fl.clip_code);
+					failed++;
+				}
+				continue;
+			}
+			if (fl.clip_code)
+				continue;
+			tested++;
+			d = idiff(fx.zp.x, fl.zp.x) > idiff(fx.zp.y, fl.zp.y) ? idiff(fx.zp.x, fl.zp.x) : idiff(fx.zp.y, fl.zp.y);
+			if (d > max_xy)
+				max_xy = d;
+			d = idiff(fx.zp.z, fl.zp.z);
+			if (d > max_z)
+				max_z = d;
+			d = idiff(fx.zp.r, fl.zp.r);
+			if (idiff(fx.zp.g, fl.zp.g) > d)
+				d = idiff(fx.zp.g, fl.zp.g);
+			if (idiff(fx.zp.b, fl.zp.b) > d)
+				d = idiff(fx.zp.b, fl.zp.b);
+			if (d > max_color)
+				max_color = d;
+			d = idiff(fx.zp.s, fl.zp.s);
+			if (d > max_s)
+				max_s = d;
+			d = idiff(fx.zp.t, fl.zp.t);
+			if (d > max_t)
+				max_t = d;
+		}
+	}
+
+	printf("%d vertices in the view volume, largest differences:\n", tested);
+	printf("  x/y %d pixel (max %d)\n", max_xy, MAX_XY_DIFF);
+	printf("  z %.2f steps (max %.2f)\n", (double)max_z / (1 << ZB_POINT_Z_FRAC_BITS), MAX_Z_DIFF / (1 << ZB_POINT_Z_FRAC_BITS));
+	printf("  color %d (max %d)\n", max_color, MAX_COLOR_DIFF);
+	printf("  s %.4f t %.4f texel (max %.4f)\n", max_s / texel_s, max_t / texel_t, MAX_TEXEL_DIFF);
+	if (max_xy > MAX_XY_DIFF || max_z > MAX_Z_DIFF || max_color > MAX_COLOR_DIFF || max_s / texel_s > MAX_TEXEL_DIFF ||
+		max_t / texel_t > MAX_TEXEL_DIFF)
+		failed++;
+
+	glClose();
+	ZB_close(zb);
+	printf(failed ? "FAILED\n" : "OK\n");
+	return failed ? 1 : 0;
+}
+
+#else
+
+int main(void) {
+	printf("fixedtest needs TGL_FEATURE_FIXED_POINT and TGL_FEATURE_BATCHED_ARRAYS\n");
+	return 1;
+}
+
+#endif
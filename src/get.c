@@ -143,6 +143,66 @@ const GLubyte* extensions_string =
 																						 "TGL_FEATURE_SINGLE_THREADED "
 #endif
 
+#if TGL_FEATURE_MULTITHREADED_TILED_RASTER == 1
+																						 "TGL_FEATURE_MULTITHREADED_TILED_RASTER "
+#endif
+#if TGL_FEATURE_HALFSPACE_RASTER == 1
+																						 "TGL_FEATURE_HALFSPACE_RASTER "
+#endif
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+																						 "TGL_FEATURE_HIERARCHICAL_Z "
+#endif
+#if TGL_FEATURE_LAZY_CLEAR == 1
+																						 "TGL_FEATURE_LAZY_CLEAR "
+#endif
+#if TGL_FEATURE_SPECIALIZED_KERNELS == 1
+																						 "TGL_FEATURE_SPECIALIZED_KERNELS "
+#endif
+#if TGL_FEATURE_SIMD_SPANS == 1
+																						 "TGL_FEATURE_SIMD_SPANS "
+#endif
+#if TGL_FEATURE_GUARD_BAND == 1
+																						 "TGL_FEATURE_GUARD_BAND "
+#endif
+#if TGL_FEATURE_SMALL_TRIANGLES == 1
+																						 "TGL_FEATURE_SMALL_TRIANGLES "
+#endif
+#if TGL_FEATURE_BATCHED_ARRAYS == 1
+																						 "TGL_FEATURE_BATCHED_ARRAYS "
+#endif
+#if TGL_FEATURE_BATCHED_LIGHTING == 1
+																						 "TGL_FEATURE_BATCHED_LIGHTING "
+#endif
+#if TGL_FEATURE_LIST_COMPILER == 1
+																						 "TGL_FEATURE_LIST_COMPILER "
+#endif
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+																						 "TGL_FEATURE_FRUSTUM_CULLING "
+#endif
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+																						 "TGL_FEATURE_MULTI_CONTEXT "
+#endif
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+																						 "TGL_FEATURE_AFFINE_MATRICES "
+#endif
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 1
+																						 "TGL_FEATURE_IMMEDIATE_BATCHING "
+#endif
+#if TGL_FEATURE_FIXED_POINT == 1
+																						 "TGL_FEATURE_FIXED_POINT "
+#endif
+#if TGL_FEATURE_POOLS == 1
+																						 "TGL_FEATURE_POOLS "
+#endif
+#if TGL_FEATURE_MIPMAPPING == 1
+																						 "TGL_FEATURE_MIPMAPPING "
+#endif
+#if TGL_FEATURE_TILED_TEXTURES == 1
+																						 "TGL_FEATURE_TILED_TEXTURES "
+#endif
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+																						 "TGL_FEATURE_TEXTURE_FORMATS "
+#endif
 #if TGL_FEATURE_ALIGNAS
 																						 "TGL_FEATURE_ALIGNAS "
 #endif
@@ -179,7 +239,8 @@ void glGetIntegerv(GLint pname, GLint* params) {
 		*params = MAX_BUFFERS;
 		break;
 	case GL_TEXTURE_HASH_TABLE_SIZE:
-		*params = TEXTURE_HASH_TABLE_SIZE;
+		/* textures are in a table by handle now */
+		*params = MAX_TEXTURES;
 		break;
 
 	case GL_LIGHT15:
@@ -490,6 +551,27 @@ void glGetIntegerv(GLint pname, GLint* params) {
 	case GL_IS_SPECULAR_ENABLED:
 		*params = c->zEnableSpecular;
 		break;
+#if TGL_FEATURE_SMALL_TRIANGLES == 1
+	case GL_SMALL_TRIANGLE_COUNT:
+		ZB_flushTiles(c->zb);
+		*params = c->zb->small_triangles;
+		break;
+	case GL_SMALL_TRIANGLE_REJECT_COUNT:
+		ZB_flushTiles(c->zb);
+		*params = c->zb->small_rejected;
+		break;
+#endif
+#if TGL_FEATURE_ARENA_SIZE > 0
+	case GL_ARENA_SIZE:
+		*params = TGL_FEATURE_ARENA_SIZE;
+		break;
+	case GL_ARENA_USED:
+		*params = gl_arena_in_use();
+		break;
+	case GL_ARENA_PEAK:
+		*params = gl_arena_high_water();
+		break;
+#endif
 	case GL_MAX_MODELVIEW_STACK_DEPTH:
 		*params = MAX_MODELVIEW_STACK_DEPTH;
 		break;
@@ -542,7 +624,7 @@ void glGetIntegerv(GLint pname, GLint* params) {
 		*params = MAX_LIGHTS;
 		break;
 	case GL_MAX_TEXTURE_SIZE:
-		*params = TGL_FEATURE_TEXTURE_DIM; /* not completely true, but... */
+		*params = TGL_FEATURE_TEXTURE_DIM;
 		break;
 	case GL_CULL_FACE:
 		*params = c->cull_face_enabled;
@@ -641,7 +723,7 @@ void glGetFloatv(GLint pname, GLfloat* v) {
 		v[3] = c->rastervertex.pc.W;
 		break;
 	case GL_CURRENT_RASTER_DISTANCE:
-		*v = c->rastervertex.ec.Z;
+		*v = c->rasterpos_distance;
 		break;
 	case GL_LINE_WIDTH_RANGE:
 		v[0] = v[1] = 1.0f;
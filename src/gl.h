@@ -32,6 +32,7 @@ enum {
 	GL_4_BYTES			= 0x1409,
 	GL_UNSIGNED_SHORT_5_6_5 = 0x140A,
 	GL_UNSIGNED_INT_8_8_8_8 = 0x140B,
+	GL_UNSIGNED_INT_8_8_8_8_REV = 0x8367,
 
 	/* Primitives */
 	GL_LINES			= 0x0001,
@@ -157,6 +158,11 @@ enum {
 	GL_MAX_DISPLAY_LISTS = 0xf006,
 	GL_ERROR_CHECK_LEVEL = 0xf007,
 	GL_IS_SPECULAR_ENABLED = 0xf008,
+	GL_SMALL_TRIANGLE_COUNT = 0xf009,
+	GL_SMALL_TRIANGLE_REJECT_COUNT = 0xf00a,
+	GL_ARENA_SIZE = 0xf00b,
+	GL_ARENA_USED = 0xf00c,
+	GL_ARENA_PEAK = 0xf00d,
 	
 	/* Depth buffer */
 	GL_NEVER			= 0x0200,
@@ -373,6 +379,7 @@ enum {
 	GL_DITHER			= 0x0BD0,
 	GL_RGB				= 0x1907,
 	GL_RGBA				= 0x1908,
+	GL_BGRA				= 0x80E1,
 
 	/* Implementation limits */
 	GL_MAX_LIST_NESTING		= 0x0B31,
@@ -665,7 +672,11 @@ enum {
 	GL_COLOR_ARRAY_POINTER_EXT	= 0x8090,
 	GL_INDEX_ARRAY_POINTER_EXT	= 0x8091,
 	GL_TEXTURE_COORD_ARRAY_POINTER_EXT= 0x8092,
-	GL_EDGE_FLAG_ARRAY_POINTER_EXT	= 0x8093
+	GL_EDGE_FLAG_ARRAY_POINTER_EXT	= 0x8093,
+
+	/* GL_EXT_paletted_texture, GL_EXT_texture_compression_s3tc (TGL_FEATURE_TEXTURE_FORMATS) */
+	GL_COLOR_INDEX8_EXT		= 0x80E5,
+	GL_COMPRESSED_RGB_S3TC_DXT1_EXT	= 0x83F0
 
 };
 
@@ -794,6 +805,12 @@ void glReadPixels(	GLint x,
 void glDrawArrays(	GLenum mode,
  					GLint first,
  					GLsizei count);
+void glDrawElements(GLenum mode,
+					GLsizei count,
+					GLenum type,
+					const GLvoid* indices);
+/* TGL_FEATURE_FRUSTUM_CULLING: object space bounds {xmin, ymin, zmin, xmax, ymax, zmax} of the arrays, NULL for none */
+void glArrayBounds(const GLfloat* box);
 
 void glSetEnableSpecular(GLint s); 
 void* glGetTexturePixmap(GLint text, GLint level, GLint* xsize, GLint* ysize); 
@@ -897,6 +914,10 @@ void glTexImage2D( GLint target, GLint level, GLint components,
 void glTexImage1D( GLint target, GLint level, GLint components,
 		    		GLint width, GLint border,
                     GLint format, GLint type, void *pixels);
+/* level 0 only, of an image specified with power of two sizes (GL_INVALID_OPERATION if it was resized) */
+void glTexSubImage2D(GLint target, GLint level, GLint xoffset, GLint yoffset,
+					GLint width, GLint height,
+					GLint format, GLint type, void *pixels);
 void glCopyTexImage2D(	GLenum target,
 					 	GLint level,
 					 	GLenum internalformat,
@@ -905,6 +926,13 @@ void glCopyTexImage2D(	GLenum target,
 					 	GLsizei width,
 					 	GLsizei height,
 					 	GLint border);
+/* the palette of the GL_COLOR_INDEX8_EXT images of the current texture, at most 256 GL_RGB GL_UNSIGNED_BYTE colors */
+void glColorTableEXT(GLenum target, GLenum internalformat, GLsizei width,
+					GLenum format, GLenum type, const void *table);
+/* GL_COMPRESSED_RGB_S3TC_DXT1_EXT blocks, the sizes must be powers of two */
+void glCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat,
+							GLsizei width, GLsizei height, GLint border,
+							GLsizei imageSize, const void *data);
 void glTexEnvi(GLint target,GLint pname,GLint param);
 
 void glTexParameteri(GLint target,GLint pname,GLint param);
@@ -1009,6 +1037,11 @@ void glDebug(GLint mode);
 
 void glInit(void *zbuffer);
 void glClose(void);
+/* TGL_FEATURE_MULTI_CONTEXT */
+void* glCreateContext(void *zbuffer, void *share);
+void glDestroyContext(void *context);
+void glMakeCurrent(void *context);
+void* glGetCurrentContext(void);
 
 #ifdef __cplusplus
 }
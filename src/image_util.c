@@ -122,3 +122,133 @@ void gl_resizeImageNoInterpolate(GLubyte* dest, GLint xsize_dest, GLint ysize_de
 		y1 += y1inc;
 	}
 }
+
+/*
+ * 2x2 box filter, for the levels of a mipmap. The red and blue channels are summed together in the gaps of a
+ * masked texel (the sums need 2 more bits), the green channel apart. A dimension of 1 stays 1.
+ */
+
+#if TGL_FEATURE_RENDER_BITS == 32
+#define HALVE_RB_MASK 0x00FF00FFu
+#define HALVE_G_MASK 0x0000FF00u
+#elif TGL_FEATURE_RENDER_BITS == 16
+#define HALVE_RB_MASK 0xF81Fu
+#define HALVE_G_MASK 0x07E0u
+#endif
+/* half of the lowest bit of each channel after the shift, to round */
+#define HALVE_RB_ROUND ((HALVE_RB_MASK & ~(HALVE_RB_MASK << 1)) << 1)
+#define HALVE_G_ROUND ((HALVE_G_MASK & ~(HALVE_G_MASK << 1)) << 1)
+
+/* only the texels x0 <= x < x1, y0 <= y < y1 of dest */
+void gl_halveImage(PIXEL* dest, const PIXEL* src, GLint xsize_src, GLint ysize_src, GLint x0, GLint y0, GLint x1, GLint y1) {
+	GLint xsize = xsize_src > 1 ? xsize_src >> 1 : 1;
+	GLint dx = xsize_src > 1 ? 1 : 0;
+	GLint dy = ysize_src > 1 ? xsize_src : 0;
+	GLint x, y;
+
+	for (y = y0; y < y1; y++) {
+		const PIXEL* row0 = src + 2 * y * xsize_src;
+		const PIXEL* row1 = row0 + dy;
+		PIXEL* pix = dest + y * xsize;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+		for (x = x0; x < x1; x++) {
+			GLuint a = row0[2 * x], b = row0[2 * x + dx], c = row1[2 * x], d = row1[2 * x + dx];
+			GLuint rb = (a & HALVE_RB_MASK) + (b & HALVE_RB_MASK) + (c & HALVE_RB_MASK) + (d & HALVE_RB_MASK) + HALVE_RB_ROUND;
+			GLuint g = (a & HALVE_G_MASK) + (b & HALVE_G_MASK) + (c & HALVE_G_MASK) + (d & HALVE_G_MASK) + HALVE_G_ROUND;
+			pix[x] = (PIXEL)(((rb >> 2) & HALVE_RB_MASK) | ((g >> 2) & HALVE_G_MASK));
+		}
+	}
+}
+
+#if TGL_FEATURE_TILED_TEXTURES == 1
+/* row by row to rows of tiles (narrower if the image is), see ZB_setTexture, or back with untile */
+void gl_tileImage(PIXEL* dest, const PIXEL* src, GLint xsize_log2, GLint ysize_log2, GLint untile) {
+	GLint tw = xsize_log2 < ZB_TEXTURE_TILE_LOG2 ? xsize_log2 : ZB_TEXTURE_TILE_LOG2;
+	GLint th = ysize_log2 < ZB_TEXTURE_TILE_LOG2 ? ysize_log2 : ZB_TEXTURE_TILE_LOG2;
+	GLint xsize = 1 << xsize_log2, ysize = 1 << ysize_log2;
+	GLint x, y;
+
+	for (y = 0; y < ysize; y++) {
+		GLint row = ((y >> th) << (xsize_log2 + th)) + ((y & ((1 << th) - 1)) << tw);
+		for (x = 0; x < xsize; x++) {
+			GLint i = row + ((x >> tw) << (tw + th)) + (x & ((1 << tw) - 1));
+			if (untile)
+				*dest++ = src[i];
+			else
+				dest[i] = *src++;
+		}
+	}
+}
+#endif
+
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+/*
+ * S3TC DXT1 compression, for ZB_TEXTURE_DXT1. The two colors of a block are the corners of the box of its colors,
+ * each texel takes the nearest of the four colors they give.
+ */
+
+static GLuint dxt1_565(GLint r, GLint g, GLint b) { return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3); }
+
+/* like the sampler, the top bits are repeated in the bottom ones */
+static void dxt1_rgb(GLuint c, GLint* rgb) {
+	rgb[0] = ((c >> 8) & 0xF8) | (c >> 13);
+	rgb[1] = ((c >> 3) & 0xFC) | ((c >> 9) & 3);
+	rgb[2] = ((c << 3) & 0xF8) | ((c >> 2) & 7);
+}
+
+void gl_convertRGB_to_DXT1(GLubyte* blocks, GLubyte* rgb, GLint xsize, GLint ysize) {
+	GLint bx, by, i, k;
+	/* an image under 4 texels repeats in its block */
+	GLint xblocks = xsize > 4 ? xsize >> 2 : 1, yblocks = ysize > 4 ? ysize >> 2 : 1;
+
+	for (by = 0; by < yblocks; by++)
+		for (bx = 0; bx < xblocks; bx++) {
+			GLubyte* texel[16];
+			GLint lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0}, colors[4][3];
+			GLuint c0, c1, bits = 0;
+			for (i = 0; i < 16; i++) {
+				texel[i] = rgb + ((((by << 2) + (i >> 2)) & (ysize - 1)) * xsize + (((bx << 2) + (i & 3)) & (xsize - 1))) * 3;
+				for (k = 0; k < 3; k++) {
+					if (texel[i][k] < lo[k])
+						lo[k] = texel[i][k];
+					if (texel[i][k] > hi[k])
+						hi[k] = texel[i][k];
+				}
+			}
+			/* c0 >= c1 since every channel of hi is at least the one of lo, c0 > c1 selects the 4 colors */
+			c0 = dxt1_565(hi[0], hi[1], hi[2]);
+			c1 = dxt1_565(lo[0], lo[1], lo[2]);
+			if (c0 > c1) {
+				dxt1_rgb(c0, colors[0]);
+				dxt1_rgb(c1, colors[1]);
+				for (k = 0; k < 3; k++) {
+					colors[2][k] = (2 * colors[0][k] + colors[1][k]) / 3;
+					colors[3][k] = (colors[0][k] + 2 * colors[1][k]) / 3;
+				}
+				for (i = 0; i < 16; i++) {
+					GLint best = 0, best_d = 0x7fffffff, j;
+					for (j = 0; j < 4; j++) {
+						GLint dr = texel[i][0] - colors[j][0], dg = texel[i][1] - colors[j][1], db = texel[i][2] - colors[j][2];
+						GLint d = dr * dr + dg * dg + db * db;
+						if (d < best_d) {
+							best_d = d;
+							best = j;
+						}
+					}
+					bits |= (GLuint)best << (i * 2);
+				}
+			}
+			blocks[0] = c0 & 0xFF;
+			blocks[1] = c0 >> 8;
+			blocks[2] = c1 & 0xFF;
+			blocks[3] = c1 >> 8;
+			blocks[4] = bits & 0xFF;
+			blocks[5] = (bits >> 8) & 0xFF;
+			blocks[6] = (bits >> 16) & 0xFF;
+			blocks[7] = bits >> 24;
+			blocks += 8;
+		}
+}
+#endif
@@ -2,68 +2,81 @@
 #include "zgl.h"
 GLContext gl_ctx;
 static const GLContext empty_gl_ctx = {0};
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+TGL_THREAD_LOCAL GLContext* gl_current_ctx = NULL;
+#endif
 
 static void initSharedState(GLContext* c) {
-	GLSharedState* s = &c->shared_state;
-	s->lists = gl_zalloc(sizeof(GLList*) * MAX_DISPLAY_LISTS);
-	if (!s->lists)
-		gl_fatal_error("TINYGL_CANNOT_INIT_OOM");
-	s->texture_hash_table = gl_zalloc(sizeof(GLTexture*) * TEXTURE_HASH_TABLE_SIZE);
-	if (!s->texture_hash_table)
+	GLSharedState* s = gl_zalloc(sizeof(GLSharedState));
+	if (!s)
 		gl_fatal_error("TINYGL_CANNOT_INIT_OOM");
-	s->buffers = gl_zalloc(sizeof(GLBuffer*) * MAX_BUFFERS);
-	if (!s->buffers)
+	c->shared_state = s;
+	if (gl_table_init(&s->lists, TGL_HANDLE_TABLE_SIZE, MAX_DISPLAY_LISTS) ||
+		gl_table_init(&s->textures, TGL_HANDLE_TABLE_SIZE, MAX_TEXTURES) ||
+		gl_table_init(&s->buffers, TGL_HANDLE_TABLE_SIZE, MAX_BUFFERS))
 		gl_fatal_error("TINYGL_CANNOT_INIT_OOM");
+#if TGL_FEATURE_POOLS == 1
+	gl_pool_init(&s->list_pool, sizeof(GLList));
+	gl_pool_init(&s->op_buffer_pool, sizeof(GLParamBuffer));
+	gl_pool_init(&s->texture_pool, sizeof(GLTexture));
+	gl_pool_init(&s->buffer_pool, sizeof(GLBuffer));
+#endif
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+	s->contexts = c;
+	c->next_shared = NULL;
+#endif
 	alloc_texture(0);
 #include "error_check.h"
 }
 
 static void endSharedState(GLContext* c) {
-	GLSharedState* s = &c->shared_state;
+	GLSharedState* s = c->shared_state;
 	GLint i;
 	GLList* l;
 	GLParamBuffer *pb, *pb1;
-	GLTexture *t, *n;
-	for (i = 0; i < MAX_DISPLAY_LISTS; i++)
-		if (s->lists[i]) {
-			l = s->lists[i];
+	GLTexture* t;
+	GLBuffer* b;
+	for (i = 0; i < s->lists.size; i++)
+		if (s->lists.slots[i]) {
+			l = s->lists.slots[i];
 			pb = l->first_op_buffer;
 			while (pb != NULL) {
 				pb1 = pb->next;
-				gl_free(pb);
+				gl_pool_free(&s->op_buffer_pool, pb);
 				pb = pb1;
 			}
-			gl_free(l);
-			s->lists[i] = NULL;
+#if TGL_FEATURE_LIST_COMPILER == 1
+			gl_free_list_batches(l);
+#endif
+			gl_pool_free(&s->list_pool, l);
 		}
-	gl_free(s->lists);
-	for (i = 0; i < TEXTURE_HASH_TABLE_SIZE; i++) {
-		t = s->texture_hash_table[i];
-		while (t) {
-			GLTexture** ht;
-			if (t->prev == NULL) {
-				ht = &c->shared_state.texture_hash_table[t->handle & TEXTURE_HASH_TABLE_MASK];
-				*ht = t->next;
-			} else {
-				t->prev->next = t->next;
-			}
-			n = t->next;
-			if (t->next != NULL)
-				t->next->prev = t->prev;
-			gl_free(t);
-			t = n;
+	gl_table_free(&s->lists);
+	for (i = 0; i < s->textures.size; i++) {
+		t = s->textures.slots[i];
+		if (t) {
+			gl_free_texture_images(t);
+			gl_pool_free(&s->texture_pool, t);
 		}
 	}
-	gl_free(s->texture_hash_table);
-	for (i = 0; i < MAX_BUFFERS; i++) {
-		if (s->buffers[i]) {
-			if (s->buffers[i]->data) {
-				gl_free(s->buffers[i]->data);
+	gl_table_free(&s->textures);
+	for (i = 0; i < s->buffers.size; i++) {
+		b = s->buffers.slots[i];
+		if (b) {
+			if (b->data) {
+				gl_free(b->data);
 			}
-			gl_free(s->buffers[i]);
+			gl_pool_free(&s->buffer_pool, b);
 		}
 	}
-	gl_free(s->buffers);
+	gl_table_free(&s->buffers);
+#if TGL_FEATURE_POOLS == 1
+	gl_pool_release(&s->list_pool);
+	gl_pool_release(&s->op_buffer_pool);
+	gl_pool_release(&s->texture_pool);
+	gl_pool_release(&s->buffer_pool);
+#endif
+	gl_free(s);
+	c->shared_state = NULL;
 }
 
 #if TGL_FEATURE_TINYGL_RUNTIME_COMPAT_TEST == 1
@@ -148,19 +161,16 @@ static int TinyGLRuntimeCompatibilityTest() {
 }
 #endif
 
-void glInit(void* zbuffer1) {
-	GLContext* c;
+/* the state is set through the API, so c is made current while it is initialized */
+static void gl_init_context(GLContext* c, ZBuffer* zbuffer, GLContext* share) {
 	GLViewport* v;
 	GLint i;
-	ZBuffer* zbuffer = (ZBuffer*)zbuffer1;
-#if TGL_FEATURE_TINYGL_RUNTIME_COMPAT_TEST == 1
-	if (TinyGLRuntimeCompatibilityTest())
-		gl_fatal_error("TINYGL_FAILED_RUNTIME_COMPAT_TEST");
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+	GLContext* prev = gl_current_ctx;
+	gl_current_ctx = c;
+#else
+	(void)share;
 #endif
-	gl_ctx = empty_gl_ctx;
-	c = &gl_ctx;
-	if (!c)
-		gl_fatal_error("TINYGL_CANNOT_INIT_OOM");
 
 	c->zb = zbuffer;
 #if TGL_FEATURE_ERROR_CHECK == 1
@@ -181,7 +191,14 @@ void glInit(void* zbuffer1) {
 	c->drawbuffer = GL_FRONT;
 	c->readbuffer = GL_FRONT;
 	/* shared state */
-	initSharedState(c);
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+	if (share) {
+		c->shared_state = share->shared_state;
+		c->next_shared = c->shared_state->contexts;
+		c->shared_state->contexts = c;
+	} else
+#endif
+		initSharedState(c);
 	/* ztext */
 	c->textsize = 1;
 	/* buffer */
@@ -307,6 +324,11 @@ void glInit(void* zbuffer1) {
 		if (!(c->matrix_stack[i]))
 			gl_fatal_error("TINYGL_CANNOT_INIT_OOM");
 		c->matrix_stack_ptr[i] = c->matrix_stack[i];
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+		c->matrix_stack_kind[i] = gl_zalloc(c->matrix_stack_depth_max[i]);
+		if (!(c->matrix_stack_kind[i]))
+			gl_fatal_error("TINYGL_CANNOT_INIT_OOM");
+#endif
 	}
 
 	glMatrixMode(GL_PROJECTION);
@@ -316,7 +338,14 @@ void glInit(void* zbuffer1) {
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	c->matrix_model_projection_updated = TGL_MATRIX_DIRTY_ALL;
+#else
 	c->matrix_model_projection_updated = 1;
+#endif
+#if TGL_FEATURE_FIXED_POINT == 1
+	c->matrix_fixed_dirty = TGL_MATRIX_FIXED_ALL;
+#endif
 
 	/* opengl 1.1 arrays */
 	c->client_states = 0;
@@ -352,14 +381,27 @@ void glInit(void* zbuffer1) {
 	c->rasterposvalid = 0;
 	c->pzoomx = 1;
 	c->pzoomy = 1;
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+	gl_current_ctx = prev;
+#endif
 }
 
-void glClose(void) {
+void glInit(void* zbuffer1) {
+#if TGL_FEATURE_TINYGL_RUNTIME_COMPAT_TEST == 1
+	if (TinyGLRuntimeCompatibilityTest())
+		gl_fatal_error("TINYGL_FAILED_RUNTIME_COMPAT_TEST");
+#endif
+	gl_ctx = empty_gl_ctx;
+	gl_init_context(&gl_ctx, (ZBuffer*)zbuffer1, NULL);
+}
 
+static void gl_close_context(GLContext* c) {
 	GLuint i;
-	GLContext* c = gl_get_context();
 	for (i = 0; i < 3; i++) {
 		gl_free(c->matrix_stack[i]);
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+		gl_free(c->matrix_stack_kind[i]);
+#endif
 	}
 	i = 0;
 #if TGL_FEATURE_SPECULAR_BUFFERS == 1
@@ -372,6 +414,43 @@ void glClose(void) {
 		}
 	}
 #endif
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+	{
+		GLContext** p = &c->shared_state->contexts;
+		while (*p != c)
+			p = &(*p)->next_shared;
+		*p = c->next_shared;
+	}
+	if (c->shared_state->contexts == NULL)
+		endSharedState(c);
+#else
 	endSharedState(c);
+#endif
+}
+
+void glClose(void) {
+	gl_close_context(&gl_ctx);
 	gl_ctx = empty_gl_ctx;
 }
+
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+void* glCreateContext(void* zbuffer, void* share) {
+	GLContext* c = gl_zalloc(sizeof(GLContext));
+	if (!c)
+		return NULL;
+	gl_init_context(c, (ZBuffer*)zbuffer, (GLContext*)share);
+	return c;
+}
+
+void glDestroyContext(void* context) {
+	GLContext* c = (GLContext*)context;
+	if (gl_current_ctx == c)
+		gl_current_ctx = NULL;
+	gl_close_context(c);
+	gl_free(c);
+}
+
+void glMakeCurrent(void* context) { gl_current_ctx = (GLContext*)context; }
+
+void* glGetCurrentContext(void) { return gl_get_context(); }
+#endif
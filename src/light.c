@@ -13,6 +13,9 @@ void glopMaterial(GLParam* p) {
 	GLint i;
 	GLMaterial* m;
 
+#if TGL_FEATURE_BATCHED_LIGHTING == 1 || TGL_FEATURE_FIXED_POINT == 1
+	c->light_products_valid = 0;
+#endif
 	if (mode == GL_FRONT_AND_BACK) {
 		p[1].i = GL_FRONT;
 		glopMaterial(p);
@@ -93,6 +96,9 @@ void glopLight(GLParam* p) {
 #endif
 
 		l = &c->lights[light - GL_LIGHT0];
+#if TGL_FEATURE_BATCHED_LIGHTING == 1 || TGL_FEATURE_FIXED_POINT == 1
+	c->light_products_valid = 0;
+#endif
 
 	for (i = 0; i < 4; i++)
 		if (type != GL_POSITION && type != GL_SPOT_DIRECTION && type != GL_SPOT_EXPONENT && type != GL_SPOT_CUTOFF && type != GL_LINEAR_ATTENUATION &&
@@ -173,6 +179,9 @@ void glopLightModel(GLParam* p) {
 	GLint* v = &p[2].i;
 	GLint i;
 
+#if TGL_FEATURE_BATCHED_LIGHTING == 1 || TGL_FEATURE_FIXED_POINT == 1
+	c->light_products_valid = 0;
+#endif
 	switch (pname) {
 	case GL_LIGHT_MODEL_AMBIENT:
 		for (i = 0; i < 4; i++)
@@ -200,6 +209,9 @@ void glopLightModel(GLParam* p) {
 void gl_enable_disable_light(GLint light, GLint v) {
 	GLContext* c = gl_get_context();
 	GLLight* l = &c->lights[light];
+#if TGL_FEATURE_BATCHED_LIGHTING == 1 || TGL_FEATURE_FIXED_POINT == 1
+	c->light_products_valid = 0;
+#endif
 	if (v && !l->enabled) {
 		l->enabled = 1;
 		l->next = c->first_light;
@@ -228,8 +240,59 @@ void glopSetEnableSpecular(GLParam* p) {
 	
 	gl_get_context()->zEnableSpecular = p[1].i;
 }
+#if TGL_FEATURE_BATCHED_LIGHTING == 1 || TGL_FEATURE_FIXED_POINT == 1
+/* the products of the lights and the front material, recomputed once something changed */
+static void gl_update_light_products(GLContext* c) {
+	GLMaterial* m = &c->materials[0];
+	GLLight* l;
+	GLint i;
+	for (i = 0; i < 3; i++)
+		c->scene_color.v[i] = m->emission.v[i] + m->ambient.v[i] * c->ambient_light_model.v[i];
+	for (l = c->first_light; l != NULL; l = l->next)
+		for (i = 0; i < 3; i++) {
+			l->ambient_product.v[i] = l->ambient.v[i] * m->ambient.v[i];
+			l->diffuse_product.v[i] = l->diffuse.v[i] * m->diffuse.v[i];
+			l->specular_product.v[i] = l->specular.v[i] * m->specular.v[i];
+		}
+#if TGL_FEATURE_FIXED_POINT == 1
+	/* and everything gl_shade_vertex_fixed reads */
+	for (i = 0; i < 3; i++)
+		c->scene_color_x.v[i] = gl_fx_from_float(c->scene_color.v[i]);
+	c->scene_color_x.W = gl_fx_from_float(m->diffuse.v[3]);
+	c->shininess_x = (GLint)(m->shininess + 0.5f);
+	for (l = c->first_light; l != NULL; l = l->next) {
+		for (i = 0; i < 3; i++) {
+			l->ambient_product_x.v[i] = gl_fx_from_float(l->ambient_product.v[i]);
+			l->diffuse_product_x.v[i] = gl_fx_from_float(l->diffuse_product.v[i]);
+			l->specular_product_x.v[i] = gl_fx_from_float(l->specular_product.v[i]);
+			l->norm_position_x.v[i] = gl_fx_from_float(l->norm_position.v[i]);
+			l->norm_spot_direction_x.v[i] = gl_fx_from_float(l->norm_spot_direction.v[i]);
+			l->attenuation_x[i] = gl_fx_from_float(l->attenuation[i]);
+		}
+		for (i = 0; i < 4; i++)
+			l->position_x.v[i] = gl_fx_from_float(l->position.v[i]);
+		l->cos_spot_cutoff_x = gl_fx_from_float(l->cos_spot_cutoff);
+		/* -1 without a spot cutoff */
+		l->spot_exponent_i = (l->spot_cutoff != 180) ? (GLint)(l->spot_exponent + 0.5f) : -1;
+	}
+#endif
+	c->light_products_valid = 1;
+}
+#endif
+
+#if TGL_FEATURE_BATCHED_LIGHTING == 1 && TGL_FEATURE_SPECULAR_BUFFERS == 1
+/* pow(dot_spot, spot_exponent) from a specular buffer, which covers exponents up to 128 like the shininess */
+static GLfloat gl_spot_pow(GLContext* c, GLLight* l, GLfloat dot_spot) {
+	GLSpecBuf* buf = specbuf_get_buffer(c, (GLint)(l->spot_exponent / 128.0f * SPECULAR_BUFFER_SIZE), l->spot_exponent);
+	GLint idx = (GLint)(dot_spot * SPECULAR_BUFFER_SIZE);
+	if (!buf)
+		return 0;
+	return buf->buf[idx > SPECULAR_BUFFER_SIZE ? SPECULAR_BUFFER_SIZE : idx];
+}
+#endif
+
 /* non optimized lightening model */
-void gl_shade_vertex(GLVertex* v) {
+void gl_shade_vertex(GLVertex* v, GLVertexEye* e) {
 	GLContext* c = gl_get_context();
 	GLfloat R, G, B, A;
 	GLMaterial* m;
@@ -240,13 +303,21 @@ void gl_shade_vertex(GLVertex* v) {
 
 	m = &c->materials[0];
 
-	n.X = v->normal.X;
-	n.Y = v->normal.Y;
-	n.Z = v->normal.Z;
+	n.X = e->normal.X;
+	n.Y = e->normal.Y;
+	n.Z = e->normal.Z;
 
+#if TGL_FEATURE_BATCHED_LIGHTING == 1
+	if (!c->light_products_valid)
+		gl_update_light_products(c);
+	R = c->scene_color.X;
+	G = c->scene_color.Y;
+	B = c->scene_color.Z;
+#else
 	R = m->emission.v[0] + m->ambient.v[0] * c->ambient_light_model.v[0];
 	G = m->emission.v[1] + m->ambient.v[1] * c->ambient_light_model.v[1];
 	B = m->emission.v[2] + m->ambient.v[2] * c->ambient_light_model.v[2];
+#endif
 	A = m->diffuse.v[3];
 	
 	for (l = c->first_light; l != NULL; l = l->next) {
@@ -256,9 +327,15 @@ void gl_shade_vertex(GLVertex* v) {
 		GLfloat lR, lB, lG;
 
 		/* ambient */
+#if TGL_FEATURE_BATCHED_LIGHTING == 1
+		lR = l->ambient_product.X;
+		lG = l->ambient_product.Y;
+		lB = l->ambient_product.Z;
+#else
 		lR = l->ambient.v[0] * m->ambient.v[0];
 		lG = l->ambient.v[1] * m->ambient.v[1];
 		lB = l->ambient.v[2] * m->ambient.v[2];
+#endif
 
 		if (l->position.v[3] == 0) {
 			/* light at infinity */
@@ -269,9 +346,9 @@ void gl_shade_vertex(GLVertex* v) {
 			att = 1;
 		} else {
 			/* distance attenuation */
-			d.X = l->position.v[0] - v->ec.v[0];
-			d.Y = l->position.v[1] - v->ec.v[1];
-			d.Z = l->position.v[2] - v->ec.v[2];
+			d.X = l->position.v[0] - e->ec.v[0];
+			d.Y = l->position.v[1] - e->ec.v[1];
+			d.Z = l->position.v[2] - e->ec.v[2];
 #if TGL_FEATURE_FISR == 1
 			tmp = fastInvSqrt(d.X * d.X + d.Y * d.Y + d.Z * d.Z); /* FISR IMPL, MATCHED!*/
 			{
@@ -295,9 +372,15 @@ void gl_shade_vertex(GLVertex* v) {
 			dot = -dot;
 		if (dot > 0) {
 			/* diffuse light */
+#if TGL_FEATURE_BATCHED_LIGHTING == 1
+			lR += dot * l->diffuse_product.X;
+			lG += dot * l->diffuse_product.Y;
+			lB += dot * l->diffuse_product.Z;
+#else
 			lR += dot * l->diffuse.v[0] * m->diffuse.v[0];
 			lG += dot * l->diffuse.v[1] * m->diffuse.v[1];
 			lB += dot * l->diffuse.v[2] * m->diffuse.v[2];
+#endif
 
 			/* spot light */
 			if (l->spot_cutoff != 180) {
@@ -310,7 +393,12 @@ void gl_shade_vertex(GLVertex* v) {
 				} else {
 					/* TODO: pow table for spot_exponent?*/
 					if (l->spot_exponent > 0) {
+#if TGL_FEATURE_BATCHED_LIGHTING == 1 && TGL_FEATURE_SPECULAR_BUFFERS == 1
+						att = att * gl_spot_pow(c, l, dot_spot);
+#include "error_check.h"
+#else
 						att = att * pow(dot_spot, l->spot_exponent);
+#endif
 					}
 				}
 				
@@ -321,9 +409,9 @@ void gl_shade_vertex(GLVertex* v) {
 			if (c->zEnableSpecular) {
 				if (c->local_light_model) {
 					V3 vcoord;
-					vcoord.X = v->ec.X;
-					vcoord.Y = v->ec.Y;
-					vcoord.Z = v->ec.Z;
+					vcoord.X = e->ec.X;
+					vcoord.Y = e->ec.Y;
+					vcoord.Z = e->ec.Z;
 					
 					gl_V3_Norm_Fast(&vcoord);
 					s.X = d.X - vcoord.X;
@@ -375,9 +463,15 @@ void gl_shade_vertex(GLVertex* v) {
 						idx = SPECULAR_BUFFER_SIZE; /* NOTE by GEK: this is poorly written, it's actually 1 larger.*/
 					dot_spec = specbuf->buf[idx];
 #endif
+#if TGL_FEATURE_BATCHED_LIGHTING == 1
+					lR += dot_spec * l->specular_product.X;
+					lG += dot_spec * l->specular_product.Y;
+					lB += dot_spec * l->specular_product.Z;
+#else
 					lR += dot_spec * l->specular.v[0] * m->specular.v[0];
 					lG += dot_spec * l->specular.v[1] * m->specular.v[1];
 					lB += dot_spec * l->specular.v[2] * m->specular.v[2];
+#endif
 				} 
 			}	 
 		}		  
@@ -392,3 +486,309 @@ void gl_shade_vertex(GLVertex* v) {
 	v->color.v[2] = clampf(B, 0, 1);
 	v->color.v[3] = A;
 }
+
+#if TGL_FEATURE_FIXED_POINT == 1
+/* 1E-3 in Q16.16 */
+#define TGL_FIXED_EPSILON 66
+
+/* gl_shade_vertex in Q16.16, the color (rgba) goes to color */
+void gl_shade_vertex_fixed(V4x* color, GLVertexEyeX* e) {
+	GLContext* c = gl_get_context();
+	GLint R, G, B;
+	GLLight* l;
+	V3x n, s, d;
+	GLint dist = 0, len, att, dot, dot_spot, dot_spec;
+	GLint twoside = c->light_model_two_side;
+
+	if (!c->light_products_valid)
+		gl_update_light_products(c);
+	n = e->normal;
+	R = c->scene_color_x.v[0];
+	G = c->scene_color_x.v[1];
+	B = c->scene_color_x.v[2];
+
+	for (l = c->first_light; l != NULL; l = l->next) {
+		GLint lR, lG, lB;
+
+		/* ambient */
+		lR = l->ambient_product_x.v[0];
+		lG = l->ambient_product_x.v[1];
+		lB = l->ambient_product_x.v[2];
+
+		if (l->position_x.v[3] == 0) {
+			/* light at infinity */
+			d = l->norm_position_x;
+			att = TGL_FIXED_ONE;
+		} else {
+			/* distance attenuation */
+			GLint den;
+			d.v[0] = l->position_x.v[0] - e->ec.v[0];
+			d.v[1] = l->position_x.v[1] - e->ec.v[1];
+			d.v[2] = l->position_x.v[2] - e->ec.v[2];
+			len = gl_fx_length(d.v[0], d.v[1], d.v[2]);
+#if TGL_FEATURE_FISR == 1
+			/* like the float path, the attenuation ignores the distance */
+			if (len > 0)
+#else
+			dist = len;
+			if (dist > TGL_FIXED_EPSILON)
+#endif
+				gl_V3x_Div(&d, len);
+			den = l->attenuation_x[0] + gl_fx_mul(dist, l->attenuation_x[1] + gl_fx_mul(dist, l->attenuation_x[2]));
+			att = den > 0 ? (GLint)(((long long)TGL_FIXED_ONE << TGL_FIXED_BITS) / den) : 0x7fffffff;
+		}
+		dot = gl_fx_mul(d.v[0], n.v[0]) + gl_fx_mul(d.v[1], n.v[1]) + gl_fx_mul(d.v[2], n.v[2]);
+		if (twoside && dot < 0)
+			dot = -dot;
+		if (dot > 0) {
+			/* diffuse light */
+			lR += gl_fx_mul(dot, l->diffuse_product_x.v[0]);
+			lG += gl_fx_mul(dot, l->diffuse_product_x.v[1]);
+			lB += gl_fx_mul(dot, l->diffuse_product_x.v[2]);
+
+			/* spot light */
+			if (l->spot_exponent_i >= 0) {
+				dot_spot = -(gl_fx_mul(d.v[0], l->norm_spot_direction_x.v[0]) + gl_fx_mul(d.v[1], l->norm_spot_direction_x.v[1]) +
+							 gl_fx_mul(d.v[2], l->norm_spot_direction_x.v[2]));
+				if (twoside && dot_spot < 0)
+					dot_spot = -dot_spot;
+				if (dot_spot < l->cos_spot_cutoff_x)
+					/* no contribution */
+					continue;
+				if (l->spot_exponent_i > 0)
+					att = gl_fx_mul(att, gl_fx_powi(dot_spot, l->spot_exponent_i));
+			}
+
+			/* specular light */
+			if (c->zEnableSpecular) {
+				if (c->local_light_model) {
+					V3x vcoord;
+					vcoord.v[0] = e->ec.v[0];
+					vcoord.v[1] = e->ec.v[1];
+					vcoord.v[2] = e->ec.v[2];
+					gl_V3x_Norm(&vcoord);
+					/* same as the float path */
+					s.v[0] = d.v[0] - vcoord.v[0];
+					s.v[1] = d.v[1] - vcoord.v[0];
+					s.v[2] = d.v[2] - vcoord.v[0];
+				} else {
+					s.v[0] = d.v[0];
+					s.v[1] = d.v[1];
+					s.v[2] = d.v[2] - TGL_FIXED_ONE;
+				}
+				dot_spec = gl_fx_mul(n.v[0], s.v[0]) + gl_fx_mul(n.v[1], s.v[1]) + gl_fx_mul(n.v[2], s.v[2]);
+				if (twoside && dot_spec < 0)
+					dot_spec = -dot_spec;
+				if (dot_spec > 0) {
+#if TGL_FEATURE_SPECULAR_BUFFERS == 1
+					GLSpecBuf* specbuf;
+					GLint idx;
+#endif
+					if (dot_spec > TGL_FIXED_ONE)
+						dot_spec = TGL_FIXED_ONE;
+					len = gl_fx_length(s.v[0], s.v[1], s.v[2]);
+					if (len > TGL_FIXED_EPSILON)
+						dot_spec = (GLint)(((long long)dot_spec << TGL_FIXED_BITS) / len);
+					else
+						dot_spec = 0;
+					if (dot_spec > TGL_FIXED_ONE)
+						dot_spec = TGL_FIXED_ONE;
+#if TGL_FEATURE_SPECULAR_BUFFERS == 1
+					specbuf = specbuf_get_buffer(c, c->materials[0].shininess_i, c->materials[0].shininess);
+#if TGL_FEATURE_ERROR_CHECK == 1
+#include "error_check.h"
+#endif
+					idx = (GLint)(((long long)dot_spec * SPECULAR_BUFFER_SIZE) >> TGL_FIXED_BITS);
+					dot_spec = gl_fx_from_float(specbuf->buf[idx]);
+#else
+					dot_spec = gl_fx_powi(dot_spec, c->shininess_x);
+#endif
+					lR += gl_fx_mul(dot_spec, l->specular_product_x.v[0]);
+					lG += gl_fx_mul(dot_spec, l->specular_product_x.v[1]);
+					lB += gl_fx_mul(dot_spec, l->specular_product_x.v[2]);
+				}
+			}
+		}
+
+		R += gl_fx_mul(att, lR);
+		G += gl_fx_mul(att, lG);
+		B += gl_fx_mul(att, lB);
+	}
+
+	color->v[0] = R < 0 ? 0 : (R > TGL_FIXED_ONE ? TGL_FIXED_ONE : R);
+	color->v[1] = G < 0 ? 0 : (G > TGL_FIXED_ONE ? TGL_FIXED_ONE : G);
+	color->v[2] = B < 0 ? 0 : (B > TGL_FIXED_ONE ? TGL_FIXED_ONE : B);
+	color->v[3] = c->scene_color_x.v[3];
+}
+#endif
+
+#if TGL_FEATURE_BATCHED_LIGHTING == 1
+/*
+gl_shade_vertex for nb vertices in SoA form: eye coordinates e and normals n (already normalized if needed).
+mat is NULL, or the front material ambient (rgb) and diffuse (rgba) of every vertex when the color material sets them.
+The colors go to col (rgba). The lights are the outer loop, so everything about a light is looked up once per batch.
+*/
+void gl_shade_vertices(GLint nb, const GLfloat* ex, const GLfloat* ey, const GLfloat* ez, const GLfloat* nx, const GLfloat* ny,
+					   const GLfloat* nz, GLfloat (*mat)[TGL_VERTEX_BATCH_SIZE], GLfloat (*col)[TGL_VERTEX_BATCH_SIZE]) {
+	GLContext* c = gl_get_context();
+	GLMaterial* m = &c->materials[0];
+	GLint twoside = c->light_model_two_side, specular = c->zEnableSpecular, local = c->local_light_model;
+	GLfloat R[TGL_VERTEX_BATCH_SIZE], G[TGL_VERTEX_BATCH_SIZE], B[TGL_VERTEX_BATCH_SIZE];
+	GLLight* l;
+	GLint i;
+
+	if (!c->light_products_valid)
+		gl_update_light_products(c);
+	for (i = 0; i < nb; i++) {
+		if (mat) {
+			R[i] = m->emission.v[0] + mat[0][i] * c->ambient_light_model.v[0];
+			G[i] = m->emission.v[1] + mat[1][i] * c->ambient_light_model.v[1];
+			B[i] = m->emission.v[2] + mat[2][i] * c->ambient_light_model.v[2];
+			col[3][i] = mat[6][i];
+		} else {
+			R[i] = c->scene_color.X;
+			G[i] = c->scene_color.Y;
+			B[i] = c->scene_color.Z;
+			col[3][i] = m->diffuse.v[3];
+		}
+	}
+
+	for (l = c->first_light; l != NULL; l = l->next) {
+		GLint directional = (l->position.v[3] == 0), spot = (l->spot_cutoff != 180);
+#if TGL_FEATURE_SPECULAR_BUFFERS == 1
+		GLSpecBuf *spotbuf = NULL, *specbuf = NULL;
+		if (spot && l->spot_exponent > 0) {
+			spotbuf = specbuf_get_buffer(c, (GLint)(l->spot_exponent / 128.0f * SPECULAR_BUFFER_SIZE), l->spot_exponent);
+#include "error_check.h"
+		}
+		if (specular) {
+			specbuf = specbuf_get_buffer(c, m->shininess_i, m->shininess);
+#include "error_check.h"
+		}
+#endif
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+		for (i = 0; i < nb; i++) {
+			GLfloat dx, dy, dz, dist = 0, tmp, att, dot, lR, lG, lB;
+			if (mat) {
+				lR = l->ambient.v[0] * mat[0][i];
+				lG = l->ambient.v[1] * mat[1][i];
+				lB = l->ambient.v[2] * mat[2][i];
+			} else {
+				lR = l->ambient_product.X;
+				lG = l->ambient_product.Y;
+				lB = l->ambient_product.Z;
+			}
+			if (directional) {
+				dx = l->norm_position.v[0];
+				dy = l->norm_position.v[1];
+				dz = l->norm_position.v[2];
+				att = 1;
+			} else {
+				dx = l->position.v[0] - ex[i];
+				dy = l->position.v[1] - ey[i];
+				dz = l->position.v[2] - ez[i];
+#if TGL_FEATURE_FISR == 1
+				tmp = fastInvSqrt(dx * dx + dy * dy + dz * dz);
+				dx *= tmp;
+				dy *= tmp;
+				dz *= tmp;
+#else
+				dist = sqrt(dx * dx + dy * dy + dz * dz);
+				if (dist > 1E-3) {
+					tmp = 1 / dist;
+					dx *= tmp;
+					dy *= tmp;
+					dz *= tmp;
+				}
+#endif
+				att = 1.0f / (l->attenuation[0] + dist * (l->attenuation[1] + dist * l->attenuation[2]));
+			}
+			dot = dx * nx[i] + dy * ny[i] + dz * nz[i];
+			if (twoside && dot < 0)
+				dot = -dot;
+			if (dot > 0) {
+				if (mat) {
+					lR += dot * (l->diffuse.v[0] * mat[3][i]);
+					lG += dot * (l->diffuse.v[1] * mat[4][i]);
+					lB += dot * (l->diffuse.v[2] * mat[5][i]);
+				} else {
+					lR += dot * l->diffuse_product.X;
+					lG += dot * l->diffuse_product.Y;
+					lB += dot * l->diffuse_product.Z;
+				}
+				if (spot) {
+					GLfloat dot_spot = -(dx * l->norm_spot_direction.v[0] + dy * l->norm_spot_direction.v[1] + dz * l->norm_spot_direction.v[2]);
+					if (twoside && dot_spot < 0)
+						dot_spot = -dot_spot;
+					if (dot_spot < l->cos_spot_cutoff)
+						continue;
+					if (l->spot_exponent > 0) {
+#if TGL_FEATURE_SPECULAR_BUFFERS == 1
+						GLint idx = (GLint)(dot_spot * SPECULAR_BUFFER_SIZE);
+						att = att * spotbuf->buf[idx > SPECULAR_BUFFER_SIZE ? SPECULAR_BUFFER_SIZE : idx];
+#else
+						att = att * pow(dot_spot, l->spot_exponent);
+#endif
+					}
+				}
+				if (specular) {
+					GLfloat sx, sy, sz, dot_spec;
+					if (local) {
+						V3 vcoord;
+						vcoord.X = ex[i];
+						vcoord.Y = ey[i];
+						vcoord.Z = ez[i];
+						gl_V3_Norm_Fast(&vcoord);
+						/* same as gl_shade_vertex */
+						sx = dx - vcoord.X;
+						sy = dy - vcoord.X;
+						sz = dz - vcoord.X;
+					} else {
+						sx = dx;
+						sy = dy;
+						sz = dz - 1.0;
+					}
+					dot_spec = nx[i] * sx + ny[i] * sy + nz[i] * sz;
+					if (twoside && dot_spec < 0)
+						dot_spec = -dot_spec;
+					if (dot_spec > 0) {
+						dot_spec = clampf(dot_spec, 0, 1);
+#if TGL_FEATURE_FISR == 1
+						tmp = fastInvSqrt(sx * sx + sy * sy + sz * sz);
+						dot_spec = dot_spec * tmp;
+#else
+						tmp = sqrt(sx * sx + sy * sy + sz * sz);
+						if (tmp > 1E-3) {
+							dot_spec = dot_spec / tmp;
+						} else
+							dot_spec = 0;
+#endif
+#if TGL_FEATURE_SPECULAR_BUFFERS == 1
+						{
+							GLint idx = (GLint)(dot_spec * SPECULAR_BUFFER_SIZE);
+							dot_spec = specbuf->buf[idx > SPECULAR_BUFFER_SIZE ? SPECULAR_BUFFER_SIZE : idx];
+						}
+#else
+						dot_spec = pow(dot_spec, m->shininess);
+#endif
+						lR += dot_spec * l->specular_product.X;
+						lG += dot_spec * l->specular_product.Y;
+						lB += dot_spec * l->specular_product.Z;
+					}
+				}
+			}
+			R[i] += att * lR;
+			G[i] += att * lG;
+			B[i] += att * lB;
+		}
+	}
+
+	for (i = 0; i < nb; i++) {
+		col[0][i] = clampf(R[i], 0, 1);
+		col[1][i] = clampf(G[i], 0, 1);
+		col[2][i] = clampf(B[i], 0, 1);
+	}
+}
+#endif
@@ -21,7 +21,7 @@ GLint op_table_size[] = {
 #include "opinfo.h"
 };
 
-static GLList* find_list(GLuint list) { return gl_get_context()->shared_state.lists[list]; }
+static GLList* find_list(GLuint list) { return gl_table_get(&gl_get_context()->shared_state->lists, list); }
 
 static void delete_list(GLint list) {
 	GLContext* c = gl_get_context();
@@ -38,12 +38,15 @@ static void delete_list(GLint list) {
 	pb = l->first_op_buffer;
 	while (pb != NULL) {
 		pb1 = pb->next;
-		gl_free(pb);
+		gl_pool_free(&c->shared_state->op_buffer_pool, pb);
 		pb = pb1;
 	}
+#if TGL_FEATURE_LIST_COMPILER == 1
+	gl_free_list_batches(l);
+#endif
 
-	gl_free(l);
-	c->shared_state.lists[list] = NULL;
+	gl_pool_free(&c->shared_state->list_pool, l);
+	gl_table_set(&c->shared_state->lists, list, NULL);
 }
 void glDeleteLists(GLuint list, GLuint range) {
 	GLuint i;
@@ -62,8 +65,8 @@ static GLList* alloc_list(GLint list) {
 	GLContext* c = gl_get_context();
 #define RETVAL NULL
 #include "error_check.h"
-	l = gl_zalloc(sizeof(GLList));
-	ob = gl_zalloc(sizeof(GLParamBuffer));
+	l = gl_pool_alloc(&c->shared_state->list_pool, sizeof(GLList));
+	ob = gl_pool_alloc(&c->shared_state->op_buffer_pool, sizeof(GLParamBuffer));
 
 #if TGL_FEATURE_ERROR_CHECK
 	if (!l || !ob)
@@ -82,7 +85,12 @@ static GLList* alloc_list(GLint list) {
 
 	ob->ops[0].op = OP_EndList;
 
-	c->shared_state.lists[list] = l;
+	if (gl_table_set(&c->shared_state->lists, list, l)) {
+		/* past MAX_DISPLAY_LISTS, or the table couldn't grow */
+		gl_pool_free(&c->shared_state->op_buffer_pool, ob);
+		gl_pool_free(&c->shared_state->list_pool, l);
+		return NULL;
+	}
 	return l;
 }
 /*
@@ -145,7 +153,7 @@ void gl_compile_op(GLParam* p) {
 	/* we should be able to add a NextBuffer opcode */
 	if ((index + op_size) > (OP_BUFFER_MAX_SIZE - 2)) {
 
-		ob1 = gl_zalloc(sizeof(GLParamBuffer));
+		ob1 = gl_pool_alloc(&c->shared_state->op_buffer_pool, sizeof(GLParamBuffer));
 
 #if TGL_FEATURE_ERROR_CHECK == 1
 		if (!ob1)
@@ -178,6 +186,162 @@ void glopEndList(GLParam* p) { exit(1); }
 /* this opcode is never called directly */
 void glopNextBuffer(GLParam* p) { exit(1); }
 
+/* a vertex batch of a compiled list, drawn with the client arrays pointing into it */
+void glopListBatch(GLParam* p) {
+#if TGL_FEATURE_LIST_COMPILER == 1
+	GLListBatch* b = (GLListBatch*)p[1].p;
+	/* the attributes of states are packed after the coordinates */
+	GLint color = 4, normal = color + ((b->states & COLOR_ARRAY) ? 4 : 0), texcoord = normal + ((b->states & NORMAL_ARRAY) ? 3 : 0);
+	gl_draw_vertex_batch(b->data, b->count, b->stride, b->states, color, normal, texcoord);
+#else
+	exit(1);
+#endif
+}
+
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+static void gl_bounds_add(GLListBounds* b, const GLfloat* v) {
+	GLint i;
+	for (i = 0; i < 3; i++) {
+		GLfloat x = v[i] / v[3];
+		if (x < b->box[i])
+			b->box[i] = x;
+		if (x > b->box[i + 3])
+			b->box[i + 3] = x;
+	}
+}
+
+/*
+The bounding box of the vertices after the first glBegin. Only lists with nothing but primitives and
+vertex attributes from there on can be culled, the attributes they leave current are kept.
+*/
+static void gl_list_bounds(GLList* l) {
+	GLListBounds* b = &l->bounds;
+	GLParam* p;
+	GLint in_begin = 0;
+
+	b->begin = NULL;
+	b->states = 0;
+	b->edge_flag = -1;
+	b->box[0] = b->box[1] = b->box[2] = 1e30f;
+	b->box[3] = b->box[4] = b->box[5] = -1e30f;
+	for (p = l->first_op_buffer->ops; p[0].op != OP_EndList; p += op_table_size[p[0].op]) {
+		if (p[0].op == OP_NextBuffer) {
+			p = (GLParam*)p[1].p;
+			if (p[0].op == OP_EndList)
+				break;
+		}
+		switch (p[0].op) {
+		case OP_Begin:
+			if (b->begin == NULL)
+				b->begin = p;
+			in_begin = 1;
+			break;
+		case OP_End:
+			in_begin = 0;
+			break;
+		case OP_Vertex:
+			if (p[4].f <= 0)
+				goto uncullable;
+			gl_bounds_add(b, &p[1].f);
+			break;
+		case OP_Color:
+			b->color[0] = p[1].f;
+			b->color[1] = p[2].f;
+			b->color[2] = p[3].f;
+			b->color[3] = p[4].f;
+			b->states |= COLOR_ARRAY;
+			break;
+		case OP_Normal:
+			b->normal[0] = p[1].f;
+			b->normal[1] = p[2].f;
+			b->normal[2] = p[3].f;
+			b->states |= NORMAL_ARRAY;
+			break;
+		case OP_TexCoord:
+			b->tex_coord[0] = p[1].f;
+			b->tex_coord[1] = p[2].f;
+			b->tex_coord[2] = p[3].f;
+			b->tex_coord[3] = p[4].f;
+			b->states |= TEXCOORD_ARRAY;
+			break;
+		case OP_EdgeFlag:
+			b->edge_flag = p[1].i;
+			break;
+#if TGL_FEATURE_LIST_COMPILER == 1
+		case OP_ListBatch: {
+			GLListBatch* lb = (GLListBatch*)p[1].p;
+			GLfloat* d;
+			GLint i;
+			for (i = 0, d = lb->data; i < lb->count; i++, d += lb->stride) {
+				if (d[3] <= 0)
+					goto uncullable;
+				gl_bounds_add(b, d);
+			}
+			d = lb->data + (lb->count - 1) * lb->stride + 4;
+			if (lb->states & COLOR_ARRAY) {
+				b->color[0] = d[0];
+				b->color[1] = d[1];
+				b->color[2] = d[2];
+				b->color[3] = d[3];
+				d += 4;
+			}
+			if (lb->states & NORMAL_ARRAY) {
+				b->normal[0] = d[0];
+				b->normal[1] = d[1];
+				b->normal[2] = d[2];
+				d += 3;
+			}
+			if (lb->states & TEXCOORD_ARRAY) {
+				b->tex_coord[0] = d[0];
+				b->tex_coord[1] = d[1];
+				b->tex_coord[2] = d[2];
+				b->tex_coord[3] = d[3];
+			}
+			b->states |= lb->states;
+		} break;
+#endif
+		default:
+			/* the attributes before the first glBegin are set by running the list up to it */
+			if (b->begin != NULL)
+				goto uncullable;
+			b->states = 0;
+			b->edge_flag = -1;
+		}
+	}
+	if (b->begin != NULL && !in_begin)
+		return;
+uncullable:
+	b->begin = NULL;
+}
+
+/* the list stops at its first glBegin, only the last vertex attributes are set */
+static void gl_list_culled(GLListBounds* b) {
+	GLContext* c = gl_get_context();
+	if (b->states & COLOR_ARRAY) {
+		GLParam p[5];
+		p[1].f = b->color[0];
+		p[2].f = b->color[1];
+		p[3].f = b->color[2];
+		p[4].f = b->color[3];
+		glopColor(p);
+	}
+	if (b->states & NORMAL_ARRAY) {
+		c->current_normal.X = b->normal[0];
+		c->current_normal.Y = b->normal[1];
+		c->current_normal.Z = b->normal[2];
+		c->current_normal.W = 0;
+	}
+	if (b->states & TEXCOORD_ARRAY) {
+		c->current_tex_coord.X = b->tex_coord[0];
+		c->current_tex_coord.Y = b->tex_coord[1];
+		c->current_tex_coord.Z = b->tex_coord[2];
+		c->current_tex_coord.W = b->tex_coord[3];
+	}
+	if (b->edge_flag >= 0)
+		c->current_edge_flag = b->edge_flag;
+}
+#endif
+
 void glopCallList(GLParam* p) {
 	
 	GLList* l;
@@ -204,6 +368,12 @@ void glopCallList(GLParam* p) {
 		if (op == OP_NextBuffer) {
 			p = (GLParam*)p[1].p;
 		} else {
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+			if (p == l->bounds.begin && gl_box_culled(l->bounds.box)) {
+				gl_list_culled(&l->bounds);
+				break;
+			}
+#endif
 			op_table_func[op](p);
 			p += op_table_size[op];
 		}
@@ -245,11 +415,230 @@ void glNewList(GLuint list, GLint mode) {
 #endif
 		c->current_op_buffer = l->first_op_buffer;
 	c->current_op_buffer_index = 0;
+#if TGL_FEATURE_LIST_COMPILER == 1 || TGL_FEATURE_FRUSTUM_CULLING == 1
+	c->current_list = l;
+#endif
 
 	c->compile_flag = 1;
 	c->exec_flag = (mode == GL_COMPILE_AND_EXECUTE);
 }
 
+#if TGL_FEATURE_LIST_COMPILER == 1
+void gl_free_list_batches(GLList* l) {
+	GLListBatch *b, *n;
+	for (b = l->batches; b != NULL; b = n) {
+		n = b->next;
+		gl_free(b);
+	}
+	l->batches = NULL;
+}
+
+/* state ops whose effect is entirely replaced by the same op right after them */
+static GLint gl_op_overridden(GLint op) {
+	return op == OP_Color || op == OP_Normal || op == OP_TexCoord || op == OP_EdgeFlag || op == OP_MatrixMode ||
+		   op == OP_ShadeModel || op == OP_CullFace || op == OP_FrontFace;
+}
+
+static GLint gl_op_matrix(GLint op) {
+	return op == OP_LoadIdentity || op == OP_LoadMatrix || op == OP_MultMatrix || op == OP_Translate || op == OP_Rotate ||
+		   op == OP_Scale;
+}
+
+static GLint gl_op_vertex(GLint op) { return op == OP_Color || op == OP_Normal || op == OP_TexCoord || op == OP_Vertex; }
+
+/*
+Matrix ops ops[i..k). A load makes everything before it useless, what follows is multiplied once here
+(with the ops themselves, on the current matrix which is restored) into a single load or multiplication.
+*/
+static void gl_compile_matrix_ops(GLParam** ops, GLint i, GLint k) {
+	GLContext* c = gl_get_context();
+	M4* top = c->matrix_stack_ptr[c->matrix_mode];
+	M4 saved = *top;
+	GLint updated = c->matrix_model_projection_updated;
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	GLubyte kind = gl_matrix_kind(c, c->matrix_mode);
+#endif
+	GLint j, r, load = 0;
+	GLParam p[17];
+
+	for (j = i; j < k; j++)
+		if (ops[j][0].op == OP_LoadIdentity || ops[j][0].op == OP_LoadMatrix) {
+			i = j;
+			load = 1;
+		}
+	if (k - i == 1) {
+		gl_compile_op(ops[i]);
+		return;
+	}
+	gl_M4_Id(top);
+	for (j = i; j < k; j++)
+		op_table_func[ops[j][0].op](ops[j]);
+	p[0].op = load ? OP_LoadMatrix : OP_MultMatrix;
+	for (j = 0; j < 4; j++)
+		for (r = 0; r < 4; r++)
+			p[1 + j * 4 + r].f = top->m[r][j];
+	*top = saved;
+	c->matrix_model_projection_updated = updated;
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	gl_matrix_kind(c, c->matrix_mode) = kind;
+#endif
+	gl_compile_op(p);
+}
+
+/*
+Colors, normals, texture coordinates and vertices ops[i..k) between glBegin and glEnd. The vertices become
+batches with the attribute values current at each vertex. An attribute only goes in a batch once it has been
+set in the run, so a new batch starts when the first vertices still use the value from before the list.
+The attribute ops after the last vertex are kept.
+*/
+static void gl_compile_vertex_ops(GLList* l, GLParam** ops, GLint i, GLint k) {
+	GLfloat cur[11] = {0};
+	GLint states = 0, last = -1, j;
+	GLListBatch* b = NULL;
+
+	for (j = i; j < k; j++)
+		if (ops[j][0].op == OP_Vertex)
+			last = j;
+	for (j = i; j <= last; j++) {
+		GLParam* p = ops[j];
+		GLfloat* d;
+		switch (p[0].op) {
+		case OP_Color:
+			cur[0] = p[1].f;
+			cur[1] = p[2].f;
+			cur[2] = p[3].f;
+			cur[3] = p[4].f;
+			states |= COLOR_ARRAY;
+			continue;
+		case OP_Normal:
+			cur[4] = p[1].f;
+			cur[5] = p[2].f;
+			cur[6] = p[3].f;
+			states |= NORMAL_ARRAY;
+			continue;
+		case OP_TexCoord:
+			cur[7] = p[1].f;
+			cur[8] = p[2].f;
+			cur[9] = p[3].f;
+			cur[10] = p[4].f;
+			states |= TEXCOORD_ARRAY;
+			continue;
+		}
+		if (b == NULL || b->states != states) {
+			GLint n = 0, stride = 4 + ((states & COLOR_ARRAY) ? 4 : 0) + ((states & NORMAL_ARRAY) ? 3 : 0) +
+								  ((states & TEXCOORD_ARRAY) ? 4 : 0);
+			GLint m;
+			GLParam q[2];
+			for (m = j; m <= last; m++)
+				n += ops[m][0].op == OP_Vertex;
+			b = gl_malloc(sizeof(GLListBatch) + n * stride * sizeof(GLfloat));
+			if (!b) {
+				/* keep the ops as they are */
+				for (; j < k; j++)
+					gl_compile_op(ops[j]);
+				return;
+			}
+			b->next = l->batches;
+			l->batches = b;
+			b->count = 0;
+			b->states = states;
+			b->stride = stride;
+			q[0].op = OP_ListBatch;
+			q[1].p = b;
+			gl_compile_op(q);
+		}
+		d = b->data + b->count++ * b->stride;
+		d[0] = p[1].f;
+		d[1] = p[2].f;
+		d[2] = p[3].f;
+		d[3] = p[4].f;
+		d += 4;
+		if (states & COLOR_ARRAY) {
+			d[0] = cur[0];
+			d[1] = cur[1];
+			d[2] = cur[2];
+			d[3] = cur[3];
+			d += 4;
+		}
+		if (states & NORMAL_ARRAY) {
+			d[0] = cur[4];
+			d[1] = cur[5];
+			d[2] = cur[6];
+			d += 3;
+		}
+		if (states & TEXCOORD_ARRAY) {
+			d[0] = cur[7];
+			d[1] = cur[8];
+			d[2] = cur[9];
+			d[3] = cur[10];
+		}
+	}
+	for (j = last + 1; j < k; j++)
+		if (!(j + 1 < k && ops[j + 1][0].op == ops[j][0].op))
+			gl_compile_op(ops[j]);
+}
+
+/* rewrites the ops of a list that was just closed, see TGL_FEATURE_LIST_COMPILER */
+static void gl_optimize_list(GLList* l) {
+	GLContext* c = gl_get_context();
+	GLParamBuffer *pb, *pb1;
+	GLParam *p, **ops;
+	GLint n = 0, i, k, in_begin = 0;
+
+	for (p = l->first_op_buffer->ops;; p += op_table_size[p[0].op]) {
+		if (p[0].op == OP_NextBuffer)
+			p = (GLParam*)p[1].p;
+		n++;
+		if (p[0].op == OP_EndList)
+			break;
+	}
+	ops = gl_malloc(n * sizeof(GLParam*));
+	pb = gl_pool_alloc(&c->shared_state->op_buffer_pool, sizeof(GLParamBuffer));
+	if (!ops || !pb) {
+		/* the list works as it is */
+		gl_free(ops);
+		gl_pool_free(&c->shared_state->op_buffer_pool, pb);
+		return;
+	}
+	n = 0;
+	for (p = l->first_op_buffer->ops;; p += op_table_size[p[0].op]) {
+		if (p[0].op == OP_NextBuffer)
+			p = (GLParam*)p[1].p;
+		ops[n++] = p;
+		if (p[0].op == OP_EndList)
+			break;
+	}
+
+	c->current_op_buffer = pb;
+	c->current_op_buffer_index = 0;
+	for (i = 0; i < n; i = k) {
+		GLint op = ops[i][0].op;
+		k = i + 1;
+		if (in_begin && gl_op_vertex(op)) {
+			while (k < n && gl_op_vertex(ops[k][0].op))
+				k++;
+			gl_compile_vertex_ops(l, ops, i, k);
+		} else if (gl_op_matrix(op)) {
+			while (k < n && gl_op_matrix(ops[k][0].op))
+				k++;
+			gl_compile_matrix_ops(ops, i, k);
+		} else if (!(gl_op_overridden(op) && ops[k][0].op == op)) {
+			in_begin = (op == OP_Begin) || (in_begin && op != OP_End);
+			gl_compile_op(ops[i]);
+		}
+	}
+
+	pb1 = l->first_op_buffer;
+	l->first_op_buffer = pb;
+	while (pb1 != NULL) {
+		pb = pb1->next;
+		gl_pool_free(&c->shared_state->op_buffer_pool, pb1);
+		pb1 = pb;
+	}
+	gl_free(ops);
+}
+#endif
+
 void glEndList(void) {
 	GLContext* c = gl_get_context();
 	GLParam p[1];
@@ -265,6 +654,12 @@ void glEndList(void) {
 		/* end of list */
 		p[0].op = OP_EndList;
 	gl_compile_op(p);
+#if TGL_FEATURE_LIST_COMPILER == 1
+	gl_optimize_list(c->current_list);
+#endif
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+	gl_list_bounds(c->current_list);
+#endif
 
 	c->compile_flag = 0;
 	c->exec_flag = 1;
@@ -278,26 +673,15 @@ GLint glIsList(GLuint list) {
 }
 
 GLuint glGenLists(GLint range) {
-	GLint count, i, list;
-	GLList** lists;
+	GLint i, list;
 	GLContext* c = gl_get_context();
 #define RETVAL 0
 #include "error_check.h"
-	lists = c->shared_state.lists;
-	count = 0;
-	for (i = 0; i < MAX_DISPLAY_LISTS; i++) {
-		if (lists[i] == NULL) {
-			count++;
-			if (count == range) {
-				list = i - range + 1;
-				for (i = 0; i < range; i++) {
-					alloc_list(list + i);
-				}
-				return list;
-			}
-		} else {
-			count = 0;
-		}
+	list = gl_table_find_free(&c->shared_state->lists, range);
+	if (list < 0)
+		return 0;
+	for (i = 0; i < range; i++) {
+		alloc_list(list + i);
 	}
-	return 0;
+	return list;
 }
@@ -10,8 +10,57 @@ void gl_print_matrix(const GLfloat* m) {
 
 static void gl_matrix_update() {
 	GLContext* c = gl_get_context();
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	static const GLint dirty[3] = {TGL_MATRIX_DIRTY_MVP | TGL_MATRIX_DIRTY_NORMAL, TGL_MATRIX_DIRTY_MVP, TGL_MATRIX_DIRTY_TEXTURE};
+	c->matrix_model_projection_updated |= dirty[c->matrix_mode];
+#else
 	c->matrix_model_projection_updated = (c->matrix_mode <= 1);
+#endif
+#if TGL_FEATURE_FIXED_POINT == 1
+	c->matrix_fixed_dirty = TGL_MATRIX_FIXED_ALL;
+#endif
+}
+
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+/* the top of the current stack was multiplied by a matrix of this kind */
+static void gl_matrix_kind_update(GLint kind) {
+	GLContext* c = gl_get_context();
+	if (gl_matrix_kind(c, c->matrix_mode) < kind)
+		gl_matrix_kind(c, c->matrix_mode) = kind;
+}
+
+void gl_compute_model_projection(void) {
+	GLContext* c = gl_get_context();
+	GLfloat* m = &c->matrix_model_projection.m[0][0];
+	if (!(c->matrix_model_projection_updated & TGL_MATRIX_DIRTY_MVP))
+		return;
+	gl_M4_Mul(&c->matrix_model_projection, c->matrix_stack_ptr[1], c->matrix_stack_ptr[0]);
+	c->matrix_model_projection_no_w_transform = (m[12] == 0.0 && m[13] == 0.0 && m[14] == 0.0);
+	c->matrix_model_projection_updated &= ~TGL_MATRIX_DIRTY_MVP;
+}
+
+/* transposed inverse of the modelview, for the normals */
+void gl_compute_normal_matrix(void) {
+	GLContext* c = gl_get_context();
+	M4 tmp;
+	if (!(c->matrix_model_projection_updated & TGL_MATRIX_DIRTY_NORMAL))
+		return;
+	switch (gl_matrix_kind(c, 0)) {
+	case TGL_MATRIX_RIGID:
+		gl_M4_InvOrtho(&tmp, *c->matrix_stack_ptr[0]);
+		break;
+	case TGL_MATRIX_AFFINE:
+		if (!gl_M4_InvAffine(&tmp, c->matrix_stack_ptr[0]))
+			break;
+		/* fall through */
+	default:
+		gl_M4_Inv(&tmp, c->matrix_stack_ptr[0]);
+		break;
+	}
+	gl_M4_Transpose(&c->matrix_model_view_inv, &tmp);
+	c->matrix_model_projection_updated &= ~TGL_MATRIX_DIRTY_NORMAL;
 }
+#endif
 
 void glopMatrixMode(GLParam* p) {
 	GLContext* c = gl_get_context();
@@ -49,6 +98,9 @@ void glopLoadMatrix(GLParam* p) {
 		m->m[3][i] = q[3].f;
 		q += 4;
 	}
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	gl_matrix_kind(c, c->matrix_mode) = gl_M4_IsAffine(m) ? TGL_MATRIX_AFFINE : TGL_MATRIX_GENERAL;
+#endif
 
 	gl_matrix_update();
 }
@@ -57,6 +109,9 @@ void glopLoadIdentity(GLParam* p) {
 	GLContext* c = gl_get_context();
 
 	gl_M4_Id(c->matrix_stack_ptr[c->matrix_mode]);
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	gl_matrix_kind(c, c->matrix_mode) = TGL_MATRIX_RIGID;
+#endif
 
 	gl_matrix_update();
 }
@@ -78,6 +133,9 @@ void glopMultMatrix(GLParam* p) {
 	}
 
 	gl_M4_MulLeft(c->matrix_stack_ptr[c->matrix_mode], &m);
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	gl_matrix_kind_update(gl_M4_IsAffine(&m) ? TGL_MATRIX_AFFINE : TGL_MATRIX_GENERAL);
+#endif
 
 	gl_matrix_update();
 }
@@ -96,8 +154,12 @@ void glopPushMatrix(GLParam* p) {
 		m = ++c->matrix_stack_ptr[n];
 
 	gl_M4_Move(&m[0], &m[-1]);
-
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	/* same top, nothing to recompute */
+	c->matrix_stack_kind[n][m - c->matrix_stack[n]] = c->matrix_stack_kind[n][m - 1 - c->matrix_stack[n]];
+#else
 	gl_matrix_update();
+#endif
 }
 
 void glopPopMatrix(GLParam* p) {
@@ -159,6 +221,10 @@ void glopRotate(GLParam* p) {
 		if (len == 0.0f)
 			return;
 		len = fastInvSqrt(len); /* FISR*/
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+		/* not exactly normalized */
+		gl_matrix_kind_update(TGL_MATRIX_AFFINE);
+#endif
 #else
 		GLfloat len = u[0] * u[0] + u[1] * u[1] + u[2] * u[2];
 		if (len == 0.0f)
@@ -189,7 +255,11 @@ void glopRotate(GLParam* p) {
 	}
 	}
 
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	gl_M4_MulLeft3(c->matrix_stack_ptr[c->matrix_mode], &m);
+#else
 	gl_M4_MulLeft(c->matrix_stack_ptr[c->matrix_mode], &m);
+#endif
 
 	gl_matrix_update();
 }
@@ -213,6 +283,9 @@ void glopScale(GLParam* p) {
 	m[12] *= x;
 	m[13] *= y;
 	m[14] *= z;
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	gl_matrix_kind_update(TGL_MATRIX_AFFINE);
+#endif
 	gl_matrix_update();
 }
 
@@ -269,6 +342,9 @@ void glopFrustum(GLParam* p) {
 	r[15] = 0;
 
 	gl_M4_MulLeft(c->matrix_stack_ptr[c->matrix_mode], &m);
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	gl_matrix_kind_update(TGL_MATRIX_GENERAL);
+#endif
 
 	gl_matrix_update();
 }
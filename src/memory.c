@@ -6,15 +6,227 @@ static inline void required_for_compilation_(){
 	return;
 }
 
-#if TGL_FEATURE_CUSTOM_MALLOC == 1
 #include "zgl.h"
 
-/* modify these functions so that they suit your needs */
+#if TGL_FEATURE_CUSTOM_MALLOC == 1
 
 #include <string.h>
+#if TGL_FEATURE_ARENA_SIZE > 0
+/* the free list is only guarded by an OpenMP critical section, which is a no-op without -fopenmp */
+#if TGL_FEATURE_MULTI_CONTEXT == 1 && !defined(_OPENMP)
+#error "TGL_FEATURE_ARENA_SIZE with TGL_FEATURE_MULTI_CONTEXT needs OpenMP (-fopenmp)"
+#endif
+/*
+First fit in a static arena. The free blocks are kept in address order and merged with their neighbours when freed.
+Blocks are 16-byte aligned (TGL_FEATURE_ALIGNAS) and start with their size.
+*/
+#define TGL_ARENA_ALIGN 16
+
+typedef struct GLArenaBlock {
+	size_t size; /* including the header */
+	struct GLArenaBlock* next; /* free blocks only */
+} GLArenaBlock;
+
+static long long gl_arena[(TGL_FEATURE_ARENA_SIZE + TGL_ARENA_ALIGN) / sizeof(long long)];
+static GLArenaBlock* gl_arena_free;
+static size_t gl_arena_used, gl_arena_peak;
+
+static void gl_arena_init(void) {
+	GLArenaBlock* b = (GLArenaBlock*)(((size_t)gl_arena + TGL_ARENA_ALIGN - 1) & ~(size_t)(TGL_ARENA_ALIGN - 1));
+	b->size = TGL_FEATURE_ARENA_SIZE & ~(size_t)(TGL_ARENA_ALIGN - 1);
+	b->next = NULL;
+	gl_arena_free = b;
+}
+
+void* gl_malloc(GLint size) {
+	size_t need = ((size_t)size + 2 * TGL_ARENA_ALIGN - 1) & ~(size_t)(TGL_ARENA_ALIGN - 1);
+	GLArenaBlock **pb, *b = NULL;
+	if (size < 0)
+		return NULL;
+#ifdef _OPENMP
+#pragma omp critical(tgl_arena)
+#endif
+	{
+		if (!gl_arena_free && !gl_arena_used)
+			gl_arena_init();
+		for (pb = &gl_arena_free; (b = *pb) != NULL; pb = &b->next)
+			if (b->size >= need)
+				break;
+		if (b) {
+			if (b->size - need >= 2 * TGL_ARENA_ALIGN) {
+				/* split, the rest stays free */
+				GLArenaBlock* rest = (GLArenaBlock*)((GLubyte*)b + need);
+				rest->size = b->size - need;
+				rest->next = b->next;
+				*pb = rest;
+				b->size = need;
+			} else {
+				*pb = b->next;
+			}
+			gl_arena_used += b->size;
+			if (gl_arena_used > gl_arena_peak)
+				gl_arena_peak = gl_arena_used;
+		}
+	}
+	return b ? (GLubyte*)b + TGL_ARENA_ALIGN : NULL;
+}
+
+void* gl_zalloc(GLint size) {
+	void* p = gl_malloc(size);
+	if (p)
+		memset(p, 0, size);
+	return p;
+}
+
+void gl_free(void* p) {
+	GLArenaBlock *b, **pb, *prev = NULL;
+	if (!p)
+		return;
+	b = (GLArenaBlock*)((GLubyte*)p - TGL_ARENA_ALIGN);
+#ifdef _OPENMP
+#pragma omp critical(tgl_arena)
+#endif
+	{
+		gl_arena_used -= b->size;
+		for (pb = &gl_arena_free; *pb && *pb < b; pb = &(*pb)->next)
+			prev = *pb;
+		b->next = *pb;
+		*pb = b;
+		if (b->next && (GLubyte*)b + b->size == (GLubyte*)b->next) {
+			b->size += b->next->size;
+			b->next = b->next->next;
+		}
+		if (prev && (GLubyte*)prev + prev->size == (GLubyte*)b) {
+			prev->size += b->size;
+			prev->next = b->next;
+		}
+	}
+}
+
+GLint gl_arena_in_use(void) { return (GLint)gl_arena_used; }
+
+GLint gl_arena_high_water(void) { return (GLint)gl_arena_peak; }
+
+#else
+/* modify these functions so that they suit your needs */
+
+#if TGL_FEATURE_ALIGNAS == 1
+/* must stay 16-byte aligned, see gl_aligned_malloc in zbuffer.h */
+void* gl_malloc(GLint size) { return gl_aligned_malloc(size); }
+
+void* gl_zalloc(GLint size) {
+	void* p = gl_aligned_malloc(size);
+	if (p)
+		memset(p, 0, size);
+	return p;
+}
+
+void gl_free(void* p) { gl_aligned_free(p); }
+#else
 void gl_free(void* p) { free(p); }
 
 void* gl_malloc(GLint size) { return malloc(size); }
 
 void* gl_zalloc(GLint size) { return calloc(1, size); }
 #endif
+#endif
+#endif
+
+#if TGL_FEATURE_POOLS == 1
+void gl_pool_init(GLPool* p, GLint size) {
+	p->free_list = NULL;
+	/* a free block holds the link to the next one */
+	p->size = size < (GLint)sizeof(void*) ? (GLint)sizeof(void*) : size;
+}
+
+void* gl_pool_get(GLPool* p) {
+	void* b = p->free_list;
+	if (b) {
+		memcpy(&p->free_list, b, sizeof(void*));
+		memset(b, 0, p->size);
+		return b;
+	}
+	return gl_zalloc(p->size);
+}
+
+void gl_pool_put(GLPool* p, void* b) {
+	if (!b)
+		return;
+	memcpy(b, &p->free_list, sizeof(void*));
+	p->free_list = b;
+}
+
+/* gives the free blocks back to gl_free */
+void gl_pool_release(GLPool* p) {
+	void* b;
+	while ((b = p->free_list) != NULL) {
+		memcpy(&p->free_list, b, sizeof(void*));
+		gl_free(b);
+	}
+}
+#endif
+
+GLint gl_table_init(GLTable* t, GLint size, GLint limit) {
+	if (size > limit)
+		size = limit;
+	t->slots = gl_zalloc(sizeof(void*) * size);
+	t->size = t->slots ? size : 0;
+	t->limit = limit;
+	t->free_hint = 0;
+	return t->slots == NULL;
+}
+
+/* stores obj under h, growing the table if needed. Returns 1 if h is out of range or out of memory. */
+GLint gl_table_set(GLTable* t, GLint h, void* obj) {
+	if (h < 0 || h >= t->limit)
+		return 1;
+	if (h >= t->size) {
+		GLint size = t->size > 0 ? t->size : 1;
+		void** slots;
+		if (!obj)
+			return 0;
+		while (size <= h)
+			size *= 2;
+		if (size > t->limit)
+			size = t->limit;
+		slots = gl_malloc(sizeof(void*) * size);
+		if (!slots)
+			return 1;
+		if (t->slots)
+			memcpy(slots, t->slots, sizeof(void*) * t->size);
+		memset(slots + t->size, 0, sizeof(void*) * (size - t->size));
+		gl_free(t->slots);
+		t->slots = slots;
+		t->size = size;
+	}
+	t->slots[h] = obj;
+	if (!obj) {
+		if (h < t->free_hint)
+			t->free_hint = h;
+	} else if (h == t->free_hint) {
+		while (t->free_hint < t->size && t->slots[t->free_hint])
+			t->free_hint++;
+	}
+	return 0;
+}
+
+/* first of n consecutive free handles, -1 if there are none */
+GLint gl_table_find_free(GLTable* t, GLint n) {
+	GLint h, count = 0;
+	if (n < 1)
+		return -1;
+	for (h = t->free_hint; h < t->limit; h++) {
+		if (h < t->size && t->slots[h])
+			count = 0;
+		else if (++count == n)
+			return h - n + 1;
+	}
+	return -1;
+}
+
+void gl_table_free(GLTable* t) {
+	gl_free(t->slots);
+	t->slots = NULL;
+	t->size = 0;
+	t->free_hint = 0;
+}
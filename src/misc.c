@@ -256,4 +256,4 @@ void glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format
 	/* TODO: implement read pixels.*/
 }
 
-void glFinish() { return; }
+void glFinish() { ZB_flushTiles(gl_get_context()->zb); }
@@ -41,6 +41,9 @@ ADD_OP(LoadName, 1, "%d")
 ADD_OP(TexImage2D, 9, "%d %d %d  %d %d %d  %d %d %d")
 ADD_OP(TexImage1D, 8, "%d %d  %d %d %d  %d %d %d")
 ADD_OP(CopyTexImage2D, 8, "%d %d %d %d  %d %d %d %d")
+ADD_OP(ColorTable, 6, "%C %C %d %C %C %p")
+ADD_OP(CompressedTexImage2D, 8, "%C %d %C %d %d %d %d %p")
+ADD_OP(TexSubImage2D, 9, "%C %d %d %d %d %d %C %C %p")
 ADD_OP(BindTexture, 2, "%C %d")
 
 
@@ -57,9 +60,12 @@ ADD_OP(CallList, 1, "%d")
 /* special opcodes */
 ADD_OP(EndList, 0, "")
 ADD_OP(NextBuffer, 1, "%p")
+ADD_OP(ListBatch, 1, "%p")
 
 /* opengl 1.1 arrays */
 ADD_OP(ArrayElement, 1, "%d")
+ADD_OP(DrawArrays, 3, "%C %d %d")
+ADD_OP(DrawElements, 4, "%C %d %C %p")
 ADD_OP(EnableClientState, 1, "%C")
 ADD_OP(DisableClientState, 1, "%C")
 ADD_OP(VertexPointer, 4, "%d %C %d %p")
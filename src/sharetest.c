@@ -0,0 +1,109 @@
+/*
+ * sharetest.c -- changes a shared texture while another context still has triangles binned with it.
+ *
+ * Needs TGL_FEATURE_MULTI_CONTEXT and TGL_FEATURE_MULTITHREADED_TILED_RASTER in zfeatures.h. Context B shares the
+ * textures of context A and bins a red textured quad. A then uploads the texture again (same size, other size) or
+ * deletes it, and B flushes. The quad must have been drawn red from the texels it was given, before they changed.
+ * Build it with -fsanitize=address as well, a freed texture read by B is then reported too.
+ *
+ * gcc -O2 sharetest.c -o sharetest libTinyGL.a -lm && ./sharetest
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "gl.h"
+#include "zbuffer.h"
+
+#if TGL_FEATURE_MULTI_CONTEXT == 1 && TGL_FEATURE_MULTITHREADED_TILED_RASTER == 1
+
+#define WIDTH 160
+#define HEIGHT 120
+
+static GLubyte red[64 * 64 * 3], green[64 * 64 * 3];
+
+static void draw_quad(void) {
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_TEXTURE_2D);
+	glBegin(GL_QUADS);
+	glTexCoord2f(0, 0);
+	glVertex3f(-0.5f, -0.5f, 0);
+	glTexCoord2f(1, 0);
+	glVertex3f(0.5f, -0.5f, 0);
+	glTexCoord2f(1, 1);
+	glVertex3f(0.5f, 0.5f, 0);
+	glTexCoord2f(0, 1);
+	glVertex3f(-0.5f, 0.5f, 0);
+	glEnd();
+}
+
+/* pixels of the middle of the quad that aren't red */
+static GLint not_red(ZBuffer* zb) {
+	GLint x, y, n = 0;
+	for (y = HEIGHT / 2 - 10; y < HEIGHT / 2 + 10; y++)
+		for (x = WIDTH / 2 - 20; x < WIDTH / 2 + 20; x++) {
+			PIXEL p = zb->pbuf[y * WIDTH + x];
+			n += GET_RED(p) < 0xc0 || GET_GREEN(p) > 0x40;
+		}
+	return n;
+}
+
+int main(void) {
+	static const char* names[3] = {"same size", "other size", "deleted"};
+	ZBuffer* zba = ZB_open(WIDTH, HEIGHT, TGL_FEATURE_RENDER_BITS == 16 ? ZB_MODE_5R6G5B : ZB_MODE_RGBA, 0);
+	ZBuffer* zbb = ZB_open(WIDTH, HEIGHT, TGL_FEATURE_RENDER_BITS == 16 ? ZB_MODE_5R6G5B : ZB_MODE_RGBA, 0);
+	void *a, *b;
+	GLuint tex;
+	GLint i, test, failed = 0;
+
+	for (i = 0; i < 64 * 64; i++) {
+		red[i * 3] = 255;
+		green[i * 3 + 1] = 255;
+	}
+	glInit(zba);
+	a = glGetCurrentContext();
+	b = glCreateContext(zbb, a);
+	glMakeCurrent(b);
+	glViewport(0, 0, WIDTH, HEIGHT);
+
+	for (test = 0; test < 3; test++) {
+		GLint n;
+		glMakeCurrent(a);
+		glGenTextures(1, &tex);
+		glBindTexture(GL_TEXTURE_2D, tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, 3, 64, 64, 0, GL_RGB, GL_UNSIGNED_BYTE, red);
+		glMakeCurrent(b);
+		glBindTexture(GL_TEXTURE_2D, tex);
+		draw_quad();
+		glMakeCurrent(a);
+		if (test == 0)
+			glTexImage2D(GL_TEXTURE_2D, 0, 3, 64, 64, 0, GL_RGB, GL_UNSIGNED_BYTE, green);
+		else if (test == 1)
+			glTexImage2D(GL_TEXTURE_2D, 0, 3, 32, 32, 0, GL_RGB, GL_UNSIGNED_BYTE, green);
+		else
+			glDeleteTextures(1, &tex);
+		glMakeCurrent(b);
+		glFlush();
+		n = not_red(zbb);
+		printf("%-10s %d pixels not red\n", names[test], n);
+		failed += n != 0;
+		glMakeCurrent(a);
+		if (test < 2)
+			glDeleteTextures(1, &tex);
+	}
+
+	glMakeCurrent(NULL);
+	glDestroyContext(b);
+	glClose();
+	ZB_close(zbb);
+	ZB_close(zba);
+	printf(failed ? "FAILED\n" : "OK\n");
+	return failed ? 1 : 0;
+}
+
+#else
+
+int main(void) {
+	printf("sharetest needs TGL_FEATURE_MULTI_CONTEXT and TGL_FEATURE_MULTITHREADED_TILED_RASTER\n");
+	return 1;
+}
+
+#endif
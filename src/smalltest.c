@@ -0,0 +1,105 @@
+/*
+ * smalltest.c -- checks the small triangle path against the half-space rasterizer.
+ *
+ * Needs TGL_FEATURE_SMALL_TRIANGLES (and so TGL_FEATURE_HALFSPACE_RASTER) in zfeatures.h. The same random small
+ * triangles, textured with perspective, smooth shaded and flat, are drawn once through the small triangle path
+ * and once with zb->small_triangle_size at 0, which sends them to the half-space rasterizer. It fails when the
+ * colors or the depths of the two frames differ anywhere.
+ *
+ * gcc -O2 smalltest.c -o smalltest libTinyGL.a -lm && ./smalltest
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gl.h"
+#include "zbuffer.h"
+
+#if TGL_FEATURE_SMALL_TRIANGLES == 1
+
+#define WIDTH 320
+#define HEIGHT 240
+#define NB_TRIANGLES 4000
+
+static GLubyte img[64 * 64 * 3];
+static PIXEL colors[WIDTH * HEIGHT];
+static GLushort depths[WIDTH * HEIGHT];
+
+static GLfloat frand(void) { return (rand() % 10000) / 10000.0f; }
+
+static void draw(ZBuffer* zb, GLint mode, GLint size) {
+	GLint i, k;
+	zb->small_triangle_size = size;
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glShadeModel(mode == 2 ? GL_FLAT : GL_SMOOTH);
+	if (mode == 0)
+		glEnable(GL_TEXTURE_2D);
+	else
+		glDisable(GL_TEXTURE_2D);
+	srand(7);
+	glBegin(GL_TRIANGLES);
+	for (i = 0; i < NB_TRIANGLES; i++) {
+		/* a point of the screen at some depth, and vertices up to 7 pixels away from it */
+		GLfloat x = frand() * WIDTH, y = frand() * HEIGHT, d = 1.5f + frand() * 8;
+		for (k = 0; k < 3; k++) {
+			GLfloat vd = d + frand() * 0.5f;
+			glColor3f(frand(), frand(), frand());
+			glTexCoord2f(frand() * 4, frand() * 4);
+			glVertex3f(((x + frand() * 7) / (WIDTH / 2) - 1) * vd, ((y + frand() * 7) / (HEIGHT / 2) - 1) * vd * 0.75f, -vd);
+		}
+	}
+	glEnd();
+	glFinish();
+}
+
+int main(void) {
+	static const char* names[3] = {"textured", "smooth", "flat"};
+	ZBuffer* zb = ZB_open(WIDTH, HEIGHT, TGL_FEATURE_RENDER_BITS == 16 ? ZB_MODE_5R6G5B : ZB_MODE_RGBA, 0);
+	GLuint tex;
+	GLint i, mode, failed = 0;
+
+	glInit(zb);
+	glViewport(0, 0, WIDTH, HEIGHT);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glFrustum(-1, 1, -0.75, 0.75, 1, 20);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glEnable(GL_DEPTH_TEST);
+	srand(1);
+	for (i = 0; i < 64 * 64 * 3; i++)
+		img[i] = (GLubyte)rand();
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, 3, 64, 64, 0, GL_RGB, GL_UNSIGNED_BYTE, img);
+
+	for (mode = 0; mode < 3; mode++) {
+		GLint small, ncolors = 0, ndepths = 0;
+		draw(zb, mode, TGL_SMALL_TRIANGLE_SIZE);
+		glGetIntegerv(GL_SMALL_TRIANGLE_COUNT, &small);
+		memcpy(colors, zb->pbuf, sizeof(colors));
+		memcpy(depths, zb->zbuf, sizeof(depths));
+		draw(zb, mode, 0);
+		for (i = 0; i < WIDTH * HEIGHT; i++) {
+			ncolors += colors[i] != zb->pbuf[i];
+			ndepths += depths[i] != zb->zbuf[i];
+		}
+		printf("%-8s %d small triangles, %d colors and %d depths differ\n", names[mode], small, ncolors, ndepths);
+		if (ncolors || ndepths || !small)
+			failed++;
+	}
+
+	glDeleteTextures(1, &tex);
+	glClose();
+	ZB_close(zb);
+	printf(failed ? "FAILED\n" : "OK\n");
+	return failed ? 1 : 0;
+}
+
+#else
+
+int main(void) {
+	printf("smalltest needs TGL_FEATURE_SMALL_TRIANGLES\n");
+	return 1;
+}
+
+#endif
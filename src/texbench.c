@@ -0,0 +1,124 @@
+/*
+ * texbench.c -- texture cache behaviour of rotated quads.
+ *
+ * Draws a textured 640x480 quad rotated by 0, 30, 60 and 90 degrees and prints the time per frame. Then it runs a
+ * model of a 32 KB, 8-way, 64-byte line L1 cache over the texel addresses of the same rotations, taken with
+ * ST_TO_TEXTURE_BYTE_OFFSET on the texture the library just drew with, so it follows the layout it was built
+ * with. Build it once with TGL_FEATURE_TILED_TEXTURES 0 and once with 1 in zfeatures.h to compare the two.
+ *
+ * gcc -O2 texbench.c -o texbench libTinyGL.a -lm && ./texbench
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "gl.h"
+#include "zbuffer.h"
+
+#define WIDTH 640
+#define HEIGHT 480
+#define NB_FRAMES 400
+
+#define DEG_TO_RAD (3.14159265358979 / 180)
+
+#define CACHE_SETS 64
+#define CACHE_WAYS 8
+#define CACHE_LINE_LOG2 6
+
+static GLubyte img[TGL_FEATURE_TEXTURE_DIM * TGL_FEATURE_TEXTURE_DIM * 3];
+
+/* the lines of each set, most recently used first */
+static GLuint cache[CACHE_SETS][CACHE_WAYS];
+
+/* 1 on a miss */
+static GLint cache_access(GLuint addr) {
+	GLuint line = (addr >> CACHE_LINE_LOG2) + 1;
+	GLuint* set = cache[line % CACHE_SETS];
+	GLint i, miss = 1;
+	for (i = 0; i < CACHE_WAYS; i++)
+		if (set[i] == line) {
+			miss = 0;
+			break;
+		}
+	/* the least recently used line goes on a miss */
+	if (miss)
+		i = CACHE_WAYS - 1;
+	for (; i > 0; i--)
+		set[i] = set[i - 1];
+	set[0] = line;
+	return miss;
+}
+
+/* misses per pixel of a WIDTHxHEIGHT screen stepping scale texels per pixel, rotated by a degrees */
+static GLfloat miss_rate(const ZBTexture* texture, GLint a, GLfloat scale) {
+	GLfloat ca = cos(a * DEG_TO_RAD) * scale, sa = sin(a * DEG_TO_RAD) * scale;
+	GLfloat texel_s = (GLfloat)(ZB_POINT_S_MAX - ZB_POINT_S_MIN) / TGL_FEATURE_TEXTURE_DIM;
+	GLfloat texel_t = (GLfloat)(ZB_POINT_T_MAX - ZB_POINT_T_MIN) / TGL_FEATURE_TEXTURE_DIM;
+	GLint x, y, misses = 0;
+	for (x = 0; x < CACHE_SETS * CACHE_WAYS; x++)
+		cache[x / CACHE_WAYS][x % CACHE_WAYS] = 0;
+	for (y = 0; y < HEIGHT; y++)
+		for (x = 0; x < WIDTH; x++) {
+			/* kept positive and inside the texture, the masks do the rest */
+			GLfloat u = fmod(ca * x - sa * y + 64 * TGL_FEATURE_TEXTURE_DIM, TGL_FEATURE_TEXTURE_DIM);
+			GLfloat v = fmod(sa * x + ca * y + 64 * TGL_FEATURE_TEXTURE_DIM, TGL_FEATURE_TEXTURE_DIM);
+			GLuint s = (GLuint)(u * texel_s), t = (GLuint)(v * texel_t);
+			misses += cache_access(ST_TO_TEXTURE_BYTE_OFFSET(*texture, s, t));
+		}
+	return (GLfloat)misses / (WIDTH * HEIGHT);
+}
+
+int main(void) {
+	ZBuffer* zb = ZB_open(WIDTH, HEIGHT, TGL_FEATURE_RENDER_BITS == 16 ? ZB_MODE_5R6G5B : ZB_MODE_RGBA, 0);
+	GLuint tex;
+	GLint a, f, i;
+
+	glInit(zb);
+	glViewport(0, 0, WIDTH, HEIGHT);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glFrustum(-1, 1, -0.75, 0.75, 1, 10);
+	srand(1);
+	for (i = 0; i < TGL_FEATURE_TEXTURE_DIM * TGL_FEATURE_TEXTURE_DIM * 3; i++)
+		img[i] = (GLubyte)rand();
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, 3, TGL_FEATURE_TEXTURE_DIM, TGL_FEATURE_TEXTURE_DIM, 0, GL_RGB, GL_UNSIGNED_BYTE, img);
+	glEnable(GL_TEXTURE_2D);
+
+	printf("tiled textures %s, %dx%d texture\n", TGL_FEATURE_TILED_TEXTURES == 1 ? "on" : "off", TGL_FEATURE_TEXTURE_DIM,
+		   TGL_FEATURE_TEXTURE_DIM);
+	for (a = 0; a <= 90; a += 30) {
+		clock_t t0 = clock();
+		for (f = 0; f < NB_FRAMES; f++) {
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glMatrixMode(GL_MODELVIEW);
+			glLoadIdentity();
+			glTranslatef(0, 0, -2.2f);
+			glRotatef(a, 0, 0, 1);
+			glBegin(GL_QUADS);
+			/* 4 repeats, the texture is minified about 2x */
+			glTexCoord2f(0, 0);
+			glVertex3f(-1, -1, 0);
+			glTexCoord2f(4, 0);
+			glVertex3f(1, -1, 0);
+			glTexCoord2f(4, 4);
+			glVertex3f(1, 1, 0);
+			glTexCoord2f(0, 4);
+			glVertex3f(-1, 1, 0);
+			glEnd();
+			glFinish();
+		}
+		printf("%2d degrees: %.3f ms per frame\n", a, 1000.0 * (clock() - t0) / CLOCKS_PER_SEC / NB_FRAMES);
+	}
+
+	/* the quads above left the layout of the texture in zb->current_texture */
+	printf("L1 misses per pixel at 0.5, 1 and 2 texels per pixel:\n");
+	for (a = 0; a <= 90; a += 30)
+		printf("%2d degrees: %.3f %.3f %.3f\n", a, miss_rate(&zb->current_texture, a, 0.5f),
+			   miss_rate(&zb->current_texture, a, 1), miss_rate(&zb->current_texture, a, 2));
+
+	glClose();
+	ZB_close(zb);
+	return 0;
+}
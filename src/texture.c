@@ -2,18 +2,20 @@
  * Texture Manager
  */
 
+#include "msghandling.h"
 #include "zgl.h"
 
-static GLTexture* find_texture(GLint h) {
-	GLTexture* t;
-	GLContext* c = gl_get_context();
-	t = c->shared_state.texture_hash_table[h & TEXTURE_HASH_TABLE_MASK];
-	while (t != NULL) {
-		if (t->handle == h)
-			return t;
-		t = t->next;
-	}
-	return NULL;
+static GLTexture* find_texture(GLint h) { return gl_table_get(&gl_get_context()->shared_state->textures, h); }
+
+/* draws what every context sharing the textures of c has binned, before texels it may sample change or go away */
+static void gl_flush_texture_users(GLContext* c) {
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+	GLContext* u;
+	for (u = c->shared_state->contexts; u != NULL; u = u->next_shared)
+		ZB_flushTiles(u->zb);
+#else
+	ZB_flushTiles(c->zb);
+#endif
 }
 
 GLboolean glAreTexturesResident(GLsizei n, const GLuint* textures, GLboolean* residences) {
@@ -62,31 +64,27 @@ void* glGetTexturePixmap(GLint text, GLint level, GLint* xsize, GLint* ysize) {
 #endif
 		*xsize = tex->images[level].xsize;
 	*ysize = tex->images[level].ysize;
+	gl_flush_texture_users(c);
 	return tex->images[level].pixmap;
 }
 
 static void free_texture(GLContext* c, GLint h) {
-	GLTexture *t, **ht;
+	GLTexture* t;
 
+	/* binned triangles may still sample from it */
+	gl_flush_texture_users(c);
 	t = find_texture(h);
-	if (t->prev == NULL) {
-		ht = &c->shared_state.texture_hash_table[t->handle & TEXTURE_HASH_TABLE_MASK];
-		*ht = t->next;
-	} else {
-		t->prev->next = t->next;
-	}
-	if (t->next != NULL)
-		t->next->prev = t->prev;
-
-	gl_free(t);
+	gl_table_set(&c->shared_state->textures, h, NULL);
+	gl_free_texture_images(t);
+	gl_pool_free(&c->shared_state->texture_pool, t);
 }
 
 GLTexture* alloc_texture(GLint h) {
 	GLContext* c = gl_get_context();
-	GLTexture *t, **ht;
+	GLTexture* t;
 #define RETVAL NULL
 #include "error_check.h"
-	t = gl_zalloc(sizeof(GLTexture));
+	t = gl_pool_alloc(&c->shared_state->texture_pool, sizeof(GLTexture));
 	if (!t)
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define ERROR_FLAG GL_OUT_OF_MEMORY
@@ -96,13 +94,11 @@ GLTexture* alloc_texture(GLint h) {
 		gl_fatal_error("GL_OUT_OF_MEMORY");
 #endif
 
-		ht = &c->shared_state.texture_hash_table[h & TEXTURE_HASH_TABLE_MASK];
-
-	t->next = *ht;
-	t->prev = NULL;
-	if (t->next != NULL)
-		t->next->prev = t;
-	*ht = t;
+	if (gl_table_set(&c->shared_state->textures, h, t)) {
+		/* past MAX_TEXTURES, or the table couldn't grow */
+		gl_pool_free(&c->shared_state->texture_pool, t);
+		return NULL;
+	}
 
 	t->handle = h;
 
@@ -118,20 +114,12 @@ void glInitTextures() {
 
 void glGenTextures(GLint n, GLuint* textures) {
 	GLContext* c = gl_get_context();
-	GLint max, i;
-	GLTexture* t;
+	GLint first, i;
 #include "error_check.h"
-	max = 0;
-	for (i = 0; i < TEXTURE_HASH_TABLE_SIZE; i++) {
-		t = c->shared_state.texture_hash_table[i];
-		while (t != NULL) {
-			if (t->handle > max)
-				max = t->handle;
-			t = t->next;
-		}
-	}
+	/* the lowest unused handles, 0 is always the default texture */
+	first = gl_table_find_free(&c->shared_state->textures, n);
 	for (i = 0; i < n; i++) {
-		textures[i] = max + i + 1; /* MARK: How texture handles are created.*/
+		textures[i] = first < 0 ? 0 : first + i; /* MARK: How texture handles are created.*/
 	}
 }
 
@@ -164,7 +152,16 @@ void glopBindTexture(GLParam* p) {
 #else
 	
 #endif
-		t = find_texture(texture);
+	if (texture < 0 || texture >= MAX_TEXTURES) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_INVALID_VALUE
+#include "error_check.h"
+#else
+		tgl_warning("\nglBindTexture: handle past MAX_TEXTURES\n");
+		return;
+#endif
+	}
+	t = find_texture(texture);
 	if (t == NULL) {
 		t = alloc_texture(texture);
 #include "error_check.h"
@@ -181,6 +178,115 @@ void glopBindTexture(GLParam* p) {
 }
 
 
+/* a power of two, so that the rasterizers can wrap with a mask */
+static GLint gl_texture_size(GLint size, GLint* size_log2) {
+	GLint n = 0;
+	while ((1 << n) < size && n < TGL_FEATURE_TEXTURE_POW2)
+		n++;
+	*size_log2 = n;
+	return 1 << n;
+}
+
+/* bytes of the texels of an image */
+static GLint gl_image_bytes(GLint format, GLint xsize_log2, GLint ysize_log2) {
+	GLint n = 1 << (xsize_log2 + ysize_log2);
+	switch (format) {
+	case ZB_TEXTURE_565:
+		return n * 2;
+	case ZB_TEXTURE_INDEX8:
+		return n;
+	case ZB_TEXTURE_DXT1:
+		/* 8 bytes per 4x4 block, a smaller image takes a whole block */
+		return 8 << ((xsize_log2 > 2 ? xsize_log2 - 2 : 0) + (ysize_log2 > 2 ? ysize_log2 - 2 : 0));
+	}
+	return n * sizeof(PIXEL);
+}
+
+/* the texels of an image of that format and size, the old ones are kept if they are enough */
+static void* gl_image_alloc(GLImage* im, GLint format, GLint xsize_log2, GLint ysize_log2) {
+	GLint n = gl_image_bytes(format, xsize_log2, ysize_log2);
+	if (!im->pixmap || gl_image_bytes(im->format, im->xsize_log2, im->ysize_log2) != n) {
+		PIXEL* pixmap = gl_malloc(n);
+		if (!pixmap)
+			return NULL;
+		gl_free(im->pixmap);
+		im->pixmap = pixmap;
+	}
+	im->xsize = im->width = 1 << xsize_log2;
+	im->ysize = im->height = 1 << ysize_log2;
+	im->xsize_log2 = xsize_log2;
+	im->ysize_log2 = ysize_log2;
+	im->format = format;
+	return im->pixmap;
+}
+
+#if TGL_FEATURE_MIPMAPPING == 1
+/*
+ the levels below level 0 of the current texture where the texels x0 <= x < x1, y0 <= y < y1 of level 0 changed,
+ a level that can't be allocated ends the chain
+ */
+static void gl_build_mipmaps(GLContext* c, GLint x0, GLint y0, GLint x1, GLint y1) {
+	GLImage* im = c->current_texture->images;
+	GLint level;
+	for (level = 1; level < MAX_TEXTURE_LEVELS; level++) {
+		GLImage* up = &im[level - 1];
+		GLint missing = !im[level].pixmap;
+		if (!up->pixmap || up->format != ZB_TEXTURE_PIXEL || (up->xsize_log2 == 0 && up->ysize_log2 == 0) ||
+			!gl_image_alloc(&im[level], ZB_TEXTURE_PIXEL, up->xsize_log2 ? up->xsize_log2 - 1 : 0, up->ysize_log2 ? up->ysize_log2 - 1 : 0))
+			break;
+		x0 >>= 1;
+		y0 >>= 1;
+		x1 = (x1 + 1) >> 1;
+		y1 = (y1 + 1) >> 1;
+		if (missing) {
+			x0 = y0 = 0;
+			x1 = im[level].xsize;
+			y1 = im[level].ysize;
+		}
+		gl_halveImage(im[level].pixmap, up->pixmap, up->xsize, up->ysize, x0, y0, x1, y1);
+	}
+	for (; level < MAX_TEXTURE_LEVELS; level++) {
+		gl_free(im[level].pixmap);
+		im[level].pixmap = NULL;
+	}
+}
+#endif
+
+#if TGL_FEATURE_TILED_TEXTURES == 1
+/* the images of the current texture are written row by row, the rasterizers read them in tiles (or back with untile) */
+static void gl_tile_texture_images(GLContext* c, GLint untile) {
+	GLImage* im = c->current_texture->images;
+	GLint level;
+	PIXEL* rows = gl_malloc(sizeof(PIXEL) * im[0].xsize * im[0].ysize);
+	if (!rows) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_OUT_OF_MEMORY
+#include "error_check.h"
+#else
+		gl_fatal_error("GL_OUT_OF_MEMORY");
+#endif
+	}
+	for (level = 0; level < MAX_TEXTURE_LEVELS && im[level].pixmap && im[level].format == ZB_TEXTURE_PIXEL; level++) {
+		memcpy(rows, im[level].pixmap, sizeof(PIXEL) * im[level].xsize * im[level].ysize);
+		gl_tileImage(im[level].pixmap, rows, im[level].xsize_log2, im[level].ysize_log2, untile);
+	}
+	gl_free(rows);
+}
+#endif
+
+/* and its palette */
+void gl_free_texture_images(GLTexture* t) {
+	GLint i;
+	for (i = 0; i < MAX_TEXTURE_LEVELS; i++) {
+		gl_free(t->images[i].pixmap);
+		t->images[i].pixmap = NULL;
+	}
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+	gl_free(t->palette);
+	t->palette = NULL;
+#endif
+}
+
 void glCopyTexImage2D(GLenum target,		 
 					  GLint level,			 
 					  GLenum internalformat, 
@@ -203,7 +309,6 @@ void glCopyTexImage2D(GLenum target,
 	gl_add_op(p);
 }
 void glopCopyTexImage2D(GLParam* p) {
-	GLImage* im;
 	PIXEL* data;
 	GLint i, j;
 	GLint target = p[1].i;
@@ -216,9 +321,9 @@ void glopCopyTexImage2D(GLParam* p) {
 	GLContext* c = gl_get_context();
 	y -= h;
 
-	if (c->readbuffer != GL_FRONT || c->current_texture == NULL || target != GL_TEXTURE_2D || border != 0 ||
-		w != TGL_FEATURE_TEXTURE_DIM || /*TODO Implement image interp*/
-		h != TGL_FEATURE_TEXTURE_DIM) {
+	if (c->readbuffer != GL_FRONT || c->current_texture == NULL || target != GL_TEXTURE_2D || level != 0 || border != 0 ||
+		w <= 0 || w > TGL_FEATURE_TEXTURE_DIM || (w & (w - 1)) || /*TODO Implement image interp*/
+		h <= 0 || h > TGL_FEATURE_TEXTURE_DIM || (h & (h - 1))) {
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define ERROR_FLAG GL_INVALID_OPERATION
 #include "error_check.h"
@@ -226,10 +331,29 @@ void glopCopyTexImage2D(GLParam* p) {
 		return;
 #endif
 	}
-	im = &c->current_texture->images[level];
-	data = c->current_texture->images[level].pixmap;
-	im->xsize = TGL_FEATURE_TEXTURE_DIM;
-	im->ysize = TGL_FEATURE_TEXTURE_DIM;
+	gl_flush_texture_users(c);
+	ZB_resolveClear(c->zb, 0, 0, c->zb->xsize - 1, c->zb->ysize - 1);
+	{
+		GLint xsize_log2, ysize_log2;
+		gl_texture_size(w, &xsize_log2);
+		gl_texture_size(h, &ysize_log2);
+		data = gl_image_alloc(&c->current_texture->images[level], ZB_TEXTURE_PIXEL, xsize_log2, ysize_log2);
+	}
+	if (!data) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_OUT_OF_MEMORY
+#include "error_check.h"
+#else
+		gl_fatal_error("GL_OUT_OF_MEMORY");
+#endif
+	}
+	/* the source wraps around the framebuffer, keep the % below positive */
+	x %= c->zb->xsize;
+	if (x < 0)
+		x += c->zb->xsize;
+	y %= c->zb->ysize;
+	if (y < 0)
+		y += c->zb->ysize;
 	/* TODO implement the scaling and stuff that the GL spec says it should have.*/
 #if TGL_FEATURE_MULTITHREADED_COPY_TEXIMAGE_2D == 1
 #ifdef _OPENMP
@@ -245,6 +369,347 @@ void glopCopyTexImage2D(GLParam* p) {
 			data[i + j * w] = c->zb->pbuf[((i + x) % (c->zb->xsize)) + ((j + y) % (c->zb->ysize)) * (c->zb->xsize)];
 		}
 #endif
+#if TGL_FEATURE_MIPMAPPING == 1
+	gl_build_mipmaps(c, 0, 0, w, h);
+#endif
+#if TGL_FEATURE_TILED_TEXTURES == 1
+	gl_tile_texture_images(c, 0);
+#endif
+}
+
+void glColorTableEXT(GLenum target, GLenum internalformat, GLsizei width, GLenum format, GLenum type, const void* table) {
+	GLParam p[7];
+#include "error_check_no_context.h"
+
+	p[0].op = OP_ColorTable;
+	p[1].i = target;
+	p[2].i = internalformat;
+	p[3].i = width;
+	p[4].i = format;
+	p[5].i = type;
+	p[6].p = (void*)table;
+	gl_add_op(p);
+}
+
+void glopColorTable(GLParam* p) {
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+	GLint target = p[1].i;
+	GLint internalformat = p[2].i;
+	GLint width = p[3].i;
+	GLint format = p[4].i;
+	GLint type = p[5].i;
+	GLubyte* table = p[6].p;
+	GLContext* c = gl_get_context();
+	GLTexture* t = c->current_texture;
+
+	if (t == NULL || target != GL_TEXTURE_2D || (internalformat != GL_RGB && internalformat != GL_RGB8) || width < 1 || width > 256 ||
+		format != GL_RGB || type != GL_UNSIGNED_BYTE) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_INVALID_ENUM
+#include "error_check.h"
+#else
+		tgl_warning("glColorTableEXT: combination of parameters not handled\n");
+		return;
+#endif
+	}
+	/* binned triangles may still sample from the old one */
+	gl_flush_texture_users(c);
+	if (!t->palette)
+		t->palette = gl_zalloc(256 * sizeof(PIXEL));
+	if (!t->palette) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_OUT_OF_MEMORY
+#include "error_check.h"
+#else
+		gl_fatal_error("GL_OUT_OF_MEMORY");
+#endif
+	}
+#if TGL_FEATURE_RENDER_BITS == 32
+	gl_convertRGB_to_8A8R8G8B(t->palette, table, width, 1);
+#elif TGL_FEATURE_RENDER_BITS == 16
+	gl_convertRGB_to_5R6G5B(t->palette, table, width, 1);
+#endif
+#else
+#if TGL_FEATURE_ERROR_CHECK == 1
+	GLContext* c = gl_get_context();
+#define ERROR_FLAG GL_INVALID_OPERATION
+#include "error_check.h"
+#else
+	tgl_warning("glColorTableEXT: needs TGL_FEATURE_TEXTURE_FORMATS\n");
+#endif
+#endif
+}
+
+void glCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize,
+							const void* data) {
+	GLParam p[9];
+#include "error_check_no_context.h"
+
+	p[0].op = OP_CompressedTexImage2D;
+	p[1].i = target;
+	p[2].i = level;
+	p[3].i = internalformat;
+	p[4].i = width;
+	p[5].i = height;
+	p[6].i = border;
+	p[7].i = imageSize;
+	p[8].p = (void*)data;
+	gl_add_op(p);
+}
+
+void glopCompressedTexImage2D(GLParam* p) {
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+	GLint target = p[1].i;
+	GLint level = p[2].i;
+	GLint internalformat = p[3].i;
+	GLint width = p[4].i;
+	GLint height = p[5].i;
+	GLint border = p[6].i;
+	GLint size = p[7].i;
+	GLContext* c = gl_get_context();
+	GLint xsize_log2, ysize_log2;
+	void* pixmap;
+
+	/* the blocks are copied as they are, so the size can't be rounded */
+	if (c->current_texture == NULL || target != GL_TEXTURE_2D || level != 0 || internalformat != GL_COMPRESSED_RGB_S3TC_DXT1_EXT ||
+		border != 0 || gl_texture_size(width, &xsize_log2) != width || gl_texture_size(height, &ysize_log2) != height ||
+		size != gl_image_bytes(ZB_TEXTURE_DXT1, xsize_log2, ysize_log2)) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_INVALID_VALUE
+#include "error_check.h"
+#else
+		tgl_warning("glCompressedTexImage2D: combination of parameters not handled\n");
+		return;
+#endif
+	}
+	gl_flush_texture_users(c);
+	pixmap = gl_image_alloc(&c->current_texture->images[0], ZB_TEXTURE_DXT1, xsize_log2, ysize_log2);
+	if (!pixmap) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_OUT_OF_MEMORY
+#include "error_check.h"
+#else
+		gl_fatal_error("GL_OUT_OF_MEMORY");
+#endif
+	}
+	memcpy(pixmap, p[8].p, size);
+#if TGL_FEATURE_MIPMAPPING == 1
+	/* drops the levels of a previous image */
+	gl_build_mipmaps(c, 0, 0, width, height);
+#endif
+#else
+#if TGL_FEATURE_ERROR_CHECK == 1
+	GLContext* c = gl_get_context();
+#define ERROR_FLAG GL_INVALID_OPERATION
+#include "error_check.h"
+#else
+	tgl_warning("glCompressedTexImage2D: needs TGL_FEATURE_TEXTURE_FORMATS\n");
+#endif
+#endif
+}
+
+/* the layouts of the texels handed to glTexImage2D and glTexSubImage2D */
+#define IMAGE_RGB 0	  /* GL_RGB, GL_UNSIGNED_BYTE */
+#define IMAGE_RGBA 1  /* GL_RGBA, GL_UNSIGNED_BYTE, the alpha is dropped */
+#define IMAGE_BGRA 2  /* GL_BGRA, GL_UNSIGNED_BYTE */
+#define IMAGE_565 3	  /* GL_RGB, GL_UNSIGNED_SHORT_5_6_5 */
+#define IMAGE_ARGB 4  /* GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV */
+#define IMAGE_INDEX 5 /* GL_COLOR_INDEX, GL_UNSIGNED_BYTE */
+
+static const GLint image_bytes_per_texel[] = {3, 4, 4, 2, 4, 1};
+
+/* the IMAGE_* layout of that format and type, -1 if not handled */
+static GLint gl_image_layout(GLint format, GLint type) {
+	if (format == GL_RGB && type == GL_UNSIGNED_BYTE)
+		return IMAGE_RGB;
+	if (format == GL_RGB && type == GL_UNSIGNED_SHORT_5_6_5)
+		return IMAGE_565;
+	if (format == GL_RGBA && type == GL_UNSIGNED_BYTE)
+		return IMAGE_RGBA;
+	if (format == GL_BGRA && type == GL_UNSIGNED_BYTE)
+		return IMAGE_BGRA;
+	if (format == GL_BGRA && type == GL_UNSIGNED_INT_8_8_8_8_REV)
+		return IMAGE_ARGB;
+	if (format == GL_COLOR_INDEX && type == GL_UNSIGNED_BYTE)
+		return IMAGE_INDEX;
+	return -1;
+}
+
+/*
+ the layout whose rows are the texels of that ZB_TEXTURE_* format as they are, -1 if none. Not IMAGE_ARGB for 32 bit
+ texels, its alpha byte has to be cleared: texels are 0x00RRGGBB, and are written to the frame buffer as they are.
+ */
+static GLint gl_texel_layout(GLint format) {
+	switch (format) {
+	case ZB_TEXTURE_PIXEL:
+#if TGL_FEATURE_RENDER_BITS == 32
+		return -1;
+#else
+		return IMAGE_565;
+#endif
+	case ZB_TEXTURE_565:
+		return IMAGE_565;
+	case ZB_TEXTURE_INDEX8:
+		return IMAGE_INDEX;
+	}
+	return -1;
+}
+
+/* a row of n texels of that layout as 0xRRGGBB (or indices) */
+static void gl_read_row(GLuint* row, const GLubyte* src, GLint layout, GLint n) {
+	GLint i;
+	GLushort v16;
+	switch (layout) {
+	case IMAGE_RGB:
+		for (i = 0; i < n; i++, src += 3)
+			row[i] = ((GLuint)src[0] << 16) | ((GLuint)src[1] << 8) | src[2];
+		break;
+	case IMAGE_RGBA:
+		for (i = 0; i < n; i++, src += 4)
+			row[i] = ((GLuint)src[0] << 16) | ((GLuint)src[1] << 8) | src[2];
+		break;
+	case IMAGE_BGRA:
+		for (i = 0; i < n; i++, src += 4)
+			row[i] = ((GLuint)src[2] << 16) | ((GLuint)src[1] << 8) | src[0];
+		break;
+	case IMAGE_565:
+		for (i = 0; i < n; i++, src += 2) {
+			memcpy(&v16, src, 2);
+			row[i] = ((v16 & 0xF800) << 8) | ((v16 & 0xE000) << 3) | ((v16 & 0x07E0) << 5) | ((v16 & 0x0600) >> 1) |
+					 ((v16 & 0x001F) << 3) | ((v16 & 0x001C) >> 2);
+		}
+		break;
+	case IMAGE_ARGB:
+		memcpy(row, src, n * 4);
+		for (i = 0; i < n; i++)
+			row[i] &= 0x00FFFFFF;
+		break;
+	default:
+		for (i = 0; i < n; i++)
+			row[i] = src[i];
+	}
+}
+
+/* n 16 bit texels (or indices for ZB_TEXTURE_INDEX8) from a row of gl_read_row */
+static void gl_write_row(void* dest, const GLuint* row, GLint format, GLint n) {
+	GLint i;
+	if (format == ZB_TEXTURE_INDEX8) {
+		for (i = 0; i < n; i++)
+			((GLubyte*)dest)[i] = row[i];
+	} else {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+		for (i = 0; i < n; i++)
+			((GLushort*)dest)[i] = ((row[i] >> 8) & 0xF800) | ((row[i] >> 5) & 0x07E0) | ((row[i] >> 3) & 0x001F);
+	}
+}
+
+/*
+ writes the texels x0 <= x < x0 + w, y0 <= y < y0 + h of an untiled image from a source image of sw x sh texels of
+ that layout, scaled without interpolation. The rows that are already in the format of the image are copied as
+ they are. Returns 0 if out of memory.
+ */
+static GLint gl_convert_image(GLImage* im, GLint x0, GLint y0, GLint w, GLint h, const GLubyte* pixels, GLint layout, GLint sw,
+							  GLint sh) {
+	GLint xinc = (GLint)((GLfloat)(sw << 16) / (GLfloat)w);
+	GLint yinc = (GLint)((GLfloat)(sh << 16) / (GLfloat)h);
+	GLint bpp = image_bytes_per_texel[layout];
+	GLint copy = xinc == 1 << 16 && layout == gl_texel_layout(im->format);
+	/* 32 bit texels are what gl_read_row makes */
+	GLint direct = TGL_FEATURE_RENDER_BITS == 32 && im->format == ZB_TEXTURE_PIXEL;
+	GLint tbpp = im->format == ZB_TEXTURE_INDEX8 ? 1 : im->format == ZB_TEXTURE_565 ? 2 : sizeof(PIXEL);
+	GLubyte* rgb = NULL;
+	/* the converted row, then the picked source texels of a resized one */
+	GLuint* row = NULL;
+	GLubyte* picked = NULL;
+	GLint x, y, y1 = 0;
+
+	if (!copy) {
+		row = gl_malloc(w * sizeof(GLuint) * 2);
+		if (!row)
+			return 0;
+		picked = (GLubyte*)(row + w);
+	}
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+	/* the blocks are encoded from the whole image */
+	if (im->format == ZB_TEXTURE_DXT1) {
+		rgb = gl_malloc(w * h * 3);
+		if (!rgb) {
+			gl_free(row);
+			return 0;
+		}
+	}
+#endif
+	for (y = 0; y < h; y++, y1 += yinc) {
+		const GLubyte* src = pixels + (y1 >> 16) * sw * bpp;
+		void* dest = rgb ? NULL : (GLubyte*)im->pixmap + ((y0 + y) * im->xsize + x0) * tbpp;
+		if (copy) {
+			memcpy(dest, src, w * bpp);
+			continue;
+		}
+		/* no interpolation, to respect the original image aliasing */
+		if (xinc != 1 << 16) {
+			GLint x1 = 0;
+			for (x = 0; x < w; x++, x1 += xinc)
+				memcpy(picked + x * bpp, src + (x1 >> 16) * bpp, bpp);
+			src = picked;
+		}
+		if (direct) {
+			gl_read_row(dest, src, layout, w);
+			continue;
+		}
+		gl_read_row(row, src, layout, w);
+		if (rgb) {
+			GLubyte* p = rgb + y * w * 3;
+			for (x = 0; x < w; x++, p += 3) {
+				p[0] = row[x] >> 16;
+				p[1] = row[x] >> 8;
+				p[2] = row[x];
+			}
+		} else {
+			gl_write_row(dest, row, im->format, w);
+		}
+	}
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+	if (rgb)
+		gl_convertRGB_to_DXT1((GLubyte*)im->pixmap, rgb, w, h);
+#endif
+	gl_free(rgb);
+	gl_free(row);
+	return 1;
+}
+
+/*
+ stores an image of that layout (of indices for ZB_TEXTURE_INDEX8, then already a power of two) in the current
+ texture, at its own size rounded up to a power of two, with texels of that format
+ */
+static void gl_tex_image(GLContext* c, GLint level, GLint format, GLint width, GLint height, GLubyte* pixels, GLint layout) {
+	GLint xsize_log2, ysize_log2;
+	GLint xsize = gl_texture_size(width, &xsize_log2);
+	GLint ysize = gl_texture_size(height, &ysize_log2);
+	GLImage* im = &c->current_texture->images[level];
+	GLint ok;
+
+	gl_flush_texture_users(c);
+	ok = gl_image_alloc(im, format, xsize_log2, ysize_log2) && gl_convert_image(im, 0, 0, xsize, ysize, pixels, layout, width, height);
+	if (ok) {
+		im->width = width;
+		im->height = height;
+#if TGL_FEATURE_MIPMAPPING == 1
+		gl_build_mipmaps(c, 0, 0, xsize, ysize);
+#endif
+#if TGL_FEATURE_TILED_TEXTURES == 1
+		gl_tile_texture_images(c, 0);
+#endif
+	} else {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_OUT_OF_MEMORY
+#include "error_check.h"
+#else
+		gl_fatal_error("GL_OUT_OF_MEMORY");
+#endif
+	}
 }
 
 void glopTexImage1D(GLParam* p) {
@@ -258,9 +723,6 @@ void glopTexImage1D(GLParam* p) {
 	GLint format = p[6].i;
 	GLint type = p[7].i;
 	void* pixels = p[8].p;
-	GLImage* im;
-	GLubyte* pixels1;
-	GLint do_free=0;
 	GLContext* c = gl_get_context();
 	{
 #if TGL_FEATURE_ERROR_CHECK == 1
@@ -275,39 +737,34 @@ void glopTexImage1D(GLParam* p) {
 			gl_fatal_error("glTexImage2D: combination of parameters not handled!!");
 #endif
 	}
-	if (width != TGL_FEATURE_TEXTURE_DIM || height != TGL_FEATURE_TEXTURE_DIM) {
-		pixels1 = gl_malloc(TGL_FEATURE_TEXTURE_DIM * TGL_FEATURE_TEXTURE_DIM * 3); /* GUARDED*/
-		if (pixels1 == NULL) {
-#if TGL_FEATURE_ERROR_CHECK == 1
-#define ERROR_FLAG GL_OUT_OF_MEMORY
-#include "error_check.h"
+	gl_tex_image(c, level, ZB_TEXTURE_PIXEL, width, height, pixels, IMAGE_RGB);
+}
+/* the ZB_TEXTURE_* format of the texels of that internal format, -1 if not handled */
+static GLint gl_texture_format(GLint components) {
+	switch (components) {
+	case 3:
+	case 4:
+	case GL_RGB:
+	case GL_RGB8:
+	case GL_RGBA:
+	case GL_RGBA8:
+		return ZB_TEXTURE_PIXEL;
+	case GL_RGB5:
+#if TGL_FEATURE_TEXTURE_FORMATS == 1 && TGL_FEATURE_RENDER_BITS == 32
+		return ZB_TEXTURE_565;
 #else
-			gl_fatal_error("GL_OUT_OF_MEMORY");
+		return ZB_TEXTURE_PIXEL;
 #endif
-		}
-		/* no GLinterpolation is done here to respect the original image aliasing ! */
-		
-		gl_resizeImageNoInterpolate(pixels1, TGL_FEATURE_TEXTURE_DIM, TGL_FEATURE_TEXTURE_DIM, pixels, width, height);
-		do_free = 1;
-		width = TGL_FEATURE_TEXTURE_DIM;
-		height = TGL_FEATURE_TEXTURE_DIM; 
-	} else {
-		pixels1 = pixels;
-	}
-
-	im = &c->current_texture->images[level];
-	im->xsize = width;
-	im->ysize = height;
-#if TGL_FEATURE_RENDER_BITS == 32
-	gl_convertRGB_to_8A8R8G8B(im->pixmap, pixels1, width, height);
-#elif TGL_FEATURE_RENDER_BITS == 16
-	gl_convertRGB_to_5R6G5B(im->pixmap, pixels1, width, height);
-#else
-#error bad TGL_FEATURE_RENDER_BITS
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		return ZB_TEXTURE_DXT1;
+	case GL_COLOR_INDEX8_EXT:
+		return ZB_TEXTURE_INDEX8;
 #endif
-	if (do_free)
-		gl_free(pixels1);
+	}
+	return -1;
 }
+
 void glopTexImage2D(GLParam* p) {
 	GLint target = p[1].i;
 	GLint level = p[2].i;
@@ -318,55 +775,96 @@ void glopTexImage2D(GLParam* p) {
 	GLint format = p[7].i;
 	GLint type = p[8].i;
 	void* pixels = p[9].p;
-	GLImage* im;
-	GLubyte* pixels1;
-	GLint do_free=0;
 	GLContext* c = gl_get_context();
+	GLint internal = gl_texture_format(components);
+	GLint layout = gl_image_layout(format, type);
+	/* indices are only stored as indices, and aren't resized */
+	GLint sized = (internal == ZB_TEXTURE_INDEX8) == (layout == IMAGE_INDEX) &&
+				  (internal != ZB_TEXTURE_INDEX8 || (width <= TGL_FEATURE_TEXTURE_DIM && height <= TGL_FEATURE_TEXTURE_DIM &&
+													!(width & (width - 1)) && !(height & (height - 1))));
 	{
 #if TGL_FEATURE_ERROR_CHECK == 1
-		if (!(c->current_texture != NULL && target == GL_TEXTURE_2D && level == 0 && components == 3 && border == 0 && format == GL_RGB &&
-			  type == GL_UNSIGNED_BYTE))
+		if (!(c->current_texture != NULL && target == GL_TEXTURE_2D && level == 0 && internal >= 0 && layout >= 0 && sized &&
+			  border == 0))
 #define ERROR_FLAG GL_INVALID_ENUM
 #include "error_check.h"
 
 #else
-		if (!(c->current_texture != NULL && target == GL_TEXTURE_2D && level == 0 && components == 3 && border == 0 && format == GL_RGB &&
-			  type == GL_UNSIGNED_BYTE))
+		if (!(c->current_texture != NULL && target == GL_TEXTURE_2D && level == 0 && internal >= 0 && layout >= 0 && sized &&
+			  border == 0))
 			gl_fatal_error("glTexImage2D: combination of parameters not handled!!");
 #endif
 	}
-	if (width != TGL_FEATURE_TEXTURE_DIM || height != TGL_FEATURE_TEXTURE_DIM) {
-		pixels1 = gl_malloc(TGL_FEATURE_TEXTURE_DIM * TGL_FEATURE_TEXTURE_DIM * 3); /* GUARDED*/
-		if (pixels1 == NULL) {
+	gl_tex_image(c, level, internal, width, height, pixels, layout);
+}
+
+void glopTexSubImage2D(GLParam* p) {
+	GLint target = p[1].i;
+	GLint level = p[2].i;
+	GLint xoffset = p[3].i;
+	GLint yoffset = p[4].i;
+	GLint width = p[5].i;
+	GLint height = p[6].i;
+	GLint layout = gl_image_layout(p[7].i, p[8].i);
+	void* pixels = p[9].p;
+	GLContext* c = gl_get_context();
+	GLImage* im;
+	GLint ok;
+
+	if (c->current_texture == NULL || target != GL_TEXTURE_2D || layout < 0) {
 #if TGL_FEATURE_ERROR_CHECK == 1
-#define ERROR_FLAG GL_OUT_OF_MEMORY
+#define ERROR_FLAG GL_INVALID_ENUM
 #include "error_check.h"
 #else
-			gl_fatal_error("GL_OUT_OF_MEMORY");
+		tgl_warning("glTexSubImage2D: combination of parameters not handled\n");
+		return;
 #endif
-		}
-		/* no GLinterpolation is done here to respect the original image aliasing ! */
-		
-		gl_resizeImageNoInterpolate(pixels1, TGL_FEATURE_TEXTURE_DIM, TGL_FEATURE_TEXTURE_DIM, pixels, width, height);
-		do_free = 1;
-		width = TGL_FEATURE_TEXTURE_DIM;
-		height = TGL_FEATURE_TEXTURE_DIM;
-	} else {
-		pixels1 = pixels;
 	}
-
-	im = &c->current_texture->images[level];
-	im->xsize = width;
-	im->ysize = height;
-#if TGL_FEATURE_RENDER_BITS == 32
-	gl_convertRGB_to_8A8R8G8B(im->pixmap, pixels1, width, height);
-#elif TGL_FEATURE_RENDER_BITS == 16
-	gl_convertRGB_to_5R6G5B(im->pixmap, pixels1, width, height);
+	/* the other levels follow level 0 */
+	im = &c->current_texture->images[0];
+	/* the offsets of a resized image would have to be scaled, and its texels resampled */
+	if (im->pixmap && (im->width != im->xsize || im->height != im->ysize)) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_INVALID_OPERATION
+#include "error_check.h"
 #else
-#error Bad TGL_FEATURE_RENDER_BITS
+		tgl_warning("glTexSubImage2D: the image was resized to a power of two\n");
+		return;
 #endif
-	if (do_free)
-		gl_free(pixels1);
+	}
+	if (level != 0 || !im->pixmap || im->format == ZB_TEXTURE_DXT1 || (im->format == ZB_TEXTURE_INDEX8) != (layout == IMAGE_INDEX) ||
+		xoffset < 0 || yoffset < 0 || width < 0 || height < 0 || xoffset + width > im->xsize || yoffset + height > im->ysize) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_INVALID_VALUE
+#include "error_check.h"
+#else
+		tgl_warning("glTexSubImage2D: no such texels\n");
+		return;
+#endif
+	}
+	if (width == 0 || height == 0)
+		return;
+	/* binned triangles may still sample from the old texels */
+	gl_flush_texture_users(c);
+#if TGL_FEATURE_TILED_TEXTURES == 1
+	gl_tile_texture_images(c, 1);
+#endif
+	ok = gl_convert_image(im, xoffset, yoffset, width, height, pixels, layout, width, height);
+#if TGL_FEATURE_MIPMAPPING == 1
+	if (ok)
+		gl_build_mipmaps(c, xoffset, yoffset, xoffset + width, yoffset + height);
+#endif
+#if TGL_FEATURE_TILED_TEXTURES == 1
+	gl_tile_texture_images(c, 0);
+#endif
+	if (!ok) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_OUT_OF_MEMORY
+#include "error_check.h"
+#else
+		gl_fatal_error("GL_OUT_OF_MEMORY");
+#endif
+	}
 }
 
 /* TODO: not all tests are done */
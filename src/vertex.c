@@ -48,7 +48,9 @@ void glopColor(GLParam* p) {
 
 void glopBegin(GLParam* p) {
 	GLint type;
+#if TGL_FEATURE_AFFINE_MATRICES == 0
 	M4 tmp;
+#endif
 	GLContext* c = gl_get_context();
 #if TGL_FEATURE_ERROR_CHECK == 1
 	if (c->in_begin != 0)
@@ -62,7 +64,27 @@ void glopBegin(GLParam* p) {
 	c->in_begin = 1;
 	c->vertex_n = 0;
 	c->vertex_cnt = 0;
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 1
+	/* glBegin while compiling a list is only executed with GL_COMPILE_AND_EXECUTE, the ops must still be stored */
+	c->vertex_batching = !c->compile_flag;
+	c->batch_count = 0;
+	c->batch_states = 0;
+	memcpy(c->batch_attribs, c->current_color.v, 4 * sizeof(GLfloat));
+	memcpy(c->batch_attribs + 4, c->current_normal.v, 3 * sizeof(GLfloat));
+	memcpy(c->batch_attribs + 7, c->current_tex_coord.v, 4 * sizeof(GLfloat));
+#endif
 
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	/* only what this primitive uses, the rest stays dirty until it is needed */
+	if (c->lighting_enabled)
+		gl_compute_normal_matrix();
+	else
+		gl_compute_model_projection();
+	if (c->matrix_model_projection_updated & TGL_MATRIX_DIRTY_TEXTURE) {
+		c->apply_texture_matrix = !gl_M4_IsId(c->matrix_stack_ptr[2]);
+		c->matrix_model_projection_updated &= ~TGL_MATRIX_DIRTY_TEXTURE;
+	}
+#else
 	if (c->matrix_model_projection_updated) {
 
 		if (c->lighting_enabled) {
@@ -89,6 +111,24 @@ void glopBegin(GLParam* p) {
 
 		c->matrix_model_projection_updated = 0;
 	}
+#endif
+#if TGL_FEATURE_FIXED_POINT == 1
+	{
+		/* the float matrices this primitive uses are up to date, convert them */
+		GLint need = c->lighting_enabled ? TGL_MATRIX_FIXED_LIT : TGL_MATRIX_FIXED_UNLIT;
+		if (c->matrix_fixed_dirty & need) {
+			if (c->lighting_enabled) {
+				gl_M4x_From(&c->matrix_model_view_x, c->matrix_stack_ptr[0]);
+				gl_M4x_From(&c->matrix_projection_x, c->matrix_stack_ptr[1]);
+				gl_M4x_From(&c->matrix_normal_x, &c->matrix_model_view_inv);
+			} else {
+				gl_M4x_From(&c->matrix_model_projection_x, &c->matrix_model_projection);
+			}
+			gl_M4x_From(&c->matrix_texture_x, c->matrix_stack_ptr[2]);
+			c->matrix_fixed_dirty &= ~need;
+		}
+	}
+#endif
 	/*  viewport- this is now updated on a glViewport call. 
 	if (c->viewport.updated) {
 		gl_eval_viewport(c);
@@ -151,7 +191,8 @@ static void gl_transform_to_viewport_vertex_c(GLVertex* v) {
 	}
 }
 
-static void gl_vertex_transform(GLVertex* v) {
+#if TGL_FEATURE_FIXED_POINT == 0
+static void gl_vertex_transform(GLVertex* v, GLVertexEye* e) {
 	GLfloat* m;
 	GLContext* c = gl_get_context();
 
@@ -161,27 +202,27 @@ static void gl_vertex_transform(GLVertex* v) {
 		/* eye coordinates needed for lighting */
 		V4* n;
 		m = &c->matrix_stack_ptr[0]->m[0][0];
-		v->ec.X = (v->coord.X * m[0] + v->coord.Y * m[1] + v->coord.Z * m[2] + m[3]);
-		v->ec.Y = (v->coord.X * m[4] + v->coord.Y * m[5] + v->coord.Z * m[6] + m[7]);
-		v->ec.Z = (v->coord.X * m[8] + v->coord.Y * m[9] + v->coord.Z * m[10] + m[11]);
-		v->ec.W = (v->coord.X * m[12] + v->coord.Y * m[13] + v->coord.Z * m[14] + m[15]);
+		e->ec.X = (e->coord.X * m[0] + e->coord.Y * m[1] + e->coord.Z * m[2] + m[3]);
+		e->ec.Y = (e->coord.X * m[4] + e->coord.Y * m[5] + e->coord.Z * m[6] + m[7]);
+		e->ec.Z = (e->coord.X * m[8] + e->coord.Y * m[9] + e->coord.Z * m[10] + m[11]);
+		e->ec.W = (e->coord.X * m[12] + e->coord.Y * m[13] + e->coord.Z * m[14] + m[15]);
 
 		/* projection coordinates */
 		m = &c->matrix_stack_ptr[1]->m[0][0];
-		v->pc.X = (v->ec.X * m[0] + v->ec.Y * m[1] + v->ec.Z * m[2] + v->ec.W * m[3]);
-		v->pc.Y = (v->ec.X * m[4] + v->ec.Y * m[5] + v->ec.Z * m[6] + v->ec.W * m[7]);
-		v->pc.Z = (v->ec.X * m[8] + v->ec.Y * m[9] + v->ec.Z * m[10] + v->ec.W * m[11]);
-		v->pc.W = (v->ec.X * m[12] + v->ec.Y * m[13] + v->ec.Z * m[14] + v->ec.W * m[15]);
+		v->pc.X = (e->ec.X * m[0] + e->ec.Y * m[1] + e->ec.Z * m[2] + e->ec.W * m[3]);
+		v->pc.Y = (e->ec.X * m[4] + e->ec.Y * m[5] + e->ec.Z * m[6] + e->ec.W * m[7]);
+		v->pc.Z = (e->ec.X * m[8] + e->ec.Y * m[9] + e->ec.Z * m[10] + e->ec.W * m[11]);
+		v->pc.W = (e->ec.X * m[12] + e->ec.Y * m[13] + e->ec.Z * m[14] + e->ec.W * m[15]);
 
 		m = &c->matrix_model_view_inv.m[0][0];
 		n = &c->current_normal;
 
-		v->normal.X = (n->X * m[0] + n->Y * m[1] + n->Z * m[2]);
-		v->normal.Y = (n->X * m[4] + n->Y * m[5] + n->Z * m[6]);
-		v->normal.Z = (n->X * m[8] + n->Y * m[9] + n->Z * m[10]);
+		e->normal.X = (n->X * m[0] + n->Y * m[1] + n->Z * m[2]);
+		e->normal.Y = (n->X * m[4] + n->Y * m[5] + n->Z * m[6]);
+		e->normal.Z = (n->X * m[8] + n->Y * m[9] + n->Z * m[10]);
 
 		if (c->normalize_enabled) {
-			gl_V3_Norm_Fast(&v->normal);
+			gl_V3_Norm_Fast(&e->normal);
 		}
 	}
 
@@ -190,51 +231,123 @@ static void gl_vertex_transform(GLVertex* v) {
 		/* NOTE: W = 1 is assumed */
 		m = &c->matrix_model_projection.m[0][0];
 
-		v->pc.X = (v->coord.X * m[0] + v->coord.Y * m[1] + v->coord.Z * m[2] + m[3]);
-		v->pc.Y = (v->coord.X * m[4] + v->coord.Y * m[5] + v->coord.Z * m[6] + m[7]);
-		v->pc.Z = (v->coord.X * m[8] + v->coord.Y * m[9] + v->coord.Z * m[10] + m[11]);
+		v->pc.X = (e->coord.X * m[0] + e->coord.Y * m[1] + e->coord.Z * m[2] + m[3]);
+		v->pc.Y = (e->coord.X * m[4] + e->coord.Y * m[5] + e->coord.Z * m[6] + m[7]);
+		v->pc.Z = (e->coord.X * m[8] + e->coord.Y * m[9] + e->coord.Z * m[10] + m[11]);
 		if (c->matrix_model_projection_no_w_transform) {
 			v->pc.W = m[15];
 		} else {
-			v->pc.W = (v->coord.X * m[12] + v->coord.Y * m[13] + v->coord.Z * m[14] + m[15]);
+			v->pc.W = (e->coord.X * m[12] + e->coord.Y * m[13] + e->coord.Z * m[14] + m[15]);
 		}
 	}
 
 	v->clip_code = gl_clipcode(v->pc.X, v->pc.Y, v->pc.Z, v->pc.W);
 }
 
-void glopVertex(GLParam* p) {
-	GLVertex* v;
-	GLint n, i, cnt;
+#endif
+
+static void gl_assemble_vertex(GLContext* c, GLint n, GLint cnt);
+
+#if TGL_FEATURE_FIXED_POINT == 1
+/*
+gl_vertex_compute in Q16.16. The float position, color and texture coordinates are still stored for the clipper,
+only vertices outside of the view volume are mapped to the viewport in float.
+*/
+GLint gl_vertex_compute(GLVertex* v, GLParam* p) {
 	GLContext* c = gl_get_context();
-#if TGL_FEATURE_ERROR_CHECK == 1
-	if (c->in_begin == 0)
-#define ERROR_FLAG GL_INVALID_OPERATION
+	GLVertexEyeX e;
+	V4x pc, color, tc;
+	GLint i, w;
+
+	for (i = 0; i < 4; i++)
+		e.coord.v[i] = gl_fx_from_float(p[1 + i].f);
+	if (c->lighting_enabled) {
+		V3x n;
+		gl_M4x_MulV4(&e.ec, &c->matrix_model_view_x, &e.coord);
+		gl_M4x_MulV4(&pc, &c->matrix_projection_x, &e.ec);
+		for (i = 0; i < 3; i++)
+			n.v[i] = gl_fx_from_float(c->current_normal.v[i]);
+		gl_M4x_MulV3(&e.normal, &c->matrix_normal_x, &n);
+		if (c->normalize_enabled)
+			gl_V3x_Norm(&e.normal);
+		gl_shade_vertex_fixed(&color, &e);
+#define RETVAL 1
 #include "error_check.h"
-#else
-	
-#endif
+		for (i = 0; i < 4; i++)
+			v->color.v[i] = gl_fx_to_float(color.v[i]);
+	} else {
+		gl_M4x_MulV4(&pc, &c->matrix_model_projection_x, &e.coord);
+		for (i = 0; i < 3; i++)
+			color.v[i] = gl_fx_from_float(c->current_color.v[i]);
+		v->color = c->current_color;
+	}
+	for (i = 0; i < 4; i++)
+		v->pc.v[i] = gl_fx_to_float(pc.v[i]);
 
-		n = c->vertex_n;
-	cnt = c->vertex_cnt;
-	cnt++;
-	c->vertex_cnt = cnt;
+	/* same as gl_clipcode */
+	w = pc.W + (pc.W >> 16);
+	v->clip_code = (pc.X < -w) | ((pc.X > w) << 1) | ((pc.Y < -w) << 2) | ((pc.Y > w) << 3) | ((pc.Z < -w) << 4) | ((pc.Z > w) << 5);
 
-	/* new vertex entry */
-	v = &c->vertex[n];
-	n++;
+	/* tex coords */
+#if TGL_OPTIMIZATION_HINT_BRANCH_COST < 1
+	if (c->texture_2d_enabled)
+#endif
+	{
+		for (i = 0; i < 4; i++)
+			tc.v[i] = gl_fx_from_float(c->current_tex_coord.v[i]);
+		if (c->apply_texture_matrix) {
+			V4x t = tc;
+			gl_M4x_MulV4(&tc, &c->matrix_texture_x, &t);
+			for (i = 0; i < 4; i++)
+				v->tex_coord.v[i] = gl_fx_to_float(tc.v[i]);
+		} else {
+			v->tex_coord = c->current_tex_coord;
+		}
+	}
+
+	if (v->clip_code == 0 && pc.W > 0) {
+		/* normalized coordinates in Q2.30, they are within [-1,1] */
+		long long winv = (1LL << 46) / pc.W;
+		GLint nx = (GLint)((pc.X * winv) >> 16);
+		GLint ny = (GLint)((pc.Y * winv) >> 16);
+		GLint nz = (GLint)((pc.Z * winv) >> 16);
+		GLViewport* vp = &c->viewport;
+		v->zp.x = (GLint)(((long long)nx * vp->scale_x[0] + ((long long)vp->trans_x[0] << 30)) >> (30 + TGL_FIXED_BITS));
+		v->zp.y = (GLint)(((long long)ny * vp->scale_x[1] + ((long long)vp->trans_x[1] << 30)) >> (30 + TGL_FIXED_BITS));
+		v->zp.z = (GLint)(((long long)nz * vp->scale_x[2]) >> 30) + vp->trans_x[2];
+		v->zp.r = (GLint)((((long long)color.v[0] * COLOR_CORRECTED_MULT_MASK) >> TGL_FIXED_BITS) + COLOR_MIN_MULT) & COLOR_MASK;
+		v->zp.g = (GLint)((((long long)color.v[1] * COLOR_CORRECTED_MULT_MASK) >> TGL_FIXED_BITS) + COLOR_MIN_MULT) & COLOR_MASK;
+		v->zp.b = (GLint)((((long long)color.v[2] * COLOR_CORRECTED_MULT_MASK) >> TGL_FIXED_BITS) + COLOR_MIN_MULT) & COLOR_MASK;
+		if (c->texture_2d_enabled) {
+			v->zp.s = (GLint)(((long long)tc.X * (ZB_POINT_S_MAX - ZB_POINT_S_MIN)) >> TGL_FIXED_BITS) + ZB_POINT_S_MIN;
+			v->zp.t = (GLint)(((long long)tc.Y * (ZB_POINT_T_MAX - ZB_POINT_T_MIN)) >> TGL_FIXED_BITS) + ZB_POINT_T_MIN;
+		}
+	} else {
+		/* clipped or in the guard band, rare enough for the float code */
+		gl_transform_to_viewport_vertex_c(v);
+	}
 
-	v->coord.X = p[1].f;
-	v->coord.Y = p[2].f;
-	v->coord.Z = p[3].f;
-	v->coord.W = p[4].f;
+	/* edge flag */
+	v->edge_flag = c->current_edge_flag;
+	return 0;
+}
+#else
+/* everything about a vertex that only depends on its coordinates and on the current state. Nonzero if out of memory. */
+GLint gl_vertex_compute(GLVertex* v, GLParam* p) {
+	GLContext* c = gl_get_context();
+	GLVertexEye e;
+	e.coord.X = p[1].f;
+	e.coord.Y = p[2].f;
+	e.coord.Z = p[3].f;
+	e.coord.W = p[4].f;
 
-	gl_vertex_transform(v);
+	gl_vertex_transform(v, &e);
 
 	/* color */
 
 	if (c->lighting_enabled) {
-		gl_shade_vertex(v);
+		gl_shade_vertex(v, &e);
+#define RETVAL 1
 #include "error_check.h"
 		
 	} else {
@@ -261,7 +374,50 @@ void glopVertex(GLParam* p) {
 
 	/* edge flag */
 	v->edge_flag = c->current_edge_flag;
+	return 0;
+}
+#endif
+
+void glopVertex(GLParam* p) {
+	GLVertex* v;
+	GLint n, cnt;
+	GLContext* c = gl_get_context();
+#if TGL_FEATURE_ERROR_CHECK == 1
+	if (c->in_begin == 0)
+#define ERROR_FLAG GL_INVALID_OPERATION
+#include "error_check.h"
+#else
+	
+#endif
+
+		n = c->vertex_n;
+	cnt = c->vertex_cnt;
+	cnt++;
+	c->vertex_cnt = cnt;
+
+	/* new vertex entry */
+	v = &c->vertex[n];
+	n++;
 
+	if (gl_vertex_compute(v, p))
+		return;
+
+	gl_assemble_vertex(c, n, cnt);
+}
+
+/* a vertex computed earlier by gl_vertex_compute, for the post-transform cache of glDrawElements */
+void gl_vertex_cached(const GLVertex* v) {
+	GLContext* c = gl_get_context();
+	GLint n = c->vertex_n, cnt = ++c->vertex_cnt;
+	c->vertex[n] = *v;
+	gl_assemble_vertex(c, n + 1, cnt);
+}
+
+/* primitive assembly once c->vertex[n - 1] is ready, cnt is the number of vertices since glBegin */
+static void gl_assemble_vertex(GLContext* c, GLint n, GLint cnt) {
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 0
+	GLint i;
+#endif
 	switch (c->begin_type) {
 	case GL_POINTS:
 		gl_draw_point(&c->vertex[0]);
@@ -278,6 +434,15 @@ void glopVertex(GLParam* p) {
 #if TGL_FEATURE_GL_POLYGON == 1
 	case GL_LINE_LOOP:
 #endif
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 1
+		/* the vertices alternate between slots 0 and 1, slot 2 keeps the first one for GL_LINE_LOOP */
+		if (cnt == 1) {
+			c->vertex[2] = c->vertex[0];
+		} else {
+			gl_draw_line(&c->vertex[2 - n], &c->vertex[n - 1]);
+			n = 2 - n;
+		}
+#else
 		switch (n) {
 		case 1: {
 			c->vertex[2] = c->vertex[0];
@@ -290,6 +455,7 @@ void glopVertex(GLParam* p) {
 		default:
 			break;
 		};
+#endif
 		break;
 	case GL_TRIANGLES:
 		if (n == 3) {
@@ -314,11 +480,19 @@ void glopVertex(GLParam* p) {
 		}
 		break;
 	case GL_TRIANGLE_FAN:
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 1
+		/* the last two vertices alternate between slots 1 and 2 */
+		if (cnt >= 3) {
+			gl_draw_triangle(&c->vertex[0], &c->vertex[4 - n], &c->vertex[n - 1]);
+			n = 4 - n;
+		}
+#else
 		if (n == 3) {
 			gl_draw_triangle(&c->vertex[0], &c->vertex[1], &c->vertex[2]);
 			c->vertex[1] = c->vertex[2];
 			n = 2;
 		}
+#endif
 		break;
 
 	case GL_QUADS:
@@ -333,6 +507,17 @@ void glopVertex(GLParam* p) {
 		break;
 
 	case GL_QUAD_STRIP:
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 1
+		/* the last two pairs alternate between slots 0, 1 and 2, 3 */
+		if (n == 4) {
+			gl_draw_triangle(&c->vertex[0], &c->vertex[1], &c->vertex[2]);
+			gl_draw_triangle(&c->vertex[1], &c->vertex[3], &c->vertex[2]);
+			n = 0;
+		} else if (n == 2 && cnt >= 4) {
+			gl_draw_triangle(&c->vertex[2], &c->vertex[3], &c->vertex[0]);
+			gl_draw_triangle(&c->vertex[3], &c->vertex[1], &c->vertex[0]);
+		}
+#else
 		if (n == 4) {
 			gl_draw_triangle(&c->vertex[0], &c->vertex[1], &c->vertex[2]);
 			gl_draw_triangle(&c->vertex[1], &c->vertex[3], &c->vertex[2]);
@@ -340,6 +525,7 @@ void glopVertex(GLParam* p) {
 				c->vertex[i] = c->vertex[i + 2];
 			n = 2;
 		}
+#endif
 		break;
 
 #if TGL_FEATURE_GL_POLYGON == 1
@@ -374,7 +560,12 @@ void glopEnd(GLParam* param) {
 #if TGL_FEATURE_GL_POLYGON == 1
 		if (c->begin_type == GL_LINE_LOOP) {
 			if (c->vertex_cnt >= 3) {
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 1
+				/* the last vertex is in the slot that isn't next */
+				gl_draw_line(&c->vertex[1 - c->vertex_n], &c->vertex[2]);
+#else
 				gl_draw_line(&c->vertex[0], &c->vertex[2]);
+#endif
 			}
 		} else if (c->begin_type == GL_POLYGON) {
 			GLint i = c->vertex_cnt;
@@ -385,4 +576,384 @@ void glopEnd(GLParam* param) {
 		}
 #endif
 	c->in_begin = 0;
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 1
+	c->vertex_batching = 0;
+#endif
+}
+
+#if TGL_FEATURE_BATCHED_ARRAYS == 1 || TGL_FEATURE_LIST_COMPILER == 1 || TGL_FEATURE_IMMEDIATE_BATCHING == 1
+/*
+glDrawArrays without the per-vertex ops. The client arrays are read TGL_VERTEX_BATCH_SIZE vertices at a time
+into SoA arrays, transformed and clip coded by plain loops the compiler can vectorize, then every vertex goes
+through the same per-vertex work and primitive assembly as glopVertex. The arithmetic is the same as
+gl_vertex_transform, so the output is identical.
+*/
+void gl_draw_arrays_batch(GLint first, GLint count) {
+	GLContext* c = gl_get_context();
+	GLint states = c->client_states;
+	GLfloat vx[TGL_VERTEX_BATCH_SIZE], vy[TGL_VERTEX_BATCH_SIZE], vz[TGL_VERTEX_BATCH_SIZE];
+	GLfloat ex[TGL_VERTEX_BATCH_SIZE], ey[TGL_VERTEX_BATCH_SIZE], ez[TGL_VERTEX_BATCH_SIZE], ew[TGL_VERTEX_BATCH_SIZE];
+	GLfloat px[TGL_VERTEX_BATCH_SIZE], py[TGL_VERTEX_BATCH_SIZE], pz[TGL_VERTEX_BATCH_SIZE], pw[TGL_VERTEX_BATCH_SIZE];
+	GLfloat nx[TGL_VERTEX_BATCH_SIZE], ny[TGL_VERTEX_BATCH_SIZE], nz[TGL_VERTEX_BATCH_SIZE];
+	GLint cc[TGL_VERTEX_BATCH_SIZE];
+	GLint base, end = first + count;
+#if TGL_FEATURE_BATCHED_LIGHTING == 1
+	GLfloat mat[7][TGL_VERTEX_BATCH_SIZE], col[4][TGL_VERTEX_BATCH_SIZE];
+	/* the color material type, if it changes the front material at every vertex */
+	GLint cm = ((states & COLOR_ARRAY) && c->color_material_enabled && c->current_color_material_mode != GL_BACK)
+				   ? c->current_color_material_type
+				   : 0;
+	/* the other color material types go through gl_shade_vertex */
+	GLint batch_lit = c->lighting_enabled && (cm == 0 || cm == GL_AMBIENT || cm == GL_DIFFUSE || cm == GL_AMBIENT_AND_DIFFUSE);
+#endif
+
+	if (!(states & VERTEX_ARRAY)) {
+		/* no vertex is emitted, only the current values change */
+		if (count > 0) {
+			GLParam p[2];
+			p[1].i = end - 1;
+			glopArrayElement(p);
+		}
+		return;
+	}
+
+	for (base = first; base < end; base += TGL_VERTEX_BATCH_SIZE) {
+		GLint nb = (end - base < TGL_VERTEX_BATCH_SIZE) ? end - base : TGL_VERTEX_BATCH_SIZE;
+		GLint i;
+		GLfloat* m;
+		{
+			GLint size = c->vertex_array_size, step = size + c->vertex_array_stride;
+			GLfloat* a = c->vertex_array + base * step;
+			for (i = 0; i < nb; i++, a += step) {
+				vx[i] = a[0];
+				vy[i] = a[1];
+				/* w is taken as 1, like gl_vertex_transform */
+				vz[i] = (size > 2) ? a[2] : 0.0f;
+			}
+		}
+
+		if (c->lighting_enabled) {
+			m = &c->matrix_stack_ptr[0]->m[0][0];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+			for (i = 0; i < nb; i++) {
+				ex[i] = (vx[i] * m[0] + vy[i] * m[1] + vz[i] * m[2] + m[3]);
+				ey[i] = (vx[i] * m[4] + vy[i] * m[5] + vz[i] * m[6] + m[7]);
+				ez[i] = (vx[i] * m[8] + vy[i] * m[9] + vz[i] * m[10] + m[11]);
+				ew[i] = (vx[i] * m[12] + vy[i] * m[13] + vz[i] * m[14] + m[15]);
+			}
+			m = &c->matrix_stack_ptr[1]->m[0][0];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+			for (i = 0; i < nb; i++) {
+				px[i] = (ex[i] * m[0] + ey[i] * m[1] + ez[i] * m[2] + ew[i] * m[3]);
+				py[i] = (ex[i] * m[4] + ey[i] * m[5] + ez[i] * m[6] + ew[i] * m[7]);
+				pz[i] = (ex[i] * m[8] + ey[i] * m[9] + ez[i] * m[10] + ew[i] * m[11]);
+				pw[i] = (ex[i] * m[12] + ey[i] * m[13] + ez[i] * m[14] + ew[i] * m[15]);
+			}
+			if (states & NORMAL_ARRAY) {
+				GLint step = 3 + c->normal_array_stride;
+				GLfloat* a = c->normal_array + base * step;
+				for (i = 0; i < nb; i++, a += step) {
+					nx[i] = a[0];
+					ny[i] = a[1];
+					nz[i] = a[2];
+				}
+			} else {
+				for (i = 0; i < nb; i++) {
+					nx[i] = c->current_normal.X;
+					ny[i] = c->current_normal.Y;
+					nz[i] = c->current_normal.Z;
+				}
+			}
+			m = &c->matrix_model_view_inv.m[0][0];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+			for (i = 0; i < nb; i++) {
+				GLfloat x = nx[i], y = ny[i], z = nz[i];
+				nx[i] = (x * m[0] + y * m[1] + z * m[2]);
+				ny[i] = (x * m[4] + y * m[5] + z * m[6]);
+				nz[i] = (x * m[8] + y * m[9] + z * m[10]);
+			}
+#if TGL_FEATURE_BATCHED_LIGHTING == 1
+			if (batch_lit) {
+				if (c->normalize_enabled)
+					for (i = 0; i < nb; i++) {
+						V3 n;
+						n.X = nx[i];
+						n.Y = ny[i];
+						n.Z = nz[i];
+						gl_V3_Norm_Fast(&n);
+						nx[i] = n.X;
+						ny[i] = n.Y;
+						nz[i] = n.Z;
+					}
+				if (cm) {
+					GLMaterial* fm = &c->materials[0];
+					GLint size = c->color_array_size, step = size + c->color_array_stride;
+					GLint ambient = (cm != GL_DIFFUSE), diffuse = (cm != GL_AMBIENT);
+					GLfloat* a = c->color_array + base * step;
+					for (i = 0; i < nb; i++, a += step) {
+						GLint k;
+						for (k = 0; k < 3; k++) {
+							mat[k][i] = ambient ? clampf(a[k], 0, 1) : fm->ambient.v[k];
+							mat[3 + k][i] = diffuse ? clampf(a[k], 0, 1) : fm->diffuse.v[k];
+						}
+						mat[6][i] = diffuse ? clampf((size > 3) ? a[3] : 1.0f, 0, 1) : fm->diffuse.v[3];
+					}
+				}
+				gl_shade_vertices(nb, ex, ey, ez, nx, ny, nz, cm ? mat : NULL, col);
+#include "error_check.h"
+			}
+#endif
+		} else {
+			/* NOTE: W = 1 is assumed */
+			m = &c->matrix_model_projection.m[0][0];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+			for (i = 0; i < nb; i++) {
+				px[i] = (vx[i] * m[0] + vy[i] * m[1] + vz[i] * m[2] + m[3]);
+				py[i] = (vx[i] * m[4] + vy[i] * m[5] + vz[i] * m[6] + m[7]);
+				pz[i] = (vx[i] * m[8] + vy[i] * m[9] + vz[i] * m[10] + m[11]);
+				pw[i] = c->matrix_model_projection_no_w_transform ? m[15] : (vx[i] * m[12] + vy[i] * m[13] + vz[i] * m[14] + m[15]);
+			}
+		}
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+		for (i = 0; i < nb; i++)
+			cc[i] = gl_clipcode(px[i], py[i], pz[i], pw[i]);
+
+		for (i = 0; i < nb; i++) {
+			GLint idx = base + i, n = c->vertex_n, cnt = ++c->vertex_cnt;
+			GLVertex* v = &c->vertex[n];
+			n++;
+
+#if TGL_FEATURE_BATCHED_LIGHTING == 1
+			/* the colors are already lit, only the last one is left current (and in the material) */
+			if ((states & COLOR_ARRAY) && (!batch_lit || idx == end - 1)) {
+#else
+			if (states & COLOR_ARRAY) {
+#endif
+				GLint size = c->color_array_size;
+				GLfloat* a = c->color_array + idx * (size + c->color_array_stride);
+				GLParam p[5];
+				p[1].f = a[0];
+				p[2].f = a[1];
+				p[3].f = a[2];
+				p[4].f = (size > 3) ? a[3] : 1.0f;
+				glopColor(p);
+			}
+			if (states & TEXCOORD_ARRAY) {
+				GLint size = c->texcoord_array_size;
+				GLfloat* a = c->texcoord_array + idx * (size + c->texcoord_array_stride);
+				c->current_tex_coord.X = a[0];
+				c->current_tex_coord.Y = a[1];
+				c->current_tex_coord.Z = (size > 2) ? a[2] : 0.0f;
+				c->current_tex_coord.W = (size > 3) ? a[3] : 1.0f;
+			}
+
+			v->pc.X = px[i];
+			v->pc.Y = py[i];
+			v->pc.Z = pz[i];
+			v->pc.W = pw[i];
+			v->clip_code = cc[i];
+
+			if (c->lighting_enabled) {
+#if TGL_FEATURE_BATCHED_LIGHTING == 1
+				if (batch_lit) {
+					v->color.X = col[0][i];
+					v->color.Y = col[1][i];
+					v->color.Z = col[2][i];
+					v->color.W = col[3][i];
+				} else
+#endif
+				{
+					GLVertexEye e;
+					e.ec.X = ex[i];
+					e.ec.Y = ey[i];
+					e.ec.Z = ez[i];
+					e.ec.W = ew[i];
+					e.normal.X = nx[i];
+					e.normal.Y = ny[i];
+					e.normal.Z = nz[i];
+					if (c->normalize_enabled)
+						gl_V3_Norm_Fast(&e.normal);
+					gl_shade_vertex(v, &e);
+#include "error_check.h"
+				}
+			} else {
+				v->color = c->current_color;
+			}
+#if TGL_OPTIMIZATION_HINT_BRANCH_COST < 1
+			if (c->texture_2d_enabled)
+#endif
+			{
+				if (c->apply_texture_matrix) {
+					gl_M4_MulV4(&v->tex_coord, c->matrix_stack_ptr[2], &c->current_tex_coord);
+				} else {
+					v->tex_coord = c->current_tex_coord;
+				}
+			}
+#if TGL_OPTIMIZATION_HINT_BRANCH_COST < 2
+			if (v->clip_code == 0)
+#endif
+			{
+				gl_transform_to_viewport_vertex_c(v);
+			}
+			v->edge_flag = c->current_edge_flag;
+
+			gl_assemble_vertex(c, n, cnt);
+		}
+	}
+
+	/* like glArrayElement, the arrays leave their last values current */
+	if (states & NORMAL_ARRAY) {
+		GLfloat* a = c->normal_array + (end - 1) * (3 + c->normal_array_stride);
+		c->current_normal.X = a[0];
+		c->current_normal.Y = a[1];
+		c->current_normal.Z = a[2];
+	}
+}
+
+/*
+count vertices of stride floats: 4 coordinates, then the 4 colors, 3 normal and 4 texture coordinates of states
+at the given offsets. They are drawn by gl_draw_arrays_batch with the client arrays pointing into data.
+*/
+void gl_draw_vertex_batch(GLfloat* data, GLint count, GLint stride, GLint states, GLint color, GLint normal, GLint texcoord) {
+	GLContext* c = gl_get_context();
+	GLfloat *vertex_array = c->vertex_array, *color_array = c->color_array;
+	GLfloat *normal_array = c->normal_array, *texcoord_array = c->texcoord_array;
+	GLint vertex_array_size = c->vertex_array_size, vertex_array_stride = c->vertex_array_stride;
+	GLint color_array_size = c->color_array_size, color_array_stride = c->color_array_stride;
+	GLint normal_array_stride = c->normal_array_stride;
+	GLint texcoord_array_size = c->texcoord_array_size, texcoord_array_stride = c->texcoord_array_stride;
+	GLint client_states = c->client_states;
+
+	c->vertex_array = data;
+	c->vertex_array_size = 4;
+	c->vertex_array_stride = stride - 4;
+	if (states & COLOR_ARRAY) {
+		c->color_array = data + color;
+		c->color_array_size = 4;
+		c->color_array_stride = stride - 4;
+	}
+	if (states & NORMAL_ARRAY) {
+		c->normal_array = data + normal;
+		c->normal_array_stride = stride - 3;
+	}
+	if (states & TEXCOORD_ARRAY) {
+		c->texcoord_array = data + texcoord;
+		c->texcoord_array_size = 4;
+		c->texcoord_array_stride = stride - 4;
+	}
+	c->client_states = VERTEX_ARRAY | states;
+	gl_draw_arrays_batch(0, count);
+
+	c->vertex_array = vertex_array;
+	c->color_array = color_array;
+	c->normal_array = normal_array;
+	c->texcoord_array = texcoord_array;
+	c->vertex_array_size = vertex_array_size;
+	c->vertex_array_stride = vertex_array_stride;
+	c->color_array_size = color_array_size;
+	c->color_array_stride = color_array_stride;
+	c->normal_array_stride = normal_array_stride;
+	c->texcoord_array_size = texcoord_array_size;
+	c->texcoord_array_stride = texcoord_array_stride;
+	c->client_states = client_states;
+}
+#endif
+
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 1
+/* draws the recorded vertices and makes the attributes set since glBegin or the last flush current */
+static void gl_vertex_batch_flush(void) {
+	GLContext* c = gl_get_context();
+	GLfloat* a = c->batch_attribs;
+	if (c->batch_count) {
+		gl_draw_vertex_batch(c->batch_data, c->batch_count, TGL_BATCH_STRIDE, c->batch_states, 4, 8, 11);
+		c->batch_count = 0;
+	}
+	if (c->batch_states & COLOR_ARRAY) {
+		GLParam p[5];
+		p[1].f = a[0];
+		p[2].f = a[1];
+		p[3].f = a[2];
+		p[4].f = a[3];
+		glopColor(p);
+	}
+	if (c->batch_states & NORMAL_ARRAY) {
+		c->current_normal.X = a[4];
+		c->current_normal.Y = a[5];
+		c->current_normal.Z = a[6];
+		c->current_normal.W = 0;
+	}
+	if (c->batch_states & TEXCOORD_ARRAY) {
+		c->current_tex_coord.X = a[7];
+		c->current_tex_coord.Y = a[8];
+		c->current_tex_coord.Z = a[9];
+		c->current_tex_coord.W = a[10];
+	}
+	/* they are all current now */
+	c->batch_states = 0;
 }
+
+/* an attribute is set, the recorded vertices that didn't have it are drawn first */
+static void gl_vertex_batch_attrib(GLContext* c, GLint state) {
+	if (c->batch_count && !(c->batch_states & state))
+		gl_vertex_batch_flush();
+	c->batch_states |= state;
+}
+
+/*
+An op between glBegin and glEnd. Vertices and their attributes are recorded, with the attributes current
+at each vertex, and drawn TGL_VERTEX_BATCH_SIZE at a time. Any other op draws the recorded vertices first and
+is executed. Like in the list compiler, an attribute only goes in a batch once it has been set, so that the
+vertices before keep the current value (a color may have been changed by glMaterial in between).
+Nonzero if the op was recorded.
+*/
+GLint gl_vertex_batch_op(GLParam* p) {
+	GLContext* c = gl_get_context();
+	GLfloat* a = c->batch_attribs;
+	switch (p[0].op) {
+	case OP_Vertex: {
+		GLfloat* d = c->batch_data + c->batch_count * TGL_BATCH_STRIDE;
+		d[0] = p[1].f;
+		d[1] = p[2].f;
+		d[2] = p[3].f;
+		d[3] = p[4].f;
+		memcpy(d + 4, a, (TGL_BATCH_STRIDE - 4) * sizeof(GLfloat));
+		if (++c->batch_count == TGL_VERTEX_BATCH_SIZE)
+			gl_vertex_batch_flush();
+	} break;
+	case OP_Color:
+		gl_vertex_batch_attrib(c, COLOR_ARRAY);
+		a[0] = p[1].f;
+		a[1] = p[2].f;
+		a[2] = p[3].f;
+		a[3] = p[4].f;
+		break;
+	case OP_Normal:
+		gl_vertex_batch_attrib(c, NORMAL_ARRAY);
+		a[4] = p[1].f;
+		a[5] = p[2].f;
+		a[6] = p[3].f;
+		break;
+	case OP_TexCoord:
+		gl_vertex_batch_attrib(c, TEXCOORD_ARRAY);
+		a[7] = p[1].f;
+		a[8] = p[2].f;
+		a[9] = p[3].f;
+		a[10] = p[4].f;
+		break;
+	default:
+		gl_vertex_batch_flush();
+		return 0;
+	}
+	return 1;
+}
+#endif
@@ -9,6 +9,37 @@
 
 #include "zbuffer.h"
 #include "msghandling.h"
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+/* (re)allocate the coarse depth buffer for the current size. Everything is dirty until the next clear. */
+static GLint ZB_hzAlloc(ZBuffer* zb) {
+	zb->hzxsize = (zb->xsize + ZB_HZ_SIZE - 1) >> ZB_HZ_POW2;
+	zb->hzysize = (zb->ysize + ZB_HZ_SIZE - 1) >> ZB_HZ_POW2;
+	zb->hzbuf = gl_zalloc(zb->hzxsize * zb->hzysize * sizeof(GLushort));
+	zb->hzdirty = gl_malloc(zb->hzxsize * zb->hzysize);
+	if (zb->hzbuf == NULL || zb->hzdirty == NULL) {
+		if (zb->hzbuf)
+			gl_free(zb->hzbuf);
+		if (zb->hzdirty)
+			gl_free(zb->hzdirty);
+		return -1;
+	}
+	memset(zb->hzdirty, 1, zb->hzxsize * zb->hzysize);
+	return 0;
+}
+#endif
+
+#if TGL_FEATURE_LAZY_CLEAR == 1
+/* (re)allocate the clear flags for the current size, nothing is pending */
+static GLint ZB_clearFlagsAlloc(ZBuffer* zb) {
+	zb->cfxsize = (zb->xsize + (1 << ZB_CLEAR_POW2) - 1) >> ZB_CLEAR_POW2;
+	zb->cfysize = (zb->ysize + (1 << ZB_CLEAR_POW2) - 1) >> ZB_CLEAR_POW2;
+	zb->clearflags = gl_zalloc(zb->cfxsize * zb->cfysize);
+	zb->clear_pending = 0;
+	return (zb->clearflags == NULL) ? -1 : 0;
+}
+#endif
+
 ZBuffer* ZB_open(GLint xsize, GLint ysize, GLint mode,
 
 				 void* frame_buffer) {
@@ -45,10 +76,34 @@ ZBuffer* ZB_open(GLint xsize, GLint ysize, GLint mode,
 	if (zb->zbuf == NULL)
 		goto error;
 
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+	if (ZB_hzAlloc(zb)) {
+		gl_free(zb->zbuf);
+		goto error;
+	}
+#endif
+#if TGL_FEATURE_LAZY_CLEAR == 1
+	if (ZB_clearFlagsAlloc(zb)) {
+		gl_free(zb->zbuf);
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+		gl_free(zb->hzbuf);
+		gl_free(zb->hzdirty);
+#endif
+		goto error;
+	}
+#endif
+
 	if (frame_buffer == NULL) {
 		zb->pbuf = gl_malloc(zb->ysize * zb->linesize);
 		if (zb->pbuf == NULL) {
 			gl_free(zb->zbuf);
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+			gl_free(zb->hzbuf);
+			gl_free(zb->hzdirty);
+#endif
+#if TGL_FEATURE_LAZY_CLEAR == 1
+			gl_free(zb->clearflags);
+#endif
 			goto error;
 		}
 		zb->frame_buffer_allocated = 1;
@@ -57,7 +112,22 @@ ZBuffer* ZB_open(GLint xsize, GLint ysize, GLint mode,
 		zb->pbuf = frame_buffer;
 	}
 
-	zb->current_texture = NULL;
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+	ZB_setTextureFormat(zb, ZB_TEXTURE_PIXEL, NULL);
+#endif
+	ZB_setTexture(zb, NULL, 0, 0);
+	zb->clip_xmin = 0;
+	zb->clip_ymin = 0;
+	zb->clip_xmax = zb->xsize;
+	zb->clip_ymax = zb->ysize;
+#if TGL_FEATURE_MULTITHREADED_TILED_RASTER == 1
+	zb->tiles = NULL;
+#endif
+#if TGL_FEATURE_SMALL_TRIANGLES == 1
+	zb->small_triangles = 0;
+	zb->small_rejected = 0;
+	zb->small_triangle_size = TGL_SMALL_TRIANGLE_SIZE;
+#endif
 
 	return zb;
 error:
@@ -66,10 +136,20 @@ error:
 }
 
 void ZB_close(ZBuffer* zb) {
+#if TGL_FEATURE_MULTITHREADED_TILED_RASTER == 1
+	ZB_closeTiles(zb);
+#endif
 
 	if (zb->frame_buffer_allocated)
 		gl_free(zb->pbuf);
 
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+	gl_free(zb->hzbuf);
+	gl_free(zb->hzdirty);
+#endif
+#if TGL_FEATURE_LAZY_CLEAR == 1
+	gl_free(zb->clearflags);
+#endif
 	gl_free(zb->zbuf);
 	gl_free(zb);
 }
@@ -77,12 +157,17 @@ void ZB_close(ZBuffer* zb) {
 void ZB_resize(ZBuffer* zb, void* frame_buffer, GLint xsize, GLint ysize) {
 	GLint size;
 
+	ZB_flushTiles(zb);
 	/* xsize must be a multiple of 4 */
 	xsize = xsize & ~3;
 
 	zb->xsize = xsize;
 	zb->ysize = ysize;
 	zb->linesize = (xsize * PSZB);
+	zb->clip_xmin = 0;
+	zb->clip_ymin = 0;
+	zb->clip_xmax = xsize;
+	zb->clip_ymax = ysize;
 
 	size = zb->xsize * zb->ysize * sizeof(GLushort);
 
@@ -90,6 +175,17 @@ void ZB_resize(ZBuffer* zb, void* frame_buffer, GLint xsize, GLint ysize) {
 	zb->zbuf = gl_malloc(size);
 	if (zb->zbuf == NULL)
 		exit(1);
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+	gl_free(zb->hzbuf);
+	gl_free(zb->hzdirty);
+	if (ZB_hzAlloc(zb))
+		exit(1);
+#endif
+#if TGL_FEATURE_LAZY_CLEAR == 1
+	gl_free(zb->clearflags);
+	if (ZB_clearFlagsAlloc(zb))
+		exit(1);
+#endif
 	if (zb->frame_buffer_allocated)
 		gl_free(zb->pbuf);
 
@@ -114,8 +210,44 @@ void ZB_resize(ZBuffer* zb, void* frame_buffer, GLint xsize, GLint ysize) {
 }
 #endif
 
+#if TGL_FEATURE_LAZY_CLEAR == 1
+/* copy one line, the tiles that were not drawn since the last clear are copied as the clear color */
+static void ZB_copyLineLazy(ZBuffer* zb, GLint y, PIXEL* p1) {
+	GLubyte* f = zb->clearflags + (y >> ZB_CLEAR_POW2) * zb->cfxsize;
+	PIXEL* q = zb->pbuf + y * zb->xsize;
+	GLint tx = 0, tx1, x0, x1, i;
+	while (tx < zb->cfxsize) {
+		/* a run of tiles that are all cleared or all drawn */
+		GLint cleared = f[tx] & ZB_CLEAR_COLOR;
+		for (tx1 = tx + 1; tx1 < zb->cfxsize && (f[tx1] & ZB_CLEAR_COLOR) == cleared; tx1++)
+			;
+		x0 = tx << ZB_CLEAR_POW2;
+		x1 = (tx1 << ZB_CLEAR_POW2 > zb->xsize) ? zb->xsize : tx1 << ZB_CLEAR_POW2;
+		tx = tx1;
+		if (cleared) {
+			PIXEL color = zb->clear_color;
+#if TGL_FEATURE_NO_COPY_COLOR == 1
+			if ((color & TGL_COLOR_MASK) == TGL_NO_COPY_COLOR)
+				continue;
+#endif
+			for (i = x0; i < x1; i++)
+				p1[i] = color;
+		} else {
+#if TGL_FEATURE_NO_COPY_COLOR == 1
+			for (i = x0; i < x1; i++)
+				if ((q[i] & TGL_COLOR_MASK) != TGL_NO_COPY_COLOR)
+					p1[i] = q[i];
+#else
+			memcpy(p1 + x0, q + x0, (x1 - x0) * sizeof(PIXEL));
+#endif
+		}
+	}
+}
+#endif
+
 static void ZB_copyBuffer(ZBuffer* zb, void* buf, GLint linesize) {
 	GLint y, i;
+	ZB_flushTiles(zb);
 #if TGL_FEATURE_MULTITHREADED_ZB_COPYBUFFER == 1
 #ifdef _OPENMP
 #pragma omp parallel for
@@ -125,6 +257,12 @@ static void ZB_copyBuffer(ZBuffer* zb, void* buf, GLint linesize) {
 		GLubyte* p1;
 		q = zb->pbuf + y * zb->xsize;
 		p1 = (GLubyte*)buf + y * linesize;
+#if TGL_FEATURE_LAZY_CLEAR == 1
+		if (zb->clear_pending) {
+			ZB_copyLineLazy(zb, y, (PIXEL*)p1);
+			continue;
+		}
+#endif
 #if TGL_FEATURE_NO_COPY_COLOR == 1
 		for (i = 0; i < zb->xsize; i++) {
 			if ((*(q + i) & TGL_COLOR_MASK) != TGL_NO_COPY_COLOR)
@@ -142,6 +280,12 @@ static void ZB_copyBuffer(ZBuffer* zb, void* buf, GLint linesize) {
 		GLubyte* p1;
 		q = zb->pbuf + y * zb->xsize;
 		p1 = (GLubyte*)buf + y * linesize;
+#if TGL_FEATURE_LAZY_CLEAR == 1
+		if (zb->clear_pending) {
+			ZB_copyLineLazy(zb, y, (PIXEL*)p1);
+			continue;
+		}
+#endif
 #if TGL_FEATURE_NO_COPY_COLOR == 1
 		for (i = 0; i < zb->xsize; i++) {
 			if ((*(q + i) & TGL_COLOR_MASK) != TGL_NO_COPY_COLOR)
@@ -359,6 +503,34 @@ void ZB_clear(ZBuffer* zb, GLint clear_z, GLint z, GLint clear_color, GLint r, G
 	GLuint color;
 	GLint y;
 	PIXEL* pp;
+	ZB_flushTiles(zb);
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+	if (clear_z) {
+		memset_s(zb->hzbuf, z, zb->hzxsize * zb->hzysize);
+		memset(zb->hzdirty, 0, zb->hzxsize * zb->hzysize);
+	}
+#endif
+#if TGL_FEATURE_LAZY_CLEAR == 1
+	if (clear_z || clear_color) {
+		GLint i, flags = 0;
+		if (clear_z) {
+			zb->clear_z = z;
+			flags |= ZB_CLEAR_DEPTH;
+		}
+		if (clear_color) {
+#if TGL_FEATURE_FORCE_CLEAR_NO_COPY_COLOR
+			zb->clear_color = TGL_NO_COPY_COLOR;
+#else
+			zb->clear_color = RGB_TO_PIXEL(r, g, b);
+#endif
+			flags |= ZB_CLEAR_COLOR;
+		}
+		for (i = 0; i < zb->cfxsize * zb->cfysize; i++)
+			zb->clearflags[i] |= flags;
+		zb->clear_pending = 1;
+	}
+	return;
+#endif
 	if (clear_z) {
 		memset_s(zb->zbuf, z, zb->xsize * zb->ysize);
 	}
@@ -387,3 +559,94 @@ void ZB_clear(ZBuffer* zb, GLint clear_z, GLint z, GLint clear_color, GLint r, G
 		}
 	}
 }
+
+#if TGL_FEATURE_LAZY_CLEAR == 1
+void ZB_resolveClearRect(ZBuffer* zb, GLint xmin, GLint ymin, GLint xmax, GLint ymax) {
+	GLint tx, ty, y, all;
+	PIXEL color = zb->clear_color;
+	GLushort z = zb->clear_z;
+	if (xmin < zb->clip_xmin) xmin = zb->clip_xmin;
+	if (ymin < zb->clip_ymin) ymin = zb->clip_ymin;
+	if (xmax >= zb->clip_xmax) xmax = zb->clip_xmax - 1;
+	if (ymax >= zb->clip_ymax) ymax = zb->clip_ymax - 1;
+	all = (xmin == 0 && ymin == 0 && xmax == zb->xsize - 1 && ymax == zb->ysize - 1);
+	for (ty = ymin >> ZB_CLEAR_POW2; ty <= ymax >> ZB_CLEAR_POW2; ty++)
+		for (tx = xmin >> ZB_CLEAR_POW2; tx <= xmax >> ZB_CLEAR_POW2; tx++) {
+			GLubyte* f = zb->clearflags + tx + ty * zb->cfxsize;
+			GLint x0 = tx << ZB_CLEAR_POW2, y0 = ty << ZB_CLEAR_POW2;
+			GLint w = (x0 + (1 << ZB_CLEAR_POW2) > zb->xsize) ? zb->xsize - x0 : (1 << ZB_CLEAR_POW2);
+			GLint h = (y0 + (1 << ZB_CLEAR_POW2) > zb->ysize) ? zb->ysize - y0 : (1 << ZB_CLEAR_POW2);
+			if (*f == 0)
+				continue;
+			for (y = y0; y < y0 + h; y++) {
+				GLint x;
+				if (*f & ZB_CLEAR_COLOR) {
+					PIXEL* pp = zb->pbuf + y * zb->xsize + x0;
+					for (x = 0; x < w; x++)
+						pp[x] = color;
+				}
+				if (*f & ZB_CLEAR_DEPTH) {
+					GLushort* pz = zb->zbuf + y * zb->xsize + x0;
+					for (x = 0; x < w; x++)
+						pz[x] = z;
+				}
+			}
+			*f = 0;
+		}
+	/* the clip rectangle is never the whole buffer in the threads of ZB_flushTiles, unless there is only one tile */
+	if (all)
+		zb->clear_pending = 0;
+}
+#endif
+
+void* ZB_get_buffer(ZBuffer* zb) {
+	ZB_flushTiles(zb);
+	ZB_resolveClear(zb, 0, 0, zb->xsize - 1, zb->ysize - 1);
+	return zb->pbuf;
+}
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+GLushort ZB_hzTile(ZBuffer* zb, GLint tx, GLint ty) {
+	GLint i = tx + ty * zb->hzxsize;
+	if (zb->hzdirty[i]) {
+		GLint x0 = tx << ZB_HZ_POW2, y0 = ty << ZB_HZ_POW2;
+		GLint w = (x0 + ZB_HZ_SIZE > zb->xsize) ? zb->xsize - x0 : ZB_HZ_SIZE;
+		GLint h = (y0 + ZB_HZ_SIZE > zb->ysize) ? zb->ysize - y0 : ZB_HZ_SIZE;
+		GLint x, y, m = 0xffff;
+		for (y = 0; y < h; y++) {
+			GLushort* pz = zb->zbuf + (y0 + y) * zb->xsize + x0;
+#ifdef _OPENMP
+#pragma omp simd reduction(min : m)
+#endif
+			for (x = 0; x < w; x++)
+				m = (pz[x] < m) ? pz[x] : m;
+		}
+		zb->hzbuf[i] = m;
+		zb->hzdirty[i] = 0;
+	}
+	return zb->hzbuf[i];
+}
+
+GLint ZB_hzReject(ZBuffer* zb, GLint xmin, GLint ymin, GLint xmax, GLint ymax, GLint zmax) {
+	GLint tx, ty;
+	for (ty = ymin >> ZB_HZ_POW2; ty <= ymax >> ZB_HZ_POW2; ty++)
+		for (tx = xmin >> ZB_HZ_POW2; tx <= xmax >> ZB_HZ_POW2; tx++)
+			if (zmax >= ZB_hzTile(zb, tx, ty))
+				return 0;
+	return 1;
+}
+
+void ZB_hzDirty(ZBuffer* zb, GLint xmin, GLint ymin, GLint xmax, GLint ymax) {
+	GLint ty;
+	if (xmin < zb->clip_xmin) xmin = zb->clip_xmin;
+	if (ymin < zb->clip_ymin) ymin = zb->clip_ymin;
+	if (xmax >= zb->clip_xmax) xmax = zb->clip_xmax - 1;
+	if (ymax >= zb->clip_ymax) ymax = zb->clip_ymax - 1;
+	if (xmin > xmax || ymin > ymax)
+		return;
+	xmin >>= ZB_HZ_POW2;
+	xmax >>= ZB_HZ_POW2;
+	for (ty = ymin >> ZB_HZ_POW2; ty <= ymax >> ZB_HZ_POW2; ty++)
+		memset(zb->hzdirty + ty * zb->hzxsize + xmin, 1, xmax - xmin + 1);
+}
+#endif
@@ -21,15 +21,19 @@
 #define ZB_POINT_S_MAX ( (1<<(1+TGL_FEATURE_TEXTURE_POW2+ZB_POINT_S_FRAC_BITS))-ZB_POINT_S_MIN )
 #define ZB_POINT_T_MIN ( (1<<ZB_POINT_T_FRAC_BITS) )
 #define ZB_POINT_T_MAX ( (1<<(1+TGL_FEATURE_TEXTURE_POW2+ZB_POINT_T_FRAC_BITS))-ZB_POINT_T_MIN )
-#define ZB_POINT_S_VALUE (ZB_POINT_S_FRAC_BITS + 4)
-#define ZB_POINT_T_VALUE (ZB_POINT_T_FRAC_BITS - 4)
-#define ZB_S_MASK ((TGL_FEATURE_TEXTURE_DIM-1)<<(ZB_POINT_S_FRAC_BITS+1))
-#define ZB_T_MASK ((TGL_FEATURE_TEXTURE_DIM-1)<<(ZB_POINT_T_FRAC_BITS+1))
 
-#if ZB_POINT_T_FRAC_BITS == (ZB_POINT_S_FRAC_BITS + TGL_FEATURE_TEXTURE_POW2)
-#define ST_TO_TEXTURE_BYTE_OFFSET(s,t) ( ((s & ZB_S_MASK) | (t & ZB_T_MASK)) >> (ZB_POINT_S_VALUE-PSZSH))
+/*
+s and t span TGL_FEATURE_TEXTURE_DIM texels, a smaller texture uses their top bits.
+The masks and shifts of the current texture (ZBTexture, see ZB_setTexture) move them to the byte offset of the texel.
+With TGL_FEATURE_TILED_TEXTURES the position in the tile and the tile are moved apart.
+*/
+/* log2 of the side of a tile (and of a ZB_TEXTURE_DXT1 block) */
+#define ZB_TEXTURE_TILE_LOG2 2
+#if TGL_FEATURE_TILED_TEXTURES == 1
+#define ST_TO_TEXTURE_BYTE_OFFSET(texture,s,t) ( (((s) & (texture).s_mask) >> (texture).s_shift) | (((t) & (texture).t_mask) >> (texture).t_shift) | \
+ (((s) & (texture).s_tile_mask) >> (texture).s_tile_shift) | (((t) & (texture).t_tile_mask) >> (texture).t_tile_shift) )
 #else
-#define ST_TO_TEXTURE_BYTE_OFFSET(s,t) ( ((s & ZB_S_MASK)>>(ZB_POINT_S_VALUE-PSZSH)) | ((t & ZB_T_MASK)>>(ZB_POINT_T_VALUE-PSZSH))  )
+#define ST_TO_TEXTURE_BYTE_OFFSET(texture,s,t) ( (((s) & (texture).s_mask) >> (texture).s_shift) | (((t) & (texture).t_mask) >> (texture).t_shift) )
 #endif
 
 /*The corrected mult mask prevents a bug relating to color interp. it's also why the color bit depth is so damn high.*/
@@ -56,10 +60,23 @@
 #endif
 /*This is how textures are sampled. if you want to do some sort of fancy texture filtering,*/
 /*you do it here.*/
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+/* the other texel formats are decoded by ZB_sampleTexture */
 #define TEXTURE_SAMPLE(texture, s, t)														\
- (*(PIXEL*)( (GLbyte*)texture + 															\
- ST_TO_TEXTURE_BYTE_OFFSET(s,t) 								\
+ ((texture).format == ZB_TEXTURE_PIXEL ? *(const PIXEL*)( (const GLbyte*)(texture).pixmap + ST_TO_TEXTURE_BYTE_OFFSET(texture,s,t) ) : \
+ ZB_sampleTexture(&(texture), (s), (t)))
+#else
+#define TEXTURE_SAMPLE(texture, s, t)														\
+ (*(const PIXEL*)( (const GLbyte*)(texture).pixmap + 															\
+ ST_TO_TEXTURE_BYTE_OFFSET(texture,s,t) 								\
  ))
+#endif
+
+/* texel formats, only ZB_TEXTURE_PIXEL without TGL_FEATURE_TEXTURE_FORMATS */
+#define ZB_TEXTURE_PIXEL 0  /* PIXEL */
+#define ZB_TEXTURE_565 1    /* GLushort, 5 bits of red, 6 of green, 5 of blue */
+#define ZB_TEXTURE_INDEX8 2 /* GLubyte, index in a palette of 256 PIXEL */
+#define ZB_TEXTURE_DXT1 3   /* 4x4 blocks of 8 bytes: 2 565 colors, then 2 bits per texel (S3TC DXT1 without alpha) */
 /* display modes */
 #define ZB_MODE_5R6G5B  1  /* true color 16 bits */
 #define ZB_MODE_INDEX   2  /* color index 8 bits */
@@ -243,13 +260,39 @@ typedef GLushort PIXEL;
 #endif
 
 
+/* texture of the textured rasterizers, copied to a local by their DRAW_INIT */
+typedef struct {
+	const PIXEL* pixmap;
+	GLuint s_mask, t_mask;
+	GLint s_shift, t_shift;
+#if TGL_FEATURE_TILED_TEXTURES == 1 || TGL_FEATURE_TEXTURE_FORMATS == 1
+	GLuint s_tile_mask, t_tile_mask;
+	GLint s_tile_shift, t_tile_shift;
+#endif
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+	GLint format;
+	const PIXEL* palette;
+#endif
+} ZBTexture;
+
 typedef struct {
 
     
     
     GLushort *zbuf;
     PIXEL *pbuf;
-    PIXEL *current_texture;
+    ZBTexture current_texture;
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+    /* of the textures given to ZB_setTexture */
+    GLint texture_format;
+    const PIXEL* texture_palette;
+#endif
+#if TGL_FEATURE_MIPMAPPING == 1
+    /* current_texture is level 0, the texel steps are taken in 1/256 level 0 texels */
+    ZBTexture texture_levels[TGL_FEATURE_TEXTURE_POW2 + 1];
+    GLint texture_max_level;
+    GLint texture_s_lod_shift, texture_t_lod_shift;
+#endif
     
 
 	/* point size*/
@@ -269,10 +312,36 @@ typedef struct {
     GLint enable_blend;
     GLint xsize,ysize;
     GLint linesize; /* line size, in bytes */
+    /* triangles are only rasterized inside [clip_xmin,clip_xmax) x [clip_ymin,clip_ymax) */
+    GLint clip_xmin,clip_ymin,clip_xmax,clip_ymax;
     /* depth */
     GLint depth_test;
     GLint depth_write;
     GLubyte frame_buffer_allocated;
+#if TGL_FEATURE_MULTITHREADED_TILED_RASTER == 1
+    /* triangles binned by ztile.c, waiting for ZB_flushTiles */
+    struct ZBTiles *tiles;
+#endif
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+    /* one entry per 8x8 tile: the smallest (farthest) z in the tile. Dirty entries are recomputed when needed. */
+    GLushort *hzbuf;
+    GLubyte *hzdirty;
+    GLint hzxsize,hzysize;
+#endif
+#if TGL_FEATURE_LAZY_CLEAR == 1
+    /* one byte per 8x8 tile, ZB_CLEAR_COLOR and/or ZB_CLEAR_DEPTH while the last clear has not been written to it */
+    GLubyte *clearflags;
+    GLint cfxsize,cfysize;
+    GLint clear_pending; /* some tiles may have flags set */
+    PIXEL clear_color;
+    GLushort clear_z;
+#endif
+#if TGL_FEATURE_SMALL_TRIANGLES == 1
+    /* triangles drawn and rejected by the small triangle path, see glGetIntegerv */
+    GLuint small_triangles, small_rejected;
+    /* bounding boxes smaller than this take the small triangle path, at most TGL_SMALL_TRIANGLE_SIZE, 0 for none */
+    GLint small_triangle_size;
+#endif
 } ZBuffer;
 
 typedef struct {
@@ -299,6 +368,38 @@ void ZB_clear(ZBuffer *zb,GLint clear_z,GLint z,
 	      GLint clear_color,GLint r,GLint g,GLint b);
 /* linesize is in BYTES */
 void ZB_copyFrameBuffer(ZBuffer *zb,void *buf,GLint linesize);
+/* the color buffer, with everything drawn and cleared */
+void *ZB_get_buffer(ZBuffer *zb);
+
+#if TGL_FEATURE_LAZY_CLEAR == 1
+#define ZB_CLEAR_POW2 3
+#define ZB_CLEAR_COLOR 1
+#define ZB_CLEAR_DEPTH 2
+#if TGL_FEATURE_MULTITHREADED_TILED_RASTER == 1 && TGL_RASTER_TILE_POW2 < ZB_CLEAR_POW2
+#error "Raster tiles must not be smaller than the lazy clear tiles."
+#endif
+/* write the pending clear to the rectangle (inclusive, clipped to the clip rectangle) before drawing into it */
+void ZB_resolveClearRect(ZBuffer *zb,GLint xmin,GLint ymin,GLint xmax,GLint ymax);
+#define ZB_resolveClear(zb,xmin,ymin,xmax,ymax) ((zb)->clear_pending ? ZB_resolveClearRect(zb,xmin,ymin,xmax,ymax) : (void)0)
+#else
+#define ZB_resolveClear(zb,xmin,ymin,xmax,ymax) /* glClear writes everything */
+#endif
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+#define ZB_HZ_POW2 3
+#define ZB_HZ_SIZE (1 << ZB_HZ_POW2)
+#if TGL_FEATURE_MULTITHREADED_TILED_RASTER == 1 && TGL_RASTER_TILE_POW2 < ZB_HZ_POW2
+#error "Raster tiles must not be smaller than the hierarchical Z tiles."
+#endif
+/* the smallest z stored in a hierarchical Z tile */
+GLushort ZB_hzTile(ZBuffer *zb,GLint tx,GLint ty);
+/* 1 if no z in the rectangle (inclusive, inside the clip rectangle) is >= zmax. Only meaningful with depth testing. */
+GLint ZB_hzReject(ZBuffer *zb,GLint xmin,GLint ymin,GLint xmax,GLint ymax,GLint zmax);
+/* the depth buffer may have been written in this rectangle (inclusive, clipped to the clip rectangle) */
+void ZB_hzDirty(ZBuffer *zb,GLint xmin,GLint ymin,GLint xmax,GLint ymax);
+#else
+#define ZB_hzDirty(zb,xmin,ymin,xmax,ymax) /* no hierarchical Z */
+#endif
 
 /* zdither.c */
 
@@ -317,7 +418,17 @@ void ZB_line_z(ZBuffer * zb, ZBufferPoint * p1, ZBufferPoint * p2);
 
 /* ztriangle.c */
 
-void ZB_setTexture(ZBuffer *zb, PIXEL *texture);
+/* xsize_log2 and ysize_log2 at most TGL_FEATURE_TEXTURE_POW2 */
+void ZB_setTexture(ZBuffer *zb, const PIXEL *texture, GLint xsize_log2, GLint ysize_log2);
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+/* before ZB_setTexture, texture then points to texels of that format (ZB_TEXTURE_*) */
+void ZB_setTextureFormat(ZBuffer *zb, GLint format, const PIXEL *palette);
+PIXEL ZB_sampleTexture(const ZBTexture *texture, GLuint s, GLuint t);
+#endif
+#if TGL_FEATURE_MIPMAPPING == 1
+/* after ZB_setTexture, levels 1, 2... in order, each half the size of the previous one */
+void ZB_setTextureLevel(ZBuffer *zb, GLint level, const PIXEL *texture, GLint xsize_log2, GLint ysize_log2);
+#endif
 
 void ZB_fillTriangleFlat(ZBuffer *zb,
 		 ZBufferPoint *p1,ZBufferPoint *p2,ZBufferPoint *p3);
@@ -346,17 +457,69 @@ void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer *zb,
 typedef void (*ZB_fillTriangleFunc)(ZBuffer  *,
 	    ZBufferPoint *,ZBufferPoint *,ZBufferPoint *);
 
+#if TGL_FEATURE_SPECIALIZED_KERNELS == 1
+#define ZB_FILL_FLAT    0
+#define ZB_FILL_SMOOTH  1
+#define ZB_FILL_TEXTURE 2
+/* the kernel compiled for the current depth, blend and stipple state, NULL if there is none */
+ZB_fillTriangleFunc ZB_selectTriangleFunc(ZBuffer *zb, GLint fill);
+#endif
+
+/* ztile.c */
+#if TGL_FEATURE_MULTITHREADED_TILED_RASTER == 1
+void ZB_binTriangle(ZBuffer *zb, ZB_fillTriangleFunc fill,
+		    ZBufferPoint *p0,ZBufferPoint *p1,ZBufferPoint *p2);
+/* rasterize everything binned so far. Must be called before anything else reads or writes the buffers. */
+void ZB_flushTiles(ZBuffer *zb);
+void ZB_closeTiles(ZBuffer *zb);
+#else
+#define ZB_flushTiles(zb) /* nothing is ever binned */
+#endif
+
 /* memory.c */
+#if TGL_FEATURE_ALIGNAS == 1
+#include<stdlib.h>
+/* 16-byte aligned for the alignas(16) members, the distance to the malloc'd block is in the byte before */
+static inline void* gl_aligned_malloc(GLint size) {
+	GLubyte* p = malloc(size + 16);
+	GLubyte* a;
+	if (!p)
+		return NULL;
+	a = p + 16 - ((size_t)p & 15);
+	a[-1] = (GLubyte)(a - p);
+	return a;
+}
+static inline void gl_aligned_free(void* p) {
+	if (p)
+		free((GLubyte*)p - ((GLubyte*)p)[-1]);
+}
+#endif
 #if TGL_FEATURE_CUSTOM_MALLOC == 1
 void gl_free(void *p);
 void *gl_malloc(GLint size);
 void *gl_zalloc(GLint size);
+#if TGL_FEATURE_ARENA_SIZE > 0
+/* bytes of the arena in use, and the most ever in use */
+GLint gl_arena_in_use(void);
+GLint gl_arena_high_water(void);
+#endif
 #else
 #include<string.h>
 #include<stdlib.h>
+#if TGL_FEATURE_ALIGNAS == 1
+static void* gl_malloc(GLint size) { return gl_aligned_malloc(size); }
+static void* gl_zalloc(GLint size) {
+	void* p = gl_aligned_malloc(size);
+	if (p)
+		memset(p, 0, size);
+	return p;
+}
+static void gl_free(void* p) { gl_aligned_free(p); }
+#else
 static void gl_free(void* p) { free(p); }
 static void* gl_malloc(GLint size) { return malloc(size); }
 static void* gl_zalloc(GLint size) { return calloc(1, size); }
 #endif
+#endif
 
 #endif /* _tgl_zbuffer_h_ */
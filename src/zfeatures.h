@@ -21,6 +21,28 @@ a replacement gl_malloc(), gl_zalloc(), and gl_free() in memory.c
 */
 #define TGL_FEATURE_CUSTOM_MALLOC 0
 
+/*
+Static arena for gl_malloc, in bytes. When nonzero every allocation of TinyGL comes from a static array of that
+size (first fit, merged on free) instead of the heap, implies TGL_FEATURE_CUSTOM_MALLOC.
+glGetIntegerv(GL_ARENA_USED) and GL_ARENA_PEAK tell how much of it is used, and the high-water mark.
+The arena is locked with an OpenMP critical section: with TGL_FEATURE_MULTI_CONTEXT, memory.c must be built
+with -fopenmp or it fails to compile.
+*/
+#define TGL_FEATURE_ARENA_SIZE 0
+
+/*
+Pools for display list chunks, display lists, textures and buffer objects. Their freed blocks are reused by the
+next allocation of the same kind instead of going back to the heap (or arena), so rebuilding display lists
+doesn't fragment it. The blocks are only given back by glClose.
+*/
+#define TGL_FEATURE_POOLS 0
+
+/*
+Initial number of slots of the display list, texture and buffer object tables. A table doubles when a bigger handle
+is used, up to MAX_DISPLAY_LISTS, MAX_TEXTURES and MAX_BUFFERS (zgl.h).
+*/
+#define TGL_HANDLE_TABLE_SIZE 16
+
 /*
 Use Fast Inverse Square Root. Toggleable because it's actually slower on some platforms,
 And because some systems may have float types which are incompatible with it.
@@ -82,11 +104,182 @@ the maximum number of vertices in a polygon is defined in zgl.h
 #define TGL_FEATURE_MULTITHREADED_ZB_COPYBUFFER 0
 
 /*
-!!!!!WARNING!!!!!
-TGL_FEATURE_ALIGNAS assumes that the implementation's malloc (AND REALLOC) are 16-byte aligned.
+Sort-middle rasterization. Filled triangles are binned into screen tiles instead of being drawn immediately,
+and the tiles are rasterized in parallel (one thread per tile) at glFlush/glFinish, or whenever something else
+needs the framebuffer. The output is identical to the serial rasterizer.
+Remember to call glFlush or glFinish before reading the framebuffer yourself!
+*/
+#define TGL_FEATURE_MULTITHREADED_TILED_RASTER 0
+/*Tiles are 2^6 (64) pixels wide and tall.*/
+#define TGL_RASTER_TILE_POW2 6
+/*The bins are flushed automatically once this many triangles are waiting.*/
+#define TGL_RASTER_TILE_MAX_TRIANGLES 16384
+
+/*
+Rasterize triangles with edge functions, walking the screen in 8x8 blocks, instead of scanlines.
+Blocks entirely inside a triangle skip the edge tests and block rows are tested in SIMD.
+Uses the top-left fill rule, so shared edges are never drawn twice. Works with or without the tiled rasterizer.
+*/
+#define TGL_FEATURE_HALFSPACE_RASTER 0
+
+/*
+Hierarchical Z. The farthest depth stored in every 8x8 tile is kept in a small coarse buffer,
+so that triangles (and, with the half-space rasterizer, 8x8 blocks) that are entirely hidden are skipped
+without reading the depth buffer. The output is unchanged.
+*/
+#define TGL_FEATURE_HIERARCHICAL_Z 0
+
+/*
+Lazy clear. glClear only flags every 8x8 tile as cleared, the clear value is written to a tile the first time
+something is drawn into it. ZB_copyFrameBuffer copies the clear color of untouched tiles without writing it to the buffer.
+Use ZB_get_buffer (not zb->pbuf) to get a fully cleared buffer!
+*/
+#define TGL_FEATURE_LAZY_CLEAR 0
+
+/*
+State-specialized triangle kernels. The triangle template is also compiled for every combination of fill type,
+depth test, depth write and a few blend modes (none, additive and reverse subtract), with the state as constants,
+so the per pixel state tests go away. The kernel is picked once per triangle, anything else (like polygon stipple
+or other blend modes) uses the generic functions. Costs some code size.
+*/
+#define TGL_FEATURE_SPECIALIZED_KERNELS 0
+
+/*
+Write whole triangle spans with SIMD loops (#pragma omp simd), one lane per pixel, for the fills without
+run time blending (and all the specialized kernels). Needs OpenMP SIMD support (-fopenmp or -fopenmp-simd)
+and a vector unit to be of any use. The output is unchanged.
+*/
+#define TGL_FEATURE_SIMD_SPANS 0
+
+/*
+Guard band clipping. Filled triangles that don't cross the near or far plane are drawn without clipping as long
+as they fit in the guard band, the rasterizer scissors them to the screen. The other ones are clipped against
+every plane in one pass (Sutherland-Hodgman) and drawn as a fan, instead of by the recursive clipper.
+Textured triangles are clipped to the viewport in that single pass, their mapping is not exact for large triangles.
+This changes the output of every triangle that crosses the screen border, not just its edges. The rasterizer
+interpolates colors (and depth) linearly in screen space over the whole unclipped triangle, where the exact clipper
+interpolates them in clip space at the new vertices first. Gouraud shading can differ everywhere in such a
+triangle: in a scene of random smooth shaded triangles, most pixels changed, by up to 250 levels per channel.
+*/
+#define TGL_FEATURE_GUARD_BAND 0
+/*Size of the guard band in viewports. Screen coordinates must stay far below 32768.*/
+#define TGL_GUARD_BAND_SCALE 4
+
+/*
+Fast path for triangles whose bounding box is smaller than TGL_SMALL_TRIANGLE_SIZE pixels in both directions,
+which dense meshes are full of. Triangles covering no pixel center are rejected before any setup, the others
+are filled from their bounding box with the pixel rules and the span setup of the half-space rasterizer, so
+the frames are the same with or without it (smalltest.c checks that, textured too).
+glGetIntegerv(GL_SMALL_TRIANGLE_COUNT) and GL_SMALL_TRIANGLE_REJECT_COUNT tell how often it was used.
+Needs TGL_FEATURE_HALFSPACE_RASTER: the scanline rasterizer covers slightly different pixels, and a mesh drawn
+with both would leave pinholes between its small and large triangles.
+*/
+#define TGL_FEATURE_SMALL_TRIANGLES 0
+#define TGL_SMALL_TRIANGLE_SIZE 8
+
+/*
+glDrawArrays becomes a single op. The vertices are read from the arrays and transformed TGL_VERTEX_BATCH_SIZE
+at a time, in loops the compiler can vectorize, instead of one glArrayElement op per vertex. The output is unchanged.
+Each batch takes about 70 bytes of stack per vertex.
+*/
+#define TGL_FEATURE_BATCHED_ARRAYS 0
+#define TGL_VERTEX_BATCH_SIZE 32
+
+/*
+Batched lighting. The products of the lights and the front material are computed once when the lights or the material
+change instead of at every vertex. The vertex batches of TGL_FEATURE_BATCHED_ARRAYS and TGL_FEATURE_LIST_COMPILER
+are lit together, light by light, in loops the compiler can vectorize, and a color material of the ambient and/or
+diffuse color is applied per vertex without going through glMaterial. With TGL_FEATURE_SPECULAR_BUFFERS the spot
+exponent is also read from a specular buffer. The colors may differ in the last bits.
+*/
+#define TGL_FEATURE_BATCHED_LIGHTING 0
+
+/*Entries in the post-transform vertex cache of glDrawElements, a power of two. Each one is a GLVertex in the context.*/
+#define TGL_VERTEX_CACHE_SIZE 32
+
+/*
+Display list compiler. glEndList rewrites the list: the colors, normals, texture coordinates and vertices
+between glBegin and glEnd become packed vertex batches drawn by the batched transform of glDrawArrays,
+state ops overridden by the next op are dropped and consecutive matrix ops are multiplied into one.
+The premultiplied matrices may round differently in the last bits.
+*/
+#define TGL_FEATURE_LIST_COMPILER 0
+
+/*
+Frustum culling. glEndList computes the bounding box of the vertices of a list, glCallList skips the list
+when the box is outside the view volume (the attributes it sets are still left current). glArrayBounds gives
+the bounds of the client arrays for glDrawArrays and glDrawElements. Only lists with nothing but primitives
+and vertex attributes after their first glBegin are culled.
+*/
+#define TGL_FEATURE_FRUSTUM_CULLING 0
 
-Disabled by default for compatibility- you should only enable this if you KNOW that the target ALWAYS
-returns 16-byte aligned pointers.
+/*
+Several contexts. glCreateContext makes a context for a ZBuffer, optionally sharing the textures, display lists
+and buffers of another one, and glMakeCurrent binds it to the calling thread. Every thread can render its own
+context (and ZBuffer) in parallel. Threads without a current context use the one of glInit.
+Contexts and shared objects must not be created or deleted while another thread uses them.
+Changing or deleting a shared texture first draws what every context sharing it has binned (tiled rasterizer).
+A context being destroyed is no longer one of them, glFinish it first if its ZBuffer is drawn into again.
+*/
+#define TGL_FEATURE_MULTI_CONTEXT 0
+
+/*
+Affine matrix stack. Each matrix of the stacks remembers if it is rigid (rotations and translations), affine or
+general, so that the inverse for the normals is a transpose or a 3x3 inverse instead of a 4x4 Gauss-Jordan.
+glPushMatrix no longer invalidates the derived matrices, glRotate only multiplies the 3x3 part, and the
+model-view-projection and normal matrices are each recomputed only when a primitive uses them.
+The normals of rigid and affine matrices may differ in the last bits.
+*/
+#define TGL_FEATURE_AFFINE_MATRICES 0
+
+/*
+Immediate mode batching. The vertices between glBegin and glEnd are recorded with their color, normal and
+texture coordinates and drawn TGL_VERTEX_BATCH_SIZE at a time by the batched transform of glDrawArrays, when the
+batch is full, at glEnd or before any other op. Strips, fans and loops rotate through the vertex slots
+instead of copying vertices. The output is unchanged, except for the colors of TGL_FEATURE_BATCHED_LIGHTING.
+*/
+#define TGL_FEATURE_IMMEDIATE_BATCHING 0
+
+/*
+Fixed-point vertex pipeline for targets without an FPU. glVertex transforms, clip codes, lighting, texture
+coordinates and the viewport mapping are computed in Q16.16 with fixed-point copies of the matrices, lights
+and viewport. Only the vertices of clipped triangles go through the float code. Coordinates must stay within
++-32767 (after every transform), spot and (without TGL_FEATURE_SPECULAR_BUFFERS) shininess exponents are
+rounded to integers. The batched paths (glDrawArrays batches, compiled lists, immediate batching) stay float.
+fixedtest.c compares both paths on the same vertices and fails outside of its error bounds.
+*/
+#define TGL_FEATURE_FIXED_POINT 0
+
+/*
+Mipmapping. glTexImage2D and glCopyTexImage2D build the whole chain of smaller levels of the texture with a 2x2 box
+filter, down to 1x1 texel (a third more memory). The perspective texture filler picks the level nearest to the
+footprint of a pixel at each perspective correction (every NB_INTERP pixels and span), like
+GL_NEAREST_MIPMAP_NEAREST. Only level 0 can be specified. The filter averages TGL_NO_DRAW_COLOR texels with
+their neighbours like any other color.
+*/
+#define TGL_FEATURE_MIPMAPPING 0
+
+/*
+Textures stored in 4x4 texel tiles, row after row of tiles, instead of row by row. The texels of a span that walks
+across the rows of a rotated texture are then closer in memory. The images are reordered when they are specified,
+the pixmap of glGetTexturePixmap has that layout too.
+texbench.c times rotated quads and models the L1 misses of their texel fetches in either layout.
+*/
+#define TGL_FEATURE_TILED_TEXTURES 0
+
+/*
+Texel formats sampled as they are stored, for less texture memory and bandwidth. The internal format of glTexImage2D
+can be GL_RGB5 (16 bits per texel), GL_COLOR_INDEX8_EXT (GL_COLOR_INDEX images, 8 bits per texel, the palette
+is given by glColorTableEXT) or GL_COMPRESSED_RGB_S3TC_DXT1_EXT (4 bits per texel, compressed when specified).
+glCompressedTexImage2D takes DXT1 blocks directly. Textures of these formats are not mipmapped nor tiled.
+The sampler tests the format of the texture, the other formats go through a function call.
+*/
+#define TGL_FEATURE_TEXTURE_FORMATS 0
+
+/*
+16-byte alignment of the matrices and vectors (and so of the vertices, 96 bytes each), needs C11.
+gl_malloc over-allocates to return 16-byte aligned blocks, so the implementation's malloc doesn't have to.
+A custom gl_malloc (TGL_FEATURE_CUSTOM_MALLOC) must keep that guarantee. TinyGL never calls realloc.
 */
 
 #define TGL_FEATURE_ALIGNAS 0
@@ -104,6 +297,25 @@ Optimization hint- cost of branching.
 #define TGL_FEATURE_ALIGNAS 0
 #endif
 
+#if TGL_FEATURE_ARENA_SIZE > 0
+#undef TGL_FEATURE_CUSTOM_MALLOC
+#define TGL_FEATURE_CUSTOM_MALLOC 1
+#endif
+
+
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+#if defined(_MSC_VER)
+#define TGL_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define TGL_THREAD_LOCAL _Thread_local
+#else
+#define TGL_THREAD_LOCAL __thread
+#endif
+#endif
+
+#if TGL_FEATURE_SMALL_TRIANGLES == 1 && TGL_FEATURE_HALFSPACE_RASTER != 1
+#error "TGL_FEATURE_SMALL_TRIANGLES needs TGL_FEATURE_HALFSPACE_RASTER"
+#endif
 
 #if TGL_FEATURE_ALIGNAS == 1
 #include <stdalign.h>
@@ -44,7 +44,11 @@ enum {
 #define MAX_PROJECTION_STACK_DEPTH 8
 #define MAX_TEXTURE_STACK_DEPTH 8
 #define MAX_NAME_STACK_DEPTH 16
+#if TGL_FEATURE_MIPMAPPING == 1
+#define MAX_TEXTURE_LEVELS (TGL_FEATURE_TEXTURE_POW2 + 1)
+#else
 #define MAX_TEXTURE_LEVELS 1
+#endif
 #define MAX_LIGHTS 16
 
 #define VERTEX_ARRAY 0x0001
@@ -52,6 +56,9 @@ enum {
 #define NORMAL_ARRAY 0x0004
 #define TEXCOORD_ARRAY 0x0008
 
+/* floats of a vertex recorded by TGL_FEATURE_IMMEDIATE_BATCHING: coordinates, color, normal, texture coordinates */
+#define TGL_BATCH_STRIDE 15
+
 #define MAX_DISPLAY_LISTS 16384
 #define OP_BUFFER_MAX_SIZE 4096
 
@@ -79,6 +86,17 @@ typedef struct GLLight {
 	GLfloat attenuation[3];
 	/* precomputed values */
 	GLfloat cos_spot_cutoff;
+#if TGL_FEATURE_BATCHED_LIGHTING == 1 || TGL_FEATURE_FIXED_POINT == 1
+	/* products with the front material */
+	V3 ambient_product, diffuse_product, specular_product;
+#endif
+#if TGL_FEATURE_FIXED_POINT == 1
+	/* the same and the other precomputed values in Q16.16 */
+	V3x ambient_product_x, diffuse_product_x, specular_product_x;
+	V4x position_x;
+	V3x norm_position_x, norm_spot_direction_x;
+	GLint cos_spot_cutoff_x, attenuation_x[3], spot_exponent_i;
+#endif
 
 	/* we use a linked list to know which are the enabled lights */
 	
@@ -101,6 +119,10 @@ typedef struct GLMaterial {
 typedef struct GLViewport {
 	V3 scale;
 	V3 trans;
+#if TGL_FEATURE_FIXED_POINT == 1
+	/* Q16.16, except Z which is in zbuffer units (around 2^29) */
+	GLint scale_x[3], trans_x[3];
+#endif
 	GLint xmin, ymin, xsize, ysize;
 	
 } GLViewport;
@@ -118,39 +140,80 @@ typedef struct GLParamBuffer {
 	struct GLParamBuffer* next;
 } GLParamBuffer;
 
+#if TGL_FEATURE_LIST_COMPILER == 1
+/* vertices of a compiled display list, the coordinates followed by the attributes in states, interleaved */
+typedef struct GLListBatch {
+	struct GLListBatch* next;
+	GLint count, states, stride;
+	GLfloat data[];
+} GLListBatch;
+#endif
+
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+/* bounding box of a display list and the current values it leaves, for when it is culled */
+typedef struct GLListBounds {
+	/* the first glBegin, nothing after it changes the matrices or the state. NULL if the list can't be culled */
+	GLParam* begin;
+	GLfloat box[6];
+	GLint states, edge_flag;
+	GLfloat color[4], normal[3], tex_coord[4];
+} GLListBounds;
+#endif
+
 typedef struct GLList {
 	GLParamBuffer* first_op_buffer;
+#if TGL_FEATURE_LIST_COMPILER == 1
+	GLListBatch* batches;
+#endif
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+	GLListBounds bounds;
+#endif
 	/* TODO: extensions for an hash table or a better allocating scheme */
 } GLList;
 
+/* what clipping and rasterization read, 96 bytes. Kept in the vertex cache and copied when clipping. */
 typedef struct GLVertex {
-
-	V3 normal;
-	V4 coord;
-	V4 tex_coord;
-	V4 color;
-
-	/* computed values */
-	V4 ec;			 /* eye coordinates */
 	V4 pc;			 /* coordinates in the normalized volume */
 	ZBufferPoint zp; /* GLinteger coordinates for the rasterization */
 	GLint clip_code; /* clip code */
 	GLint edge_flag;
+	V4 color;
+	V4 tex_coord;
 } GLVertex;
 
+/* inputs of the transform and of the lighting, only live until the vertex is shaded */
+typedef struct GLVertexEye {
+	V4 coord;
+	V4 ec; /* eye coordinates */
+	V3 normal;
+} GLVertexEye;
+
+#if TGL_FEATURE_FIXED_POINT == 1
+typedef struct GLVertexEyeX {
+	V4x coord;
+	V4x ec;
+	V3x normal;
+} GLVertexEyeX;
+#endif
+
+/* power of two sizes, up to TGL_FEATURE_TEXTURE_DIM */
 typedef struct GLImage {
-	PIXEL pixmap[TGL_FEATURE_TEXTURE_DIM * TGL_FEATURE_TEXTURE_DIM];
+	PIXEL* pixmap; /* NULL until an image is specified */
 	GLint xsize, ysize;
+	GLint xsize_log2, ysize_log2;
+	GLint width, height; /* as specified, before the resize to a power of two */
+	GLint format; /* ZB_TEXTURE_*, the texels of pixmap are PIXEL only for ZB_TEXTURE_PIXEL */
 } GLImage;
 
 /* textures */
 
-#define TEXTURE_HASH_TABLE_SIZE 256
-#define TEXTURE_HASH_TABLE_MASK 255
+#define MAX_TEXTURES 16384
 typedef struct GLTexture {
 	GLImage images[MAX_TEXTURE_LEVELS];
-	struct GLTexture *next, *prev;
 	GLint handle;
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+	PIXEL* palette; /* of ZB_TEXTURE_INDEX8 images, 256 entries */
+#endif
 } GLTexture;
 
 /* buffers */
@@ -160,11 +223,48 @@ typedef struct GLBuffer {
 	GLuint size;
 } GLBuffer;
 
-/* shared state */
+#if TGL_FEATURE_POOLS == 1
+/* fixed-size blocks, the freed ones are kept for the next allocation of the pool (memory.c) */
+typedef struct GLPool {
+	void* free_list;
+	GLint size;
+} GLPool;
+void gl_pool_init(GLPool* p, GLint size);
+void* gl_pool_get(GLPool* p);
+void gl_pool_put(GLPool* p, void* b);
+void gl_pool_release(GLPool* p);
+/* zeroed like gl_zalloc */
+#define gl_pool_alloc(pool, size) gl_pool_get(pool)
+#define gl_pool_free(pool, b) gl_pool_put(pool, b)
+#else
+#define gl_pool_alloc(pool, size) gl_zalloc(size)
+#define gl_pool_free(pool, b) gl_free(b)
+#endif
+
+/* objects by handle, the slots grow on demand up to the limit (memory.c) */
+typedef struct GLTable {
+	void** slots;
+	GLint size, limit;
+	GLint free_hint; /* no free slot below it */
+} GLTable;
+GLint gl_table_init(GLTable* t, GLint size, GLint limit);
+GLint gl_table_set(GLTable* t, GLint h, void* obj);
+GLint gl_table_find_free(GLTable* t, GLint n);
+void gl_table_free(GLTable* t);
+#define gl_table_get(t, h) ((GLuint)(h) < (GLuint)(t)->size ? (t)->slots[h] : NULL)
+
+/* shared state, one per group of contexts sharing their objects */
 typedef struct GLSharedState {
-	GLList** lists;
-	GLTexture** texture_hash_table;
-	GLBuffer** buffers;
+	GLTable lists;	  /* by list number */
+	GLTable textures; /* by handle */
+	GLTable buffers;  /* by handle - 1 */
+#if TGL_FEATURE_POOLS == 1
+	GLPool list_pool, op_buffer_pool, texture_pool, buffer_pool;
+#endif
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+	/* the contexts using it, linked by their next_shared */
+	struct GLContext* contexts;
+#endif
 } GLSharedState;
 
 struct GLContext;
@@ -180,9 +280,24 @@ typedef struct GLContext {
 	GLViewport viewport;
 	GLMaterial materials[2];
 	GLVertex vertex[POLYGON_MAX_VERTEX];
+	/* post-transform cache of glDrawElements, tagged with the element index */
+	GLVertex vertex_cache[TGL_VERTEX_CACHE_SIZE];
+	GLint vertex_cache_tag[TGL_VERTEX_CACHE_SIZE];
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 1
+	/* immediate mode vertices recorded since glBegin or the last flush, with their attributes */
+	GLfloat batch_data[TGL_VERTEX_BATCH_SIZE * TGL_BATCH_STRIDE];
+	/* the color, normal and texture coordinates given to the next vertex */
+	GLfloat batch_attribs[TGL_BATCH_STRIDE - 4];
+	GLint batch_count, batch_states, vertex_batching;
+#endif
 
 	M4 matrix_model_view_inv;
 	M4 matrix_model_projection;
+#if TGL_FEATURE_FIXED_POINT == 1
+	/* Q16.16 copies, converted by glBegin once the float ones are up to date */
+	M4x matrix_model_view_x, matrix_projection_x, matrix_normal_x, matrix_model_projection_x, matrix_texture_x;
+	GLint matrix_fixed_dirty;
+#endif
 	V4 ambient_light_model;
 	V4 clear_color;
 	V4 current_color;
@@ -192,13 +307,23 @@ typedef struct GLContext {
 
 	/*Pointers.*/
 	/* shared state */
-	GLSharedState shared_state;
+	GLSharedState* shared_state;
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+	struct GLContext* next_shared;
+#endif
 	ZBuffer* zb;
 	GLLight* first_light;
 	GLTexture* current_texture;
 	GLParamBuffer* current_op_buffer;
+#if TGL_FEATURE_LIST_COMPILER == 1 || TGL_FEATURE_FRUSTUM_CULLING == 1
+	GLList* current_list;
+#endif
 	M4* matrix_stack[3];
 	M4* matrix_stack_ptr[3];
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+	/* TGL_MATRIX_RIGID, _AFFINE or _GENERAL for each matrix of the stacks */
+	GLubyte* matrix_stack_kind[3];
+#endif
 	gl_draw_triangle_func draw_triangle_front, draw_triangle_back;
 	/* resize viewport function */
 	GLint (*gl_resize_viewport)(GLint* xsize, GLint* ysize);
@@ -217,6 +342,16 @@ typedef struct GLContext {
 	GLint local_light_model;
 	GLint lighting_enabled;
 	GLint light_model_two_side;
+#if TGL_FEATURE_BATCHED_LIGHTING == 1 || TGL_FEATURE_FIXED_POINT == 1
+	/* emission + ambient of the front material and the light products, valid until a light or material changes */
+	V3 scene_color;
+	GLint light_products_valid;
+#endif
+#if TGL_FEATURE_FIXED_POINT == 1
+	/* scene color and diffuse alpha of the front material */
+	V4x scene_color_x;
+	GLint shininess_x;
+#endif
 
 	/* materials */
 	GLint color_material_enabled;
@@ -238,6 +373,7 @@ typedef struct GLContext {
 
 	GLint matrix_stack_depth_max[3];
 
+	/* with TGL_FEATURE_AFFINE_MATRICES, the TGL_MATRIX_DIRTY_* bits of what must be recomputed */
 	GLint matrix_model_projection_updated;
 	GLint matrix_model_projection_no_w_transform;
 	GLint apply_texture_matrix;
@@ -298,6 +434,10 @@ typedef struct GLContext {
 	GLint texcoord_array_size;
 	GLint texcoord_array_stride;
 	GLint client_states;
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+	GLfloat array_bounds[6];
+	GLint array_bounds_enabled;
+#endif
 
 	/* opengl 1.1 polygon offset */
 	GLfloat offset_factor;
@@ -320,6 +460,7 @@ typedef struct GLContext {
 	GLint rasterpos_zz;
 	GLfloat pzoomx, pzoomy;
 	GLVertex rastervertex;
+	GLfloat rasterpos_distance;
 	/* text */
 	GLTEXTSIZE textsize;
 	/* buffers */
@@ -335,11 +476,20 @@ typedef struct GLContext {
 } GLContext;
 
 extern GLContext gl_ctx;
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+extern TGL_THREAD_LOCAL GLContext* gl_current_ctx;
+static GLContext* gl_get_context(void) { return gl_current_ctx ? gl_current_ctx : &gl_ctx; }
+#else
 static GLContext* gl_get_context(void) { return &gl_ctx; }
+#endif
 
 extern void (*op_table_func[])(GLParam*);
 extern GLint op_table_size[];
 extern void gl_compile_op(GLParam* p);
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 1
+/* vertex.c */
+GLint gl_vertex_batch_op(GLParam* p);
+#endif
 static void gl_add_op(GLParam* p) {
 	GLContext* c = gl_get_context();
 #if TGL_FEATURE_ERROR_CHECK == 1
@@ -347,6 +497,10 @@ static void gl_add_op(GLParam* p) {
 #endif
 	GLint op;
 	op = p[0].op;
+#if TGL_FEATURE_IMMEDIATE_BATCHING == 1
+	if (c->vertex_batching && gl_vertex_batch_op(p))
+		return;
+#endif
 	if (c->exec_flag) {
 		op_table_func[op](p);
 #if TGL_FEATURE_ERROR_CHECK == 1
@@ -417,32 +571,82 @@ void gl_draw_triangle_line(GLVertex* p0, GLVertex* p1, GLVertex* p2);
 void gl_draw_triangle_fill(GLVertex* p0, GLVertex* p1, GLVertex* p2);	
 void gl_draw_triangle_select(GLVertex* p0, GLVertex* p1, GLVertex* p2); 
 void gl_draw_triangle_feedback(GLVertex* p0, GLVertex* p1, GLVertex* p2);
+#if TGL_FEATURE_FRUSTUM_CULLING == 1
+GLint gl_box_culled(const GLfloat* box);
+#endif
+/* list.c */
+#if TGL_FEATURE_LIST_COMPILER == 1
+void gl_free_list_batches(GLList* l);
+#endif
+
+/* vertex.c */
+GLint gl_vertex_compute(GLVertex* v, GLParam* p);
+void gl_vertex_cached(const GLVertex* v);
+#if TGL_FEATURE_BATCHED_ARRAYS == 1 || TGL_FEATURE_LIST_COMPILER == 1 || TGL_FEATURE_IMMEDIATE_BATCHING == 1
+void gl_draw_arrays_batch(GLint first, GLint count);
+void gl_draw_vertex_batch(GLfloat* data, GLint count, GLint stride, GLint states, GLint color, GLint normal, GLint texcoord);
+#endif
+
 /* matrix.c */
 void gl_print_matrix(const GLfloat* m);
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+#define TGL_MATRIX_RIGID 0
+#define TGL_MATRIX_AFFINE 1
+#define TGL_MATRIX_GENERAL 2
+#define TGL_MATRIX_DIRTY_MVP 1
+#define TGL_MATRIX_DIRTY_NORMAL 2
+#define TGL_MATRIX_DIRTY_TEXTURE 4
+#define TGL_MATRIX_DIRTY_ALL 7
+/* kind of the top of stack n */
+#define gl_matrix_kind(c, n) ((c)->matrix_stack_kind[n][(c)->matrix_stack_ptr[n] - (c)->matrix_stack[n]])
+void gl_compute_model_projection(void);
+void gl_compute_normal_matrix(void);
+#endif
+#if TGL_FEATURE_FIXED_POINT == 1
+/* which fixed-point matrices glBegin has to convert again */
+#define TGL_MATRIX_FIXED_LIT 1
+#define TGL_MATRIX_FIXED_UNLIT 2
+#define TGL_MATRIX_FIXED_ALL 3
+#endif
 /*
 void glopLoadIdentity(GLParam *p);
 void glopTranslate(GLParam *p);*/
 
 /* light.c */
 void gl_enable_disable_light(GLint light, GLint v);
-void gl_shade_vertex(GLVertex* v);
+void gl_shade_vertex(GLVertex* v, GLVertexEye* e);
+#if TGL_FEATURE_FIXED_POINT == 1
+void gl_shade_vertex_fixed(V4x* color, GLVertexEyeX* e);
+#endif
+#if TGL_FEATURE_BATCHED_LIGHTING == 1
+void gl_shade_vertices(GLint nb, const GLfloat* ex, const GLfloat* ey, const GLfloat* ez, const GLfloat* nx, const GLfloat* ny,
+					   const GLfloat* nz, GLfloat (*mat)[TGL_VERTEX_BATCH_SIZE], GLfloat (*col)[TGL_VERTEX_BATCH_SIZE]);
+#endif
 
 void glInitTextures();
 void glEndTextures();
 GLTexture* alloc_texture(GLint h);
+void gl_free_texture_images(GLTexture* t);
 
 /* image_util.c */
 void gl_convertRGB_to_5R6G5B(GLushort* pixmap, GLubyte* rgb, GLint xsize, GLint ysize);
 void gl_convertRGB_to_8A8R8G8B(GLuint* pixmap, GLubyte* rgb, GLint xsize, GLint ysize);
 void gl_resizeImage(GLubyte* dest, GLint xsize_dest, GLint ysize_dest, GLubyte* src, GLint xsize_src, GLint ysize_src);
 void gl_resizeImageNoInterpolate(GLubyte* dest, GLint xsize_dest, GLint ysize_dest, GLubyte* src, GLint xsize_src, GLint ysize_src);
+void gl_halveImage(PIXEL* dest, const PIXEL* src, GLint xsize_src, GLint ysize_src, GLint x0, GLint y0, GLint x1, GLint y1);
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+void gl_convertRGB_to_DXT1(GLubyte* blocks, GLubyte* rgb, GLint xsize, GLint ysize);
+#endif
+#if TGL_FEATURE_TILED_TEXTURES == 1
+void gl_tileImage(PIXEL* dest, const PIXEL* src, GLint xsize_log2, GLint ysize_log2, GLint untile);
+#endif
 
 
 
 void gl_fatal_error(char* format, ...);
 
 /* specular buffer "api" */
-GLSpecBuf* specbuf_get_buffer(const GLint shininess_i, const GLfloat shininess);
+GLSpecBuf* specbuf_get_buffer(GLContext* c, const GLint shininess_i, const GLfloat shininess);
 
 
 
@@ -468,6 +672,14 @@ static void gl_eval_viewport() {
 	v->scale.X = (v->xsize - 0.5) / 2.0;
 	v->scale.Y = -(v->ysize - 0.5) / 2.0;
 	v->scale.Z = -((zsize - 0.5) / 2.0);
+#if TGL_FEATURE_FIXED_POINT == 1
+	v->scale_x[0] = gl_fx_from_float(v->scale.X);
+	v->scale_x[1] = gl_fx_from_float(v->scale.Y);
+	v->scale_x[2] = (GLint)v->scale.Z;
+	v->trans_x[0] = gl_fx_from_float(v->trans.X);
+	v->trans_x[1] = gl_fx_from_float(v->trans.Y);
+	v->trans_x[2] = (GLint)v->trans.Z;
+#endif
 }
 
 #endif /* _tgl_zgl_h_ */
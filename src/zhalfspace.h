@@ -0,0 +1,372 @@
+/*
+ * Half-space (edge function) triangle rasterizer, used instead of ztriangle.h when
+ * TGL_FEATURE_HALFSPACE_RASTER is enabled. Same interface: INTERP_Z, INTERP_RGB, INTERP_STZ,
+ * DRAW_INIT() and PUT_PIXEL(_a). DRAW_LINE is ignored, perspective correct spans are done here.
+
+ The screen is walked in aligned blocks of 8x8 pixels.
+ 1) Blocks outside of any edge are skipped after testing their corners.
+ 2) Blocks completely inside of the triangle are filled without any edge test.
+ 3) For the remaining blocks, the edge functions of a whole block row are evaluated at once
+   (one SIMD lane per pixel). The triangle is convex, so the covered pixels form a single span.
+ All edge arithmetic is exact integer math and follows the top-left fill rule, so neighbouring
+ triangles never draw a pixel twice.
+ */
+
+/* the fully covered rows are unrolled for this size, which is also the size of the hierarchical Z tiles */
+#define HS_BLOCK_SIZE 8
+#if TGL_FEATURE_HIERARCHICAL_Z == 1 && defined(INTERP_Z)
+#define HS_HZ
+#endif
+/*
+ the values at the block corners are stepped in 64 bits, away from the triangle they don't fit in a GLint.
+ The edge functions are clamped per block: inside of one they change by much less than 1 << 30, so their signs are
+ kept. Z and the colors are narrowed where a span starts, which is inside of the triangle.
+ */
+#define HS_NARROW(v) ((v) > (1 << 30) ? (1 << 30) : (v) < -(1 << 30) ? -(1 << 30) : (GLint)(v))
+
+{
+	GLfloat fdx1, fdx2, fdy1, fdy2, fz;
+	PIXEL* pp1;
+	GLint the_y;
+	GLint xmin, xmax, ymin, ymax, bx, by;
+	/* edge functions w = ex * x + ey * y + c, the pixel is inside when all three are >= 0 */
+	GLint ex0, ey0, ex1, ey1, ex2, ey2;
+	long long w0blk, w1blk, w2blk;
+	ZBufferPoint *v0, *v1, *v2;
+#ifdef INTERP_Z
+	GLint dzdx, dzdy;
+	long long zblk;
+#endif
+#ifdef HS_HZ
+	/* z plane in floats, so that it cannot overflow away from the triangle */
+	GLfloat hzz0, hzdx, hzdy, hzmargin;
+#endif
+#ifdef INTERP_RGB
+	GLint drdx, drdy, dgdx, dgdy, dbdx, dbdy;
+	long long rblk, gblk, bblk;
+#endif
+#ifdef INTERP_STZ
+	GLfloat dszdx, dszdy;
+	GLfloat dtzdx, dtzdy;
+	GLfloat fdzdx, fndzdx, ndszdx, ndtzdx;
+#endif
+
+	/* sorted like in ztriangle.h, DRAW_INIT may use p2 */
+	if (p1->y < p0->y) {
+		ZBufferPoint* t = p0;
+		p0 = p1;
+		p1 = t;
+	}
+	if (p2->y < p0->y) {
+		ZBufferPoint* t = p2;
+		p2 = p1;
+		p1 = p0;
+		p0 = t;
+	} else if (p2->y < p1->y) {
+		ZBufferPoint* t = p1;
+		p1 = p2;
+		p2 = t;
+	}
+
+	fdx1 = p1->x - p0->x;
+	fdy1 = p1->y - p0->y;
+	fdx2 = p2->x - p0->x;
+	fdy2 = p2->y - p0->y;
+	fz = fdx1 * fdy2 - fdx2 * fdy1;
+	/* zero area, no pixel center can be strictly inside */
+	if (fz == 0)
+		return;
+	fz = 1.0 / fz;
+	fdx1 *= fz;
+	fdy1 *= fz;
+	fdx2 *= fz;
+	fdy2 *= fz;
+
+	{
+		GLfloat d1, d2;
+#ifdef INTERP_Z
+		d1 = p1->z - p0->z;
+		d2 = p2->z - p0->z;
+		dzdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+		dzdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+#endif
+#ifdef INTERP_RGB
+		d1 = p1->r - p0->r;
+		d2 = p2->r - p0->r;
+		drdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+		drdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+		d1 = p1->g - p0->g;
+		d2 = p2->g - p0->g;
+		dgdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+		dgdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+		d1 = p1->b - p0->b;
+		d2 = p2->b - p0->b;
+		dbdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+		dbdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+#endif
+#ifdef INTERP_STZ
+		p0->sz = (GLfloat)p0->s * p0->z;
+		p0->tz = (GLfloat)p0->t * p0->z;
+		p1->sz = (GLfloat)p1->s * p1->z;
+		p1->tz = (GLfloat)p1->t * p1->z;
+		p2->sz = (GLfloat)p2->s * p2->z;
+		p2->tz = (GLfloat)p2->t * p2->z;
+		d1 = p1->sz - p0->sz;
+		d2 = p2->sz - p0->sz;
+		dszdx = (fdy2 * d1 - fdy1 * d2);
+		dszdy = (fdx1 * d2 - fdx2 * d1);
+		d1 = p1->tz - p0->tz;
+		d2 = p2->tz - p0->tz;
+		dtzdx = (fdy2 * d1 - fdy1 * d2);
+		dtzdy = (fdx1 * d2 - fdx2 * d1);
+#endif
+	}
+
+	/* orient the edges so that the inside is where all the edge functions are positive */
+	v0 = p0;
+	if (fz > 0) {
+		v1 = p1;
+		v2 = p2;
+	} else {
+		v1 = p2;
+		v2 = p1;
+	}
+	ex0 = v0->y - v1->y;
+	ey0 = v1->x - v0->x;
+	ex1 = v1->y - v2->y;
+	ey1 = v2->x - v1->x;
+	ex2 = v2->y - v0->y;
+	ey2 = v0->x - v2->x;
+
+	/* bounding box, clipped */
+	xmin = xmax = p0->x;
+	if (p1->x < xmin) xmin = p1->x;
+	if (p1->x > xmax) xmax = p1->x;
+	if (p2->x < xmin) xmin = p2->x;
+	if (p2->x > xmax) xmax = p2->x;
+	ymin = p0->y;
+	ymax = p2->y;
+	if (xmin < zb->clip_xmin) xmin = zb->clip_xmin;
+	if (ymin < zb->clip_ymin) ymin = zb->clip_ymin;
+	if (xmax >= zb->clip_xmax) xmax = zb->clip_xmax - 1;
+	if (ymax >= zb->clip_ymax) ymax = zb->clip_ymax - 1;
+	if (xmin > xmax || ymin > ymax)
+		return;
+#ifdef HS_HZ
+	if (zb->depth_test && ZB_hzHidden(zb, p0, p1, p2))
+		return;
+	hzdx = dzdx;
+	hzdy = dzdy;
+	hzz0 = p0->z;
+	/* from the top left corner of a block to its largest z, plus one z unit for rounding */
+	hzmargin = (hzdx > 0 ? hzdx * (HS_BLOCK_SIZE - 1) : 0) + (hzdy > 0 ? hzdy * (HS_BLOCK_SIZE - 1) : 0) + (1 << ZB_POINT_Z_FRAC_BITS);
+	/* too steep for the rounding to stay under one z unit, only test whole triangles */
+	if (hzdx > (1 << 24) || hzdx < -(1 << 24) || hzdy > (1 << 24) || hzdy < -(1 << 24))
+		hzmargin = 1e30;
+#endif
+
+	DRAW_INIT();
+#ifdef INTERP_STZ
+	/* only needed by the scanline rasterizer */
+	(void)fndzdx;
+	(void)ndszdx;
+	(void)ndtzdx;
+#endif
+
+	/* values at the corner of the first block. Pixels on a right or bottom edge are not drawn (top-left rule). */
+	bx = xmin & ~(HS_BLOCK_SIZE - 1);
+	by = ymin & ~(HS_BLOCK_SIZE - 1);
+	w0blk = (long long)ex0 * (bx - v0->x) + (long long)ey0 * (by - v0->y) - ((ex0 > 0 || (ex0 == 0 && ey0 < 0)) ? 0 : 1);
+	w1blk = (long long)ex1 * (bx - v1->x) + (long long)ey1 * (by - v1->y) - ((ex1 > 0 || (ex1 == 0 && ey1 < 0)) ? 0 : 1);
+	w2blk = (long long)ex2 * (bx - v2->x) + (long long)ey2 * (by - v2->y) - ((ex2 > 0 || (ex2 == 0 && ey2 < 0)) ? 0 : 1);
+#ifdef INTERP_Z
+	zblk = p0->z + (long long)dzdx * (bx - p0->x) + (long long)dzdy * (by - p0->y);
+#endif
+#ifdef INTERP_RGB
+	rblk = p0->r + (long long)drdx * (bx - p0->x) + (long long)drdy * (by - p0->y);
+	gblk = p0->g + (long long)dgdx * (bx - p0->x) + (long long)dgdy * (by - p0->y);
+	bblk = p0->b + (long long)dbdx * (bx - p0->x) + (long long)dbdy * (by - p0->y);
+#endif
+
+/* per span setup, the span starts at pixel _x of the block row */
+#if defined(INTERP_STZ) && TGL_FEATURE_LIT_TEXTURES == 1
+#define HS_LIT_SETUP(_x)                                                                                                                                       \
+	GLint r1 = HS_NARROW(rrow + drdx * (_x)), g1 = HS_NARROW(grow + dgdx * (_x)), b1 = HS_NARROW(brow + dbdx * (_x));                                          \
+	OR1OG1OB1DECL
+#else
+#define HS_LIT_SETUP(_x) /* or1, og1 and ob1 are constants */
+#endif
+#ifdef INTERP_STZ
+#define HS_SPAN_SETUP(_x)                                                                                                                                      \
+	register GLuint s, t;                                                                                                                                      \
+	register GLint dsdx, dtdx;                                                                                                                                 \
+	HS_LIT_SETUP(_x)                                                                                                                                           \
+	{                                                                                                                                                          \
+		GLfloat zinv = 1.0 / (GLfloat)z;                                                                                                                       \
+		GLfloat ss = (p0->sz + dszdx * (bx + (_x) - p0->x) + dszdy * (the_y - p0->y)) * zinv;                                                                  \
+		GLfloat tt = (p0->tz + dtzdx * (bx + (_x) - p0->x) + dtzdy * (the_y - p0->y)) * zinv;                                                                  \
+		s = (GLint)ss;                                                                                                                                         \
+		t = (GLint)tt;                                                                                                                                         \
+		dsdx = (GLint)((dszdx - ss * fdzdx) * zinv);                                                                                                           \
+		dtdx = (GLint)((dtzdx - tt * fdzdx) * zinv);                                                                                                           \
+		TEXTURE_SELECT_LEVEL(ss, tt, zinv)                                                                                                                     \
+	}
+#elif defined(INTERP_RGB)
+#define HS_SPAN_SETUP(_x)                                                                                                                                      \
+	register GLint or1 = HS_NARROW(rrow + drdx * (_x));                                                                                                        \
+	register GLint og1 = HS_NARROW(grow + dgdx * (_x));                                                                                                        \
+	register GLint ob1 = HS_NARROW(brow + dbdx * (_x));
+#else
+#define HS_SPAN_SETUP(_x) /* nothing to interpolate */
+#endif
+
+	for (; by <= ymax; by += HS_BLOCK_SIZE) {
+		long long w0l = w0blk, w1l = w1blk, w2l = w2blk;
+#ifdef INTERP_Z
+		long long zb1l = zblk;
+#endif
+#ifdef INTERP_RGB
+		long long rb1l = rblk, gb1l = gblk, bb1l = bblk;
+#endif
+		GLint row0 = (by < ymin) ? ymin - by : 0;
+		GLint row1 = (by + HS_BLOCK_SIZE - 1 > ymax) ? ymax - by : HS_BLOCK_SIZE - 1;
+		for (bx = xmin & ~(HS_BLOCK_SIZE - 1); bx <= xmax; bx += HS_BLOCK_SIZE) {
+			GLint lane0 = (bx < xmin) ? xmin - bx : 0;
+			GLint lane1 = (bx + HS_BLOCK_SIZE - 1 > xmax) ? xmax - bx : HS_BLOCK_SIZE - 1;
+			GLint full = (lane0 == 0 && lane1 == HS_BLOCK_SIZE - 1 && row0 == 0 && row1 == HS_BLOCK_SIZE - 1);
+			GLint w0 = HS_NARROW(w0l), w1 = HS_NARROW(w1l), w2 = HS_NARROW(w2l);
+			{
+				/* corner tests. The smallest/largest values of an edge function over the block are at opposite corners. */
+				const GLint bs = HS_BLOCK_SIZE - 1;
+				GLint lo0 = w0 + (ex0 < 0 ? ex0 * bs : 0) + (ey0 < 0 ? ey0 * bs : 0);
+				GLint lo1 = w1 + (ex1 < 0 ? ex1 * bs : 0) + (ey1 < 0 ? ey1 * bs : 0);
+				GLint lo2 = w2 + (ex2 < 0 ? ex2 * bs : 0) + (ey2 < 0 ? ey2 * bs : 0);
+				GLint hi0 = w0 + (ex0 > 0 ? ex0 * bs : 0) + (ey0 > 0 ? ey0 * bs : 0);
+				GLint hi1 = w1 + (ex1 > 0 ? ex1 * bs : 0) + (ey1 > 0 ? ey1 * bs : 0);
+				GLint hi2 = w2 + (ex2 > 0 ? ex2 * bs : 0) + (ey2 > 0 ? ey2 * bs : 0);
+				if ((hi0 | hi1 | hi2) < 0)
+					goto next_block;
+				full = full && ((lo0 | lo1 | lo2) >= 0);
+			}
+#ifdef HS_HZ
+			{
+				GLint hzi = (bx >> ZB_HZ_POW2) + (by >> ZB_HZ_POW2) * zb->hzxsize;
+				if (zb->depth_test &&
+					hzz0 + hzdx * (bx - p0->x) + hzdy * (by - p0->y) + hzmargin < (GLfloat)(ZB_hzTile(zb, bx >> ZB_HZ_POW2, by >> ZB_HZ_POW2) << ZB_POINT_Z_FRAC_BITS))
+					goto next_block;
+				if (zb->depth_write)
+					zb->hzdirty[hzi] = 1;
+			}
+#endif
+			ZB_resolveClear(zb, bx, by, bx + HS_BLOCK_SIZE - 1, by + HS_BLOCK_SIZE - 1);
+			{
+				GLint row;
+				GLint w0r = w0 + ey0 * row0, w1r = w1 + ey1 * row0, w2r = w2 + ey2 * row0;
+#ifdef INTERP_Z
+				long long z1 = zb1l + (long long)dzdy * row0;
+#endif
+#ifdef INTERP_RGB
+				long long rrow = rb1l + (long long)drdy * row0, grow = gb1l + (long long)dgdy * row0, brow = bb1l + (long long)dbdy * row0;
+#endif
+				the_y = by + row0;
+				pp1 = (PIXEL*)(zb->pbuf) + zb->xsize * the_y;
+				for (row = row0; row <= row1; row++) {
+					GLint x0 = lane0, n = lane1 - lane0;
+					if (!full) {
+						/* one lane per pixel of the block row */
+						GLint i, inside[HS_BLOCK_SIZE];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+						for (i = 0; i < HS_BLOCK_SIZE; i++)
+							inside[i] = ((w0r + ex0 * i) | (w1r + ex1 * i) | (w2r + ex2 * i)) >= 0;
+						while (x0 <= lane1 && !inside[x0])
+							x0++;
+						n = x0 - 1;
+						while (n < lane1 && inside[n + 1])
+							n++;
+						n -= x0;
+					}
+					if (n >= 0) {
+						register PIXEL* pp = pp1 + bx + x0;
+#ifdef INTERP_Z
+						register GLushort* pz = zb->zbuf + zb->xsize * the_y + bx + x0;
+						register GLuint z = HS_NARROW(z1 + (long long)dzdx * x0);
+#endif
+						HS_SPAN_SETUP(x0)
+#if TGL_FEATURE_SIMD_SPANS == 1 && defined(PUT_LANE)
+						if (LANES_OK) {
+							register GLint i;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+							for (i = 0; i <= n; i++)
+								PUT_LANE(i);
+						} else
+#endif
+						if (n == HS_BLOCK_SIZE - 1) {
+							PUT_PIXEL(0);
+							PUT_PIXEL(1);
+							PUT_PIXEL(2);
+							PUT_PIXEL(3);
+							PUT_PIXEL(4);
+							PUT_PIXEL(5);
+							PUT_PIXEL(6);
+							PUT_PIXEL(7);
+						} else {
+							while (n >= 0) {
+								PUT_PIXEL(0);
+#ifdef INTERP_Z
+								pz++;
+#endif
+								pp++;
+								n--;
+							}
+						}
+					}
+					w0r += ey0;
+					w1r += ey1;
+					w2r += ey2;
+#ifdef INTERP_Z
+					z1 += dzdy;
+#endif
+#ifdef INTERP_RGB
+					rrow += drdy;
+					grow += dgdy;
+					brow += dbdy;
+#endif
+					pp1 += zb->xsize;
+					the_y++;
+				}
+			}
+		next_block:
+			w0l += ex0 * HS_BLOCK_SIZE;
+			w1l += ex1 * HS_BLOCK_SIZE;
+			w2l += ex2 * HS_BLOCK_SIZE;
+#ifdef INTERP_Z
+			zb1l += (long long)dzdx * HS_BLOCK_SIZE;
+#endif
+#ifdef INTERP_RGB
+			rb1l += (long long)drdx * HS_BLOCK_SIZE;
+			gb1l += (long long)dgdx * HS_BLOCK_SIZE;
+			bb1l += (long long)dbdx * HS_BLOCK_SIZE;
+#endif
+		}
+		w0blk += ey0 * HS_BLOCK_SIZE;
+		w1blk += ey1 * HS_BLOCK_SIZE;
+		w2blk += ey2 * HS_BLOCK_SIZE;
+#ifdef INTERP_Z
+		zblk += (long long)dzdy * HS_BLOCK_SIZE;
+#endif
+#ifdef INTERP_RGB
+		rblk += (long long)drdy * HS_BLOCK_SIZE;
+		gblk += (long long)dgdy * HS_BLOCK_SIZE;
+		bblk += (long long)dbdy * HS_BLOCK_SIZE;
+#endif
+	}
+#undef HS_LIT_SETUP
+#undef HS_BLOCK_SIZE
+#undef HS_HZ
+#undef HS_NARROW
+#undef HS_SPAN_SETUP
+}
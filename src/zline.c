@@ -13,7 +13,11 @@ void ZB_plot(ZBuffer* zb, ZBufferPoint* p) {
 	GLubyte zbdt = zb->depth_test;
 	GLfloat zbps = zb->pointsize;
 	TGL_BLEND_VARS
+	ZB_flushTiles(zb);
 	zz = p->z >> ZB_POINT_Z_FRAC_BITS;
+	ZB_resolveClear(zb, p->x - (GLint)zbps, p->y - (GLint)zbps, p->x + (GLint)zbps, p->y + (GLint)zbps);
+	if (zbdw)
+		ZB_hzDirty(zb, p->x - (GLint)zbps, p->y - (GLint)zbps, p->x + (GLint)zbps, p->y + (GLint)zbps);
 	
 	if (zbps == 1) {
 		GLushort* pz;
@@ -99,6 +103,12 @@ static void ZB_line_interp(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2) {
 
 void ZB_line_z(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2) {
 	GLint color1, color2;
+	ZB_flushTiles(zb);
+	ZB_resolveClear(zb, p1->x < p2->x ? p1->x : p2->x, p1->y < p2->y ? p1->y : p2->y, p1->x > p2->x ? p1->x : p2->x,
+					p1->y > p2->y ? p1->y : p2->y);
+	if (zb->depth_write)
+		ZB_hzDirty(zb, p1->x < p2->x ? p1->x : p2->x, p1->y < p2->y ? p1->y : p2->y, p1->x > p2->x ? p1->x : p2->x,
+				   p1->y > p2->y ? p1->y : p2->y);
 	
 	color1 = RGB_TO_PIXEL(p1->r, p1->g, p1->b);
 	color2 = RGB_TO_PIXEL(p2->r, p2->g, p2->b);
@@ -113,6 +123,9 @@ void ZB_line_z(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2) {
 
 void ZB_line(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2) {
 	GLint color1, color2;
+	ZB_flushTiles(zb);
+	ZB_resolveClear(zb, p1->x < p2->x ? p1->x : p2->x, p1->y < p2->y ? p1->y : p2->y, p1->x > p2->x ? p1->x : p2->x,
+					p1->y > p2->y ? p1->y : p2->y);
 
 	color1 = RGB_TO_PIXEL(p1->r, p1->g, p1->b);
 	color2 = RGB_TO_PIXEL(p2->r, p2->g, p2->b);
@@ -52,42 +52,48 @@ GLint gl_M4_IsId(M4* a) {
 	*/
 }
 
+/* row i of c is a combination of the rows of b, one vector operation per term */
 void gl_M4_Mul(M4* c, M4* a, M4* b) {
-	GLint i, j, k;
-	GLfloat s;
+	GLint i, j;
+	for (i = 0; i < 4; i++) {
+		GLfloat a0 = a->m[i][0], a1 = a->m[i][1], a2 = a->m[i][2], a3 = a->m[i][3];
 #ifdef _OPENMP
 #pragma omp simd
 #endif
-	for (i = 0; i < 4; i++)
-		for (j = 0; j < 4; j++) {
-			s = 0.0;
-			for (k = 0; k < 4; k++)
-				s += a->m[i][k] * b->m[k][j];
-			c->m[i][j] = s;
-		}
+		for (j = 0; j < 4; j++)
+			c->m[i][j] = a0 * b->m[0][j] + a1 * b->m[1][j] + a2 * b->m[2][j] + a3 * b->m[3][j];
+	}
 }
 
 /* c=c*a */
 void gl_M4_MulLeft(M4* c, M4* b) {
-	GLint i, j, k;
-	GLfloat s;
-	M4 a;
+	GLint i, j;
+	for (i = 0; i < 4; i++) {
+		GLfloat a0 = c->m[i][0], a1 = c->m[i][1], a2 = c->m[i][2], a3 = c->m[i][3];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+		for (j = 0; j < 4; j++)
+			c->m[i][j] = a0 * b->m[0][j] + a1 * b->m[1][j] + a2 * b->m[2][j] + a3 * b->m[3][j];
+	}
+}
 
-	/*memcpy(&a, c, 16*sizeof(GLfloat));
-	 */
-	a = *c;
+/* c=c*b when b only has a 3x3 part, like a rotation: the last column of c doesn't change */
+void gl_M4_MulLeft3(M4* c, M4* b) {
+	GLint i, j;
+	for (i = 0; i < 4; i++) {
+		GLfloat a0 = c->m[i][0], a1 = c->m[i][1], a2 = c->m[i][2];
 #ifdef _OPENMP
 #pragma omp simd
 #endif
-	for (i = 0; i < 4; i++)
-		for (j = 0; j < 4; j++) {
-			s = 0.0;
-			for (k = 0; k < 4; k++)
-				s += a.m[i][k] * b->m[k][j];
-			c->m[i][j] = s;
-		}
+		for (j = 0; j < 3; j++)
+			c->m[i][j] = a0 * b->m[0][j] + a1 * b->m[1][j] + a2 * b->m[2][j];
+	}
 }
 
+/* last row 0 0 0 1 */
+GLint gl_M4_IsAffine(M4* a) { return a->m[3][0] == 0 && a->m[3][1] == 0 && a->m[3][2] == 0 && a->m[3][3] == 1; }
+
 void gl_M4_Move(M4* a, M4* b) { memcpy(a, b, sizeof(M4)); }
 
 void gl_MoveV3(V3* a, V3* b) { memcpy(a, b, sizeof(V3)); }
@@ -105,12 +111,13 @@ void gl_MulM3V3(V3* a, M4* b, V3* c) {
 }
 
 void gl_M4_MulV4(V4* a, M4* b, V4* c) {
-	{
-		a->X = b->m[0][0] * c->X + b->m[0][1] * c->Y + b->m[0][2] * c->Z + b->m[0][3] * c->W;
-		a->Y = b->m[1][0] * c->X + b->m[1][1] * c->Y + b->m[1][2] * c->Z + b->m[1][3] * c->W;
-		a->Z = b->m[2][0] * c->X + b->m[2][1] * c->Y + b->m[2][2] * c->Z + b->m[2][3] * c->W;
-		a->W = b->m[3][0] * c->X + b->m[3][1] * c->Y + b->m[3][2] * c->Z + b->m[3][3] * c->W;
-	}
+	GLint i;
+	GLfloat x = c->X, y = c->Y, z = c->Z, w = c->W;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+	for (i = 0; i < 4; i++)
+		a->v[i] = b->m[i][0] * x + b->m[i][1] * y + b->m[i][2] * z + b->m[i][3] * w;
 }
 
 /* transposition of a 4x4 matrix */
@@ -164,6 +171,45 @@ void gl_M4_InvOrtho(M4* a, M4 b) {
 	}
 }
 
+/* inversion of an affine matrix of type Y=M.X+P with the cofactors of M. Nonzero if it isn't affine or invertible */
+GLint gl_M4_InvAffine(M4* a, M4* b) {
+	GLint i, j;
+	GLfloat det, s;
+	if (!gl_M4_IsAffine(b))
+		return 1;
+	a->m[0][0] = b->m[1][1] * b->m[2][2] - b->m[1][2] * b->m[2][1];
+	a->m[0][1] = b->m[0][2] * b->m[2][1] - b->m[0][1] * b->m[2][2];
+	a->m[0][2] = b->m[0][1] * b->m[1][2] - b->m[0][2] * b->m[1][1];
+	a->m[1][0] = b->m[1][2] * b->m[2][0] - b->m[1][0] * b->m[2][2];
+	a->m[1][1] = b->m[0][0] * b->m[2][2] - b->m[0][2] * b->m[2][0];
+	a->m[1][2] = b->m[0][2] * b->m[1][0] - b->m[0][0] * b->m[1][2];
+	a->m[2][0] = b->m[1][0] * b->m[2][1] - b->m[1][1] * b->m[2][0];
+	a->m[2][1] = b->m[0][1] * b->m[2][0] - b->m[0][0] * b->m[2][1];
+	a->m[2][2] = b->m[0][0] * b->m[1][1] - b->m[0][1] * b->m[1][0];
+	det = b->m[0][0] * a->m[0][0] + b->m[0][1] * a->m[1][0] + b->m[0][2] * a->m[2][0];
+	if (det == 0)
+		return 1;
+	det = 1 / det;
+	for (i = 0; i < 3; i++) {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+		for (j = 0; j < 3; j++)
+			a->m[i][j] *= det;
+	}
+	for (i = 0; i < 3; i++) {
+		s = 0;
+		for (j = 0; j < 3; j++)
+			s -= a->m[i][j] * b->m[j][3];
+		a->m[i][3] = s;
+	}
+	a->m[3][0] = 0.0;
+	a->m[3][1] = 0.0;
+	a->m[3][2] = 0.0;
+	a->m[3][3] = 1.0;
+	return 0;
+}
+
 /* Inversion of a general nxn matrix.
    Note : m is destroyed */
 
@@ -309,3 +355,121 @@ V4 gl_V4_New(GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
 	a.W = w;
 	return a;
 }
+
+#if TGL_FEATURE_FIXED_POINT == 1
+/* rounded to nearest, saturated */
+GLint gl_fx_from_float(GLfloat f) {
+	GLuint i, m;
+	GLint e, r;
+	memcpy(&i, &f, 4);
+	/* the 24 bit mantissa is shifted left by e */
+	e = (GLint)((i >> 23) & 255) - 127 - 23 + TGL_FIXED_BITS;
+	if (e < -24)
+		return 0;
+	m = (i & 0x7fffff) | 0x800000;
+	if (e >= 8)
+		r = 0x7fffffff;
+	else if (e >= 0)
+		r = (GLint)(m << e);
+	else
+		r = (GLint)((m + (1u << (-e - 1))) >> -e);
+	return (i >> 31) ? -r : r;
+}
+
+/* truncated to 24 bits */
+GLfloat gl_fx_to_float(GLint x) {
+	GLuint a, i, s = 0;
+	GLint msb = 0;
+	GLfloat f;
+	if (x == 0)
+		return 0;
+	if (x < 0) {
+		s = 0x80000000;
+		a = -(GLuint)x;
+	} else
+		a = x;
+	if (a >> 16) msb += 16;
+	if (a >> (msb + 8)) msb += 8;
+	if (a >> (msb + 4)) msb += 4;
+	if (a >> (msb + 2)) msb += 2;
+	if (a >> (msb + 1)) msb += 1;
+	if (msb > 23)
+		a >>= msb - 23;
+	else
+		a <<= 23 - msb;
+	i = s | ((GLuint)(msb - TGL_FIXED_BITS + 127) << 23) | (a & 0x7fffff);
+	memcpy(&f, &i, 4);
+	return f;
+}
+
+void gl_M4x_From(M4x* a, M4* b) {
+	GLint i, j;
+	for (i = 0; i < 4; i++)
+		for (j = 0; j < 4; j++)
+			a->m[i][j] = gl_fx_from_float(b->m[i][j]);
+}
+
+/* a=b*c, the products are summed in 64 bits and rounded once */
+void gl_M4x_MulV4(V4x* a, M4x* b, V4x* c) {
+	GLint i;
+	for (i = 0; i < 4; i++)
+		a->v[i] = (GLint)(((long long)b->m[i][0] * c->v[0] + (long long)b->m[i][1] * c->v[1] + (long long)b->m[i][2] * c->v[2] +
+						   (long long)b->m[i][3] * c->v[3]) >>
+						  TGL_FIXED_BITS);
+}
+
+/* a=b*c with the upper 3x3 of b, for the normals */
+void gl_M4x_MulV3(V3x* a, M4x* b, V3x* c) {
+	GLint i;
+	for (i = 0; i < 3; i++)
+		a->v[i] = (GLint)(((long long)b->m[i][0] * c->v[0] + (long long)b->m[i][1] * c->v[1] + (long long)b->m[i][2] * c->v[2]) >> TGL_FIXED_BITS);
+}
+
+/* the sqrt of a Q32.32 is a Q16.16 */
+static GLuint gl_isqrt64(unsigned long long n) {
+	unsigned long long r = 0, b = 1ULL << 62;
+	while (b > n)
+		b >>= 2;
+	while (b) {
+		if (n >= r + b) {
+			n -= r + b;
+			r = (r >> 1) + b;
+		} else
+			r >>= 1;
+		b >>= 2;
+	}
+	return (GLuint)r;
+}
+
+GLint gl_fx_length(GLint x, GLint y, GLint z) {
+	return (GLint)gl_isqrt64((unsigned long long)((long long)x * x) + (unsigned long long)((long long)y * y) + (unsigned long long)((long long)z * z));
+}
+
+/* a/=n with a single division, for n at least as long as a */
+void gl_V3x_Div(V3x* a, GLint n) {
+	long long inv = (1LL << (32 + TGL_FIXED_BITS)) / n;
+	a->v[0] = (GLint)((a->v[0] * inv) >> 32);
+	a->v[1] = (GLint)((a->v[1] * inv) >> 32);
+	a->v[2] = (GLint)((a->v[2] * inv) >> 32);
+}
+
+GLint gl_V3x_Norm(V3x* a) {
+	GLint n = gl_fx_length(a->v[0], a->v[1], a->v[2]);
+	if (n == 0)
+		return 1;
+	gl_V3x_Div(a, n);
+	return 0;
+}
+
+/* x^n by squaring, x in [0,1] */
+GLint gl_fx_powi(GLint x, GLint n) {
+	GLint r = TGL_FIXED_ONE;
+	while (n > 0) {
+		if (n & 1)
+			r = gl_fx_mul(r, x);
+		x = gl_fx_mul(x, x);
+		n >>= 1;
+	}
+	return r;
+}
+#endif
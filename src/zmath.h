@@ -32,6 +32,36 @@ typedef struct {
 	TGL_ALIGN GLfloat v[4];
 } V4;
 
+#if TGL_FEATURE_FIXED_POINT == 1
+/* Q16.16, see TGL_FEATURE_FIXED_POINT */
+#define TGL_FIXED_BITS 16
+#define TGL_FIXED_ONE (1 << TGL_FIXED_BITS)
+#define gl_fx_mul(a, b) ((GLint)(((long long)(a) * (b)) >> TGL_FIXED_BITS))
+
+typedef struct {
+	GLint m[4][4];
+} M4x;
+
+typedef struct {
+	GLint v[3];
+} V3x;
+
+typedef struct {
+	GLint v[4];
+} V4x;
+
+/* bit manipulations only, no float arithmetic */
+GLint gl_fx_from_float(GLfloat f);
+GLfloat gl_fx_to_float(GLint x);
+void gl_M4x_From(M4x* a, M4* b);
+void gl_M4x_MulV4(V4x* a, M4x* b, V4x* c);
+void gl_M4x_MulV3(V3x* a, M4x* b, V3x* c);
+void gl_V3x_Div(V3x* a, GLint n);
+GLint gl_V3x_Norm(V3x* a);
+GLint gl_fx_length(GLint x, GLint y, GLint z);
+GLint gl_fx_powi(GLint x, GLint n);
+#endif
+
 void gl_M4_Id(M4* a);
 GLint gl_M4_IsId(M4* a);
 void gl_M4_Move(M4* a, M4* b);
@@ -41,9 +71,12 @@ void gl_MulM3V3(V3* a, M4* b, V3* c);
 
 void gl_M4_MulV4(V4* a, M4* b, V4* c);
 void gl_M4_InvOrtho(M4* a, M4 b);
+GLint gl_M4_InvAffine(M4* a, M4* b);
+GLint gl_M4_IsAffine(M4* a);
 void gl_M4_Inv(M4* a, M4* b);
 void gl_M4_Mul(M4* c, M4* a, M4* b);
 void gl_M4_MulLeft(M4* c, M4* a);
+void gl_M4_MulLeft3(M4* c, M4* b);
 void gl_M4_Transpose(M4* a, M4* b);
 void gl_M4_Rotate(M4* c, GLfloat t, GLint u);
 
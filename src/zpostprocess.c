@@ -5,6 +5,8 @@
 void glPostProcess(GLuint (*postprocess)(GLint x, GLint y, GLuint pixel, GLushort z)) {
 	GLint i, j;
 	GLContext* c = gl_get_context();
+	ZB_flushTiles(c->zb);
+	ZB_resolveClear(c->zb, 0, 0, c->zb->xsize - 1, c->zb->ysize - 1);
 #ifdef _OPENMP
 #pragma omp parallel for collapse(2)
 #endif
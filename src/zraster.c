@@ -3,28 +3,31 @@
 #include "msghandling.h"
 #include "zgl.h"
 
-static void gl_vertex_transform_raster(GLVertex* v) {
+static void gl_vertex_transform_raster(GLVertex* v, GLVertexEye* e) {
 	GLContext* c = gl_get_context();
 
 	{
 		/* no eye coordinates needed, no normal */
 		/* NOTE: W = 1 is assumed */
 		GLfloat* m = &c->matrix_model_projection.m[0][0];
+#if TGL_FEATURE_AFFINE_MATRICES == 1
+		gl_compute_model_projection();
+#endif
 
-		v->pc.X = (v->coord.X * m[0] + v->coord.Y * m[1] + v->coord.Z * m[2] + m[3]);
-		v->pc.Y = (v->coord.X * m[4] + v->coord.Y * m[5] + v->coord.Z * m[6] + m[7]);
-		v->pc.Z = (v->coord.X * m[8] + v->coord.Y * m[9] + v->coord.Z * m[10] + m[11]);
+		v->pc.X = (e->coord.X * m[0] + e->coord.Y * m[1] + e->coord.Z * m[2] + m[3]);
+		v->pc.Y = (e->coord.X * m[4] + e->coord.Y * m[5] + e->coord.Z * m[6] + m[7]);
+		v->pc.Z = (e->coord.X * m[8] + e->coord.Y * m[9] + e->coord.Z * m[10] + m[11]);
 
 		if (c->matrix_model_projection_no_w_transform) {
 			v->pc.W = m[15];
 		} else {
-			v->pc.W = (v->coord.X * m[12] + v->coord.Y * m[13] + v->coord.Z * m[14] + m[15]);
+			v->pc.W = (e->coord.X * m[12] + e->coord.Y * m[13] + e->coord.Z * m[14] + m[15]);
 		}
 		m = &c->matrix_stack_ptr[0]->m[0][0];
-		v->ec.X = (v->coord.X * m[0] + v->coord.Y * m[1] + v->coord.Z * m[2] + m[3]);
-		v->ec.Y = (v->coord.X * m[4] + v->coord.Y * m[5] + v->coord.Z * m[6] + m[7]);
-		v->ec.Z = (v->coord.X * m[8] + v->coord.Y * m[9] + v->coord.Z * m[10] + m[11]);
-		v->ec.W = (v->coord.X * m[12] + v->coord.Y * m[13] + v->coord.Z * m[14] + m[15]);
+		e->ec.X = (e->coord.X * m[0] + e->coord.Y * m[1] + e->coord.Z * m[2] + m[3]);
+		e->ec.Y = (e->coord.X * m[4] + e->coord.Y * m[5] + e->coord.Z * m[6] + m[7]);
+		e->ec.Z = (e->coord.X * m[8] + e->coord.Y * m[9] + e->coord.Z * m[10] + m[11]);
+		e->ec.W = (e->coord.X * m[12] + e->coord.Y * m[13] + e->coord.Z * m[14] + m[15]);
 	}
 
 	v->clip_code = gl_clipcode(v->pc.X, v->pc.Y, v->pc.Z, v->pc.W);
@@ -42,11 +45,12 @@ void glRasterPos4f(GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
 void glopRasterPos(GLParam* p) {
 	GLContext* c = gl_get_context();
 	GLVertex v;
-	v.coord.X = p[1].f;
-	v.coord.Y = p[2].f;
-	v.coord.Z = p[3].f;
-	v.coord.W = p[4].f;
-	gl_vertex_transform_raster(&v);
+	GLVertexEye e;
+	e.coord.X = p[1].f;
+	e.coord.Y = p[2].f;
+	e.coord.Z = p[3].f;
+	e.coord.W = p[4].f;
+	gl_vertex_transform_raster(&v, &e);
 	if (v.clip_code == 0) {
 		{
 			GLfloat winv = 1.0 / v.pc.W;
@@ -57,6 +61,7 @@ void glopRasterPos(GLParam* p) {
 		c->rasterpos.v[0] = v.zp.x;
 		c->rasterpos.v[1] = v.zp.y;
 		c->rastervertex = v;
+		c->rasterpos_distance = e.ec.Z;
 		/* c->rasterpos.v[2] = v.zp.z;*/
 		c->rasterpos_zz = v.zp.z >> ZB_POINT_Z_FRAC_BITS; 
 		c->rasterposvalid = 1;
@@ -128,6 +133,10 @@ void glopDrawPixels(GLParam* p) {
 #endif
 #endif
 	if (!c->rasterposvalid)return;
+	ZB_flushTiles(zb);
+	ZB_resolveClear(zb, 0, 0, tw - 1, th - 1);
+	if (zbdw)
+		ZB_hzDirty(zb, 0, 0, tw - 1, th - 1);
 	
 #if TGL_FEATURE_ALT_RENDERMODES == 1
 	if (c->render_mode == GL_SELECT) {
@@ -0,0 +1,234 @@
+/*
+ * Small triangle path, see TGL_FEATURE_SMALL_TRIANGLES. Included at the top of ztriangle.h, same interface:
+ * INTERP_Z, INTERP_RGB, INTERP_STZ, DRAW_INIT() and PUT_PIXEL(_a). DRAW_LINE is ignored.
+
+ Triangles whose bounding box is smaller than zb->small_triangle_size in both directions are handled here.
+ The pixel centers of the bounding box are tested with the edge functions of zhalfspace.h (exact integer
+ math, top-left rule) before anything else, so triangles that cover no pixel cost no gradient setup.
+ The covered spans are then filled one row of the bounding box at a time.
+ Larger triangles fall through to the half-space rasterizer. The spans are cut and set up like its spans, so both
+ draw the same pixels with the same colors, depths and texels.
+ */
+
+/* HS_BLOCK_SIZE of zhalfspace.h */
+#define SMALL_TRIANGLE_BLOCK_SIZE 8
+
+{
+	GLint xmin = p0->x, xmax = p0->x, ymin = p0->y, ymax = p0->y;
+	if (p1->x < xmin) xmin = p1->x;
+	if (p1->x > xmax) xmax = p1->x;
+	if (p2->x < xmin) xmin = p2->x;
+	if (p2->x > xmax) xmax = p2->x;
+	if (p1->y < ymin) ymin = p1->y;
+	if (p1->y > ymax) ymax = p1->y;
+	if (p2->y < ymin) ymin = p2->y;
+	if (p2->y > ymax) ymax = p2->y;
+	if (xmax - xmin < zb->small_triangle_size && ymax - ymin < zb->small_triangle_size) {
+		/* first and last covered pixel of each row of the bounding box */
+		GLint spanx0[TGL_SMALL_TRIANGLE_SIZE], spanx1[TGL_SMALL_TRIANGLE_SIZE];
+		GLint ex0, ey0, ex1, ey1, ex2, ey2;
+		GLint w0r, w1r, w2r, area, row, covered = 0;
+		GLint cxmin = xmin, cxmax = xmax;
+		PIXEL* pp1;
+		GLint the_y;
+		ZBufferPoint *v0, *v1, *v2;
+		GLfloat fdx1, fdx2, fdy1, fdy2, fz;
+#ifdef INTERP_Z
+		GLint dzdx, dzdy;
+#endif
+#ifdef INTERP_RGB
+		GLint drdx, drdy, dgdx, dgdy, dbdx, dbdy;
+#endif
+#ifdef INTERP_STZ
+		GLfloat dszdx, dszdy;
+		GLfloat dtzdx, dtzdy;
+		GLfloat fdzdx, fndzdx, ndszdx, ndtzdx;
+#endif
+
+		/* sorted like in ztriangle.h, DRAW_INIT may use p2 */
+		if (p1->y < p0->y) {
+			ZBufferPoint* t = p0;
+			p0 = p1;
+			p1 = t;
+		}
+		if (p2->y < p0->y) {
+			ZBufferPoint* t = p2;
+			p2 = p1;
+			p1 = p0;
+			p0 = t;
+		} else if (p2->y < p1->y) {
+			ZBufferPoint* t = p1;
+			p1 = p2;
+			p2 = t;
+		}
+
+		/* the bounding box is small, so this can't overflow */
+		area = (p1->x - p0->x) * (p2->y - p0->y) - (p2->x - p0->x) * (p1->y - p0->y);
+		/* the rows are clipped, the columns only when drawing so that a span always starts at the same place */
+		if (cxmin < zb->clip_xmin) cxmin = zb->clip_xmin;
+		if (ymin < zb->clip_ymin) ymin = zb->clip_ymin;
+		if (cxmax >= zb->clip_xmax) cxmax = zb->clip_xmax - 1;
+		if (ymax >= zb->clip_ymax) ymax = zb->clip_ymax - 1;
+		if (area == 0 || cxmin > cxmax || ymin > ymax) {
+			zb->small_rejected++;
+			return;
+		}
+
+		/* oriented so that the inside is where all the edge functions are positive */
+		v0 = p0;
+		if (area > 0) {
+			v1 = p1;
+			v2 = p2;
+		} else {
+			v1 = p2;
+			v2 = p1;
+		}
+		ex0 = v0->y - v1->y;
+		ey0 = v1->x - v0->x;
+		ex1 = v1->y - v2->y;
+		ey1 = v2->x - v1->x;
+		ex2 = v2->y - v0->y;
+		ey2 = v0->x - v2->x;
+		w0r = ex0 * (xmin - v0->x) + ey0 * (ymin - v0->y) - ((ex0 > 0 || (ex0 == 0 && ey0 < 0)) ? 0 : 1);
+		w1r = ex1 * (xmin - v1->x) + ey1 * (ymin - v1->y) - ((ex1 > 0 || (ex1 == 0 && ey1 < 0)) ? 0 : 1);
+		w2r = ex2 * (xmin - v2->x) + ey2 * (ymin - v2->y) - ((ex2 > 0 || (ex2 == 0 && ey2 < 0)) ? 0 : 1);
+
+		/* the triangle is convex, the covered pixels of a row form a single span */
+		for (row = 0; row <= ymax - ymin; row++) {
+			GLint x0 = 0, x1, w = xmax - xmin;
+			while (x0 <= w && ((w0r + ex0 * x0) | (w1r + ex1 * x0) | (w2r + ex2 * x0)) < 0)
+				x0++;
+			x1 = x0;
+			while (x1 < w && ((w0r + ex0 * (x1 + 1)) | (w1r + ex1 * (x1 + 1)) | (w2r + ex2 * (x1 + 1))) >= 0)
+				x1++;
+			spanx0[row] = x0;
+			spanx1[row] = x0 <= w ? x1 : x0 - 1;
+			covered |= x0 <= w && xmin + x0 <= cxmax && xmin + x1 >= cxmin;
+			w0r += ey0;
+			w1r += ey1;
+			w2r += ey2;
+		}
+		if (!covered) {
+			zb->small_rejected++;
+			return;
+		}
+		zb->small_triangles++;
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+		if (zb->depth_test && ZB_hzHidden(zb, p0, p1, p2))
+			return;
+#endif
+#if TGL_FEATURE_HIERARCHICAL_Z == 1 || TGL_FEATURE_LAZY_CLEAR == 1
+		ZB_resolveClear(zb, cxmin, ymin, cxmax, ymax);
+		if (zb->depth_write)
+			ZB_hzDirty(zb, cxmin, ymin, cxmax, ymax);
+#endif
+
+		fdx1 = p1->x - p0->x;
+		fdy1 = p1->y - p0->y;
+		fdx2 = p2->x - p0->x;
+		fdy2 = p2->y - p0->y;
+		fz = 1.0 / (GLfloat)area;
+		fdx1 *= fz;
+		fdy1 *= fz;
+		fdx2 *= fz;
+		fdy2 *= fz;
+		{
+			GLfloat d1, d2;
+#ifdef INTERP_Z
+			d1 = p1->z - p0->z;
+			d2 = p2->z - p0->z;
+			dzdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+			dzdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+#endif
+#ifdef INTERP_RGB
+			d1 = p1->r - p0->r;
+			d2 = p2->r - p0->r;
+			drdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+			drdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+			d1 = p1->g - p0->g;
+			d2 = p2->g - p0->g;
+			dgdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+			dgdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+			d1 = p1->b - p0->b;
+			d2 = p2->b - p0->b;
+			dbdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+			dbdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+#endif
+#ifdef INTERP_STZ
+			p0->sz = (GLfloat)p0->s * p0->z;
+			p0->tz = (GLfloat)p0->t * p0->z;
+			p1->sz = (GLfloat)p1->s * p1->z;
+			p1->tz = (GLfloat)p1->t * p1->z;
+			p2->sz = (GLfloat)p2->s * p2->z;
+			p2->tz = (GLfloat)p2->t * p2->z;
+			d1 = p1->sz - p0->sz;
+			d2 = p2->sz - p0->sz;
+			dszdx = (fdy2 * d1 - fdy1 * d2);
+			dszdy = (fdx1 * d2 - fdx2 * d1);
+			d1 = p1->tz - p0->tz;
+			d2 = p2->tz - p0->tz;
+			dtzdx = (fdy2 * d1 - fdy1 * d2);
+			dtzdy = (fdx1 * d2 - fdx2 * d1);
+#endif
+		}
+
+		DRAW_INIT();
+#ifdef INTERP_STZ
+		/* only needed by the scanline rasterizer */
+		(void)fndzdx;
+		(void)ndszdx;
+		(void)ndtzdx;
+#endif
+
+		the_y = ymin;
+		pp1 = (PIXEL*)(zb->pbuf) + zb->xsize * the_y;
+		for (row = 0; row <= ymax - ymin; row++, the_y++, pp1 += zb->xsize) {
+			GLint x = xmin + spanx0[row] < cxmin ? cxmin : xmin + spanx0[row];
+			GLint xend = xmin + spanx1[row] > cxmax ? cxmax : xmin + spanx1[row];
+			/* the pieces of the span in the 8x8 blocks of zhalfspace.h, set up like its spans for the same texels */
+			for (; x <= xend; x = (x | (SMALL_TRIANGLE_BLOCK_SIZE - 1)) + 1) {
+				GLint n = ((x | (SMALL_TRIANGLE_BLOCK_SIZE - 1)) > xend ? xend : (x | (SMALL_TRIANGLE_BLOCK_SIZE - 1))) - x;
+				register PIXEL* pp = pp1 + x;
+#ifdef INTERP_Z
+				register GLushort* pz = zb->zbuf + zb->xsize * the_y + x;
+				register GLuint z = p0->z + dzdx * (x - p0->x) + dzdy * (the_y - p0->y);
+#endif
+#ifdef INTERP_STZ
+				register GLuint s, t;
+				register GLint dsdx, dtdx;
+#if TGL_FEATURE_LIT_TEXTURES == 1
+				GLint r1 = p0->r + drdx * (x - p0->x) + drdy * (the_y - p0->y);
+				GLint g1 = p0->g + dgdx * (x - p0->x) + dgdy * (the_y - p0->y);
+				GLint b1 = p0->b + dbdx * (x - p0->x) + dbdy * (the_y - p0->y);
+				OR1OG1OB1DECL
+#endif
+				{
+					GLfloat zinv = 1.0 / (GLfloat)z;
+					GLfloat ss = (p0->sz + dszdx * (x - p0->x) + dszdy * (the_y - p0->y)) * zinv;
+					GLfloat tt = (p0->tz + dtzdx * (x - p0->x) + dtzdy * (the_y - p0->y)) * zinv;
+					s = (GLint)ss;
+					t = (GLint)tt;
+					dsdx = (GLint)((dszdx - ss * fdzdx) * zinv);
+					dtdx = (GLint)((dtzdx - tt * fdzdx) * zinv);
+					TEXTURE_SELECT_LEVEL(ss, tt, zinv)
+				}
+#elif defined(INTERP_RGB)
+				register GLint or1 = p0->r + drdx * (x - p0->x) + drdy * (the_y - p0->y);
+				register GLint og1 = p0->g + dgdx * (x - p0->x) + dgdy * (the_y - p0->y);
+				register GLint ob1 = p0->b + dbdx * (x - p0->x) + dbdy * (the_y - p0->y);
+#endif
+				while (n >= 0) {
+					PUT_PIXEL(0);
+#ifdef INTERP_Z
+					pz++;
+#endif
+					pp++;
+					n--;
+				}
+			}
+		}
+		return;
+	}
+}
+#undef SMALL_TRIANGLE_BLOCK_SIZE
@@ -44,6 +44,8 @@ void glopPlotPixel(GLParam* p) {
 	GLContext* c = gl_get_context();
 	GLint x = p[1].i;
 	PIXEL pix = p[2].ui;
+	ZB_flushTiles(c->zb);
+	ZB_resolveClear(c->zb, x % c->zb->xsize, x / c->zb->xsize, x % c->zb->xsize, x / c->zb->xsize);
 	c->zb->pbuf[x] = pix;
 	
 }
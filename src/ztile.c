@@ -0,0 +1,246 @@
+/*
+ * Sort-middle (tile binned) triangle rasterization.
+ *
+ * Filled triangles are not drawn right away. They are stored together with a snapshot of the
+ * raster state and binned into every screen tile their bounding box touches. ZB_flushTiles then
+ * rasterizes all the tiles in parallel, each one with the clip rectangle set to the tile.
+ * Within a tile the triangles are replayed in submission order and the scanline rasterizer
+ * produces exactly the same values whatever the clip rectangle is, so the output is identical
+ * to drawing everything serially.
+ */
+
+#include <string.h>
+
+#include "zbuffer.h"
+#include "msghandling.h"
+
+#if TGL_FEATURE_MULTITHREADED_TILED_RASTER == 1
+
+#define TILE_SIZE (1 << TGL_RASTER_TILE_POW2)
+
+typedef struct {
+	ZB_fillTriangleFunc fill;
+	GLint state; /* index into ZBTiles::states */
+	ZBufferPoint p[3];
+} ZBTileTriangle;
+
+typedef struct {
+	GLuint* tris; /* indices into ZBTiles::tris, in submission order */
+	GLint count, size;
+} ZBTileBin;
+
+struct ZBTiles {
+	GLint xtiles, ytiles;
+	ZBTileBin* bins;
+	ZBTileTriangle* tris;
+	GLint ntris, maxtris;
+	/* a new snapshot is only taken when the raster state changes */
+	ZBuffer* states;
+	GLint nstates, maxstates;
+};
+
+/* grow an array to hold at least one more element. The old array is left alone on failure. */
+static void* grow_array(void* p, GLint count, GLint* size, GLint elsize) {
+	GLint nsize = (*size) ? (*size) * 2 : 16;
+	void* np = gl_malloc(nsize * elsize);
+	if (np == NULL)
+		return NULL;
+	if (p != NULL) {
+		memcpy(np, p, count * elsize);
+		gl_free(p);
+	}
+	*size = nsize;
+	return np;
+}
+
+static struct ZBTiles* ZB_openTiles(ZBuffer* zb) {
+	struct ZBTiles* t = gl_zalloc(sizeof(struct ZBTiles));
+	if (t == NULL)
+		return NULL;
+	t->xtiles = (zb->xsize + TILE_SIZE - 1) >> TGL_RASTER_TILE_POW2;
+	t->ytiles = (zb->ysize + TILE_SIZE - 1) >> TGL_RASTER_TILE_POW2;
+	t->bins = gl_zalloc(t->xtiles * t->ytiles * sizeof(ZBTileBin));
+	if (t->bins == NULL) {
+		gl_free(t);
+		return NULL;
+	}
+	return t;
+}
+
+void ZB_closeTiles(ZBuffer* zb) {
+	struct ZBTiles* t = zb->tiles;
+	GLint i;
+	if (t == NULL)
+		return;
+	for (i = 0; i < t->xtiles * t->ytiles; i++)
+		if (t->bins[i].tris)
+			gl_free(t->bins[i].tris);
+	gl_free(t->bins);
+	if (t->tris)
+		gl_free(t->tris);
+	if (t->states)
+		gl_free(t->states);
+	gl_free(t);
+	zb->tiles = NULL;
+}
+
+void ZB_binTriangle(ZBuffer* zb, ZB_fillTriangleFunc fill, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+	struct ZBTiles* t = zb->tiles;
+	ZBTileTriangle* tri;
+	GLint xmin, xmax, ymin, ymax, tx, ty;
+
+	if (t != NULL && (t->xtiles != (zb->xsize + TILE_SIZE - 1) >> TGL_RASTER_TILE_POW2 ||
+					  t->ytiles != (zb->ysize + TILE_SIZE - 1) >> TGL_RASTER_TILE_POW2)) {
+		/* the buffer was resized */
+		ZB_flushTiles(zb);
+		ZB_closeTiles(zb);
+		t = NULL;
+	}
+	if (t == NULL) {
+		t = zb->tiles = ZB_openTiles(zb);
+		if (t == NULL)
+			goto draw_now;
+	}
+	if (t->ntris >= TGL_RASTER_TILE_MAX_TRIANGLES)
+		ZB_flushTiles(zb);
+
+	/* The scanline rasterizer never leaves the bounding box of the vertices. The extra pixel is just paranoia. */
+	xmin = xmax = p0->x;
+	ymin = ymax = p0->y;
+	if (p1->x < xmin) xmin = p1->x;
+	if (p1->x > xmax) xmax = p1->x;
+	if (p2->x < xmin) xmin = p2->x;
+	if (p2->x > xmax) xmax = p2->x;
+	if (p1->y < ymin) ymin = p1->y;
+	if (p1->y > ymax) ymax = p1->y;
+	if (p2->y < ymin) ymin = p2->y;
+	if (p2->y > ymax) ymax = p2->y;
+	xmin--;
+	ymin--;
+	xmax++;
+	ymax++;
+	if (xmin < zb->clip_xmin) xmin = zb->clip_xmin;
+	if (ymin < zb->clip_ymin) ymin = zb->clip_ymin;
+	if (xmax >= zb->clip_xmax) xmax = zb->clip_xmax - 1;
+	if (ymax >= zb->clip_ymax) ymax = zb->clip_ymax - 1;
+	if (xmin > xmax || ymin > ymax)
+		return;
+	xmin >>= TGL_RASTER_TILE_POW2;
+	ymin >>= TGL_RASTER_TILE_POW2;
+	xmax >>= TGL_RASTER_TILE_POW2;
+	ymax >>= TGL_RASTER_TILE_POW2;
+
+	/* make room everywhere first, so that a triangle is never only partially binned */
+	if (t->ntris == t->maxtris) {
+		void* np = grow_array(t->tris, t->ntris, &t->maxtris, sizeof(ZBTileTriangle));
+		if (np == NULL)
+			goto flush_and_draw_now;
+		t->tris = np;
+	}
+	if (t->nstates == t->maxstates) {
+		void* np = grow_array(t->states, t->nstates, &t->maxstates, sizeof(ZBuffer));
+		if (np == NULL)
+			goto flush_and_draw_now;
+		t->states = np;
+	}
+	for (ty = ymin; ty <= ymax; ty++)
+		for (tx = xmin; tx <= xmax; tx++) {
+			ZBTileBin* bin = &t->bins[tx + ty * t->xtiles];
+			if (bin->count == bin->size) {
+				void* np = grow_array(bin->tris, bin->count, &bin->size, sizeof(GLuint));
+				if (np == NULL)
+					goto flush_and_draw_now;
+				bin->tris = np;
+			}
+		}
+
+	if (t->nstates == 0 || memcmp(&t->states[t->nstates - 1], zb, sizeof(ZBuffer))) {
+		memcpy(&t->states[t->nstates], zb, sizeof(ZBuffer));
+		t->nstates++;
+	}
+	tri = &t->tris[t->ntris];
+	tri->fill = fill;
+	tri->state = t->nstates - 1;
+	tri->p[0] = *p0;
+	tri->p[1] = *p1;
+	tri->p[2] = *p2;
+	for (ty = ymin; ty <= ymax; ty++)
+		for (tx = xmin; tx <= xmax; tx++) {
+			ZBTileBin* bin = &t->bins[tx + ty * t->xtiles];
+			bin->tris[bin->count++] = t->ntris;
+		}
+	t->ntris++;
+	return;
+
+flush_and_draw_now:
+	tgl_warning("\nCould not bin a triangle, drawing it immediately.");
+	ZB_flushTiles(zb);
+draw_now:
+	fill(zb, p0, p1, p2);
+}
+
+#if TGL_FEATURE_SMALL_TRIANGLES == 1
+/* the tiles draw with copies of the state, their counters are added back to zb */
+static void ZB_addTileCounters(ZBuffer* zb, ZBuffer* tzb) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+	zb->small_triangles += tzb->small_triangles;
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+	zb->small_rejected += tzb->small_rejected;
+}
+#endif
+
+void ZB_flushTiles(ZBuffer* zb) {
+	struct ZBTiles* t = zb->tiles;
+	GLint i;
+	if (t == NULL || t->ntris == 0)
+		return;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (i = 0; i < t->xtiles * t->ytiles; i++) {
+		ZBTileBin* bin = &t->bins[i];
+		GLint x0 = (i % t->xtiles) << TGL_RASTER_TILE_POW2;
+		GLint y0 = (i / t->xtiles) << TGL_RASTER_TILE_POW2;
+		GLint j, state = -1;
+		ZBuffer tzb;
+		for (j = 0; j < bin->count; j++) {
+			ZBTileTriangle* tri = &t->tris[bin->tris[j]];
+			/* the fill functions write to the points */
+			ZBufferPoint q0 = tri->p[0], q1 = tri->p[1], q2 = tri->p[2];
+			if (tri->state != state) {
+#if TGL_FEATURE_SMALL_TRIANGLES == 1
+				if (state >= 0)
+					ZB_addTileCounters(zb, &tzb);
+#endif
+				state = tri->state;
+				tzb = t->states[state];
+#if TGL_FEATURE_SMALL_TRIANGLES == 1
+				tzb.small_triangles = 0;
+				tzb.small_rejected = 0;
+#endif
+				if (tzb.clip_xmin < x0)
+					tzb.clip_xmin = x0;
+				if (tzb.clip_ymin < y0)
+					tzb.clip_ymin = y0;
+				if (tzb.clip_xmax > x0 + TILE_SIZE)
+					tzb.clip_xmax = x0 + TILE_SIZE;
+				if (tzb.clip_ymax > y0 + TILE_SIZE)
+					tzb.clip_ymax = y0 + TILE_SIZE;
+			}
+			tri->fill(&tzb, &q0, &q1, &q2);
+		}
+#if TGL_FEATURE_SMALL_TRIANGLES == 1
+		if (state >= 0)
+			ZB_addTileCounters(zb, &tzb);
+#endif
+		bin->count = 0;
+	}
+	t->ntris = 0;
+	t->nstates = 0;
+}
+
+#endif
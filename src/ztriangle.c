@@ -2,13 +2,34 @@
 #include "msghandling.h"
 #include <stdlib.h>
 
-
-
-
-/* TODO: Switch from scanline rasterizer to easily parallelized cross product rasterizer.*/
-static GLfloat edgeFunction(GLfloat ax, GLfloat ay, GLfloat bx, GLfloat by, GLfloat cx, GLfloat cy) {
-	return (cx - ax) * (by - ay) - (cy - ay) * (bx - ax);
+/* The cross product rasterizer lives in zhalfspace.h, see TGL_FEATURE_HALFSPACE_RASTER */
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+/* 1 if the triangle is behind everything in its bounding box. The interpolated z can overshoot the vertices by a little, hence the +1. */
+static GLint ZB_hzHidden(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+	GLint xmin, xmax, ymin, ymax, zmax;
+	xmin = xmax = p0->x;
+	ymin = ymax = p0->y;
+	zmax = p0->z;
+	if (p1->x < xmin) xmin = p1->x;
+	if (p1->x > xmax) xmax = p1->x;
+	if (p2->x < xmin) xmin = p2->x;
+	if (p2->x > xmax) xmax = p2->x;
+	if (p1->y < ymin) ymin = p1->y;
+	if (p1->y > ymax) ymax = p1->y;
+	if (p2->y < ymin) ymin = p2->y;
+	if (p2->y > ymax) ymax = p2->y;
+	if (p1->z > zmax) zmax = p1->z;
+	if (p2->z > zmax) zmax = p2->z;
+	if (xmin < zb->clip_xmin) xmin = zb->clip_xmin;
+	if (ymin < zb->clip_ymin) ymin = zb->clip_ymin;
+	if (xmax >= zb->clip_xmax) xmax = zb->clip_xmax - 1;
+	if (ymax >= zb->clip_ymax) ymax = zb->clip_ymax - 1;
+	if (xmin > xmax || ymin > ymax)
+		return 1;
+	return ZB_hzReject(zb, xmin, ymin, xmax, ymax, (zmax >> ZB_POINT_Z_FRAC_BITS) + 1);
 }
+#endif
 
 #if TGL_FEATURE_RENDER_BITS == 32
 #elif TGL_FEATURE_RENDER_BITS == 16
@@ -44,6 +65,25 @@ static GLfloat edgeFunction(GLfloat ax, GLfloat ay, GLfloat bx, GLfloat by, GLfl
 #define ZCMP(z, zpix, _a, c) (((!zbdt) || (z >= zpix)) STIPTEST(_a) NODRAWTEST(c))
 #define ZCMPSIMP(z, zpix, _a, crabapple) (((!zbdt) || (z >= zpix)) STIPTEST(_a))
 
+/*
+PUT_LANE(_i) is PUT_PIXEL(_i) written as a function of the lane, with every interpolant
+computed from the span start and a select instead of a branch, so that a whole span can be
+written by a SIMD loop (TGL_FEATURE_SIMD_SPANS). PUT_PIXEL stays the reference.
+Functions with run time blending don't have one, their per-pixel switch doesn't vectorize.
+Lanes never stipple, LANES_OK tells when they can be used.
+*/
+#define ZCMPLANE(z, zpix, c) (((!zbdt) || (z >= zpix)) NODRAWTEST(c))
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+#define LANES_OK (!zbdostipple)
+#else
+#define LANES_OK 1
+#endif
+#ifdef _OPENMP
+#define TGL_SIMD_LOOP _Pragma("omp simd")
+#else
+#define TGL_SIMD_LOOP /* a comment */
+#endif
+
 void ZB_fillTriangleFlat(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
 	GLubyte zbdt = zb->depth_test;
 	GLubyte zbdw = zb->depth_write;
@@ -105,6 +145,15 @@ void ZB_fillTriangleFlatNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1,
 		z += dzdx;                                                                                                                                             \
 	}
 
+#define PUT_LANE(_i)                                                                                                                                           \
+	{                                                                                                                                                          \
+		register GLuint zz = (z + (_i) * dzdx) >> ZB_POINT_Z_FRAC_BITS;                                                                                        \
+		register GLint draw = ZCMPLANE(zz, pz[_i], 0);                                                                                                         \
+		pp[_i] = draw ? color : pp[_i];                                                                                                                        \
+		if (zbdw)                                                                                                                                              \
+			pz[_i] = draw ? zz : pz[_i];                                                                                                                       \
+	}
+
 #include "ztriangle.h"
 }
 
@@ -247,6 +296,17 @@ void ZB_fillTriangleSmoothNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p
 
 #endif
 /* End of 16 bit mode stuff*/
+
+#define PUT_LANE(_i)                                                                                                                                           \
+	{                                                                                                                                                          \
+		register GLuint zz = (z + (_i) * dzdx) >> ZB_POINT_Z_FRAC_BITS;                                                                                        \
+		register GLint draw = ZCMPLANE(zz, pz[_i], 0);                                                                                                         \
+		register GLint lr = or1 + (_i) * drdx, lg = og1 + (_i) * dgdx, lb = ob1 + (_i) * dbdx;                                                                 \
+		pp[_i] = draw ? RGB_TO_PIXEL(lr, lg, lb) : pp[_i];                                                                                                     \
+		if (zbdw)                                                                                                                                              \
+			pz[_i] = draw ? zz : pz[_i];                                                                                                                       \
+	}
+
 #include "ztriangle.h"
 } 
 
@@ -260,20 +320,212 @@ void ZB_fillTriangleSmoothNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p
 
 
 */
-void ZB_setTexture(ZBuffer* zb, PIXEL* texture) { zb->current_texture = texture; }
+static void ZB_textureLayout(ZBuffer* zb, ZBTexture* t, const PIXEL* texture, GLint xsize_log2, GLint ysize_log2) {
+	/* log2 of the bytes per texel */
+	GLint psz = PSZSH - 3;
+	const GLint sbits = ZB_POINT_S_FRAC_BITS + 1 + TGL_FEATURE_TEXTURE_POW2 - xsize_log2;
+	const GLint tbits = ZB_POINT_T_FRAC_BITS + 1 + TGL_FEATURE_TEXTURE_POW2 - ysize_log2;
+#if TGL_FEATURE_TILED_TEXTURES == 1
+	GLint tile = ZB_TEXTURE_TILE_LOG2;
+#elif TGL_FEATURE_TEXTURE_FORMATS == 1
+	GLint tile = 0;
+#endif
+	t->pixmap = texture;
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+	t->format = zb->texture_format;
+	t->palette = zb->texture_palette;
+	switch (t->format) {
+	case ZB_TEXTURE_565:
+		psz = 1;
+		tile = 0;
+		break;
+	case ZB_TEXTURE_INDEX8:
+		psz = 0;
+		tile = 0;
+		break;
+	case ZB_TEXTURE_DXT1: {
+		/* the texel in the 4x4 block, then the byte offset of the block (8 bytes, a row of them per 4 texel rows) */
+		const GLint bx = xsize_log2 > ZB_TEXTURE_TILE_LOG2 ? xsize_log2 - ZB_TEXTURE_TILE_LOG2 : 0;
+		t->s_tile_mask = ((1u << (xsize_log2 < ZB_TEXTURE_TILE_LOG2 ? xsize_log2 : ZB_TEXTURE_TILE_LOG2)) - 1) << sbits;
+		t->s_tile_shift = sbits;
+		t->t_tile_mask = ((1u << (ysize_log2 < ZB_TEXTURE_TILE_LOG2 ? ysize_log2 : ZB_TEXTURE_TILE_LOG2)) - 1) << tbits;
+		t->t_tile_shift = tbits - 2;
+		t->s_mask = (((1u << xsize_log2) - 1) << sbits) & ~t->s_tile_mask;
+		t->s_shift = sbits - 1;
+		t->t_mask = (((1u << ysize_log2) - 1) << tbits) & ~t->t_tile_mask;
+		t->t_shift = tbits - bx - 1;
+		return;
+	}
+	}
+#endif
+#if TGL_FEATURE_TILED_TEXTURES == 1 || TGL_FEATURE_TEXTURE_FORMATS == 1
+	{
+		/* column and row in the tile, then the tile column and the tile row. Without tiles, only the last two */
+		const GLint tw = xsize_log2 < tile ? xsize_log2 : tile;
+		const GLint th = ysize_log2 < tile ? ysize_log2 : tile;
+		t->s_tile_mask = ((1u << tw) - 1) << sbits;
+		t->s_tile_shift = sbits - psz;
+		t->t_tile_mask = ((1u << th) - 1) << tbits;
+		t->t_tile_shift = tbits - tw - psz;
+		t->s_mask = (((1u << xsize_log2) - 1) << sbits) & ~t->s_tile_mask;
+		t->s_shift = sbits - th - psz;
+		t->t_mask = (((1u << ysize_log2) - 1) << tbits) & ~t->t_tile_mask;
+		t->t_shift = tbits - xsize_log2 - psz;
+	}
+#else
+	/* the column goes to the bottom of the offset, the row above it */
+	t->s_mask = ((1u << xsize_log2) - 1) << sbits;
+	t->s_shift = sbits - psz;
+	t->t_mask = ((1u << ysize_log2) - 1) << tbits;
+	t->t_shift = tbits - xsize_log2 - psz;
+#endif
+}
+
+#if TGL_FEATURE_TEXTURE_FORMATS == 1
+void ZB_setTextureFormat(ZBuffer* zb, GLint format, const PIXEL* palette) {
+	zb->texture_format = format;
+	zb->texture_palette = palette;
+}
+
+#if TGL_FEATURE_RENDER_BITS == 32
+/* the top bits are repeated in the bottom ones, so that white stays white */
+#define ZB_565_TO_PIXEL(c)                                                                                                                                     \
+	((((c)&0xF800) << 8) | (((c)&0xE000) << 3) | (((c)&0x07E0) << 5) | (((c)&0x0600) >> 1) | (((c)&0x001F) << 3) | (((c)&0x001C) >> 2))
+#define ZB_RGB888_TO_PIXEL(r, g, b) (((r) << 16) | ((g) << 8) | (b))
+#elif TGL_FEATURE_RENDER_BITS == 16
+#define ZB_565_TO_PIXEL(c) (c)
+#define ZB_RGB888_TO_PIXEL(r, g, b) ((((r)&0xF8) << 8) | (((g)&0xFC) << 3) | ((b) >> 3))
+#endif
+
+PIXEL ZB_sampleTexture(const ZBTexture* texture, GLuint s, GLuint t) {
+	const GLubyte* p = (const GLubyte*)texture->pixmap;
+	switch (texture->format) {
+	case ZB_TEXTURE_565: {
+		GLuint c = *(const GLushort*)(p + ST_TO_TEXTURE_BYTE_OFFSET(*texture, s, t));
+		return ZB_565_TO_PIXEL(c);
+	}
+	case ZB_TEXTURE_INDEX8:
+		return texture->palette[p[ST_TO_TEXTURE_BYTE_OFFSET(*texture, s, t)]];
+	case ZB_TEXTURE_DXT1: {
+		const GLubyte* b = p + (((s & texture->s_mask) >> texture->s_shift) | ((t & texture->t_mask) >> texture->t_shift));
+		GLuint i = ((s & texture->s_tile_mask) >> texture->s_tile_shift) | ((t & texture->t_tile_mask) >> texture->t_tile_shift);
+		GLuint c0 = b[0] | (b[1] << 8), c1 = b[2] | (b[3] << 8);
+		GLuint code = (b[4 + (i >> 2)] >> ((i & 3) * 2)) & 3;
+		PIXEL p0, p1;
+		GLuint w0 = 4 - code, w1 = code - 1, d = 3;
+		if (code < 2)
+			return code ? ZB_565_TO_PIXEL(c1) : ZB_565_TO_PIXEL(c0);
+		/* 2/3 and 1/3 of the way, or half way and black if the colors are in the other order */
+		if (c0 <= c1) {
+			if (code == 3)
+				return 0;
+			w0 = w1 = 1;
+			d = 2;
+		}
+		p0 = ZB_565_TO_PIXEL(c0);
+		p1 = ZB_565_TO_PIXEL(c1);
+		return ZB_RGB888_TO_PIXEL((w0 * GET_RED(p0) + w1 * GET_RED(p1)) / d, (w0 * GET_GREEN(p0) + w1 * GET_GREEN(p1)) / d,
+								  (w0 * GET_BLUE(p0) + w1 * GET_BLUE(p1)) / d);
+	}
+	}
+	return *(const PIXEL*)(p + ST_TO_TEXTURE_BYTE_OFFSET(*texture, s, t));
+}
+#endif
+
+void ZB_setTexture(ZBuffer* zb, const PIXEL* texture, GLint xsize_log2, GLint ysize_log2) {
+	ZB_textureLayout(zb, &zb->current_texture, texture, xsize_log2, ysize_log2);
+#if TGL_FEATURE_MIPMAPPING == 1
+	zb->texture_levels[0] = zb->current_texture;
+	zb->texture_max_level = 0;
+	zb->texture_s_lod_shift = ZB_POINT_S_FRAC_BITS + 1 + TGL_FEATURE_TEXTURE_POW2 - xsize_log2 - 8;
+	zb->texture_t_lod_shift = ZB_POINT_T_FRAC_BITS + 1 + TGL_FEATURE_TEXTURE_POW2 - ysize_log2 - 8;
+#endif
+}
+
+#if TGL_FEATURE_MIPMAPPING == 1
+void ZB_setTextureLevel(ZBuffer* zb, GLint level, const PIXEL* texture, GLint xsize_log2, GLint ysize_log2) {
+	/* s and t don't depend on the size, the smaller masks just keep fewer of their top bits */
+	ZB_textureLayout(zb, &zb->texture_levels[level], texture, xsize_log2, ysize_log2);
+	zb->texture_max_level = level;
+}
+
+/* the level whose texels are closest to one pixel, from the derivatives of s and t along x and y */
+static GLint ZB_textureLevel(ZBuffer* zb, GLint dsdx, GLint dtdx, GLint dsdy, GLint dtdy) {
+	GLuint m = (GLuint)abs(dsdx) >> zb->texture_s_lod_shift;
+	GLuint d = (GLuint)abs(dsdy) >> zb->texture_s_lod_shift;
+	GLint level = 0;
+	if (d > m)
+		m = d;
+	d = (GLuint)abs(dtdx) >> zb->texture_t_lod_shift;
+	if (d > m)
+		m = d;
+	d = (GLuint)abs(dtdy) >> zb->texture_t_lod_shift;
+	if (d > m)
+		m = d;
+	/* rounds log2 of the step, 384 is 1.5 texels */
+	while (m >= 384 && level < zb->texture_max_level) {
+		m >>= 1;
+		level++;
+	}
+	return level;
+}
+
+/*
+ At each perspective correction of the textured fillers, ss and tt the corrected s and t, zinv 1/z.
+ dsdy and dtdy are found like dsdx and dtdx, from dszdy, dtzdy and dzdy.
+ */
+#define TEXTURE_SELECT_LEVEL(ss, tt, zinv)                                                                                                                     \
+	if (zb->texture_max_level)                                                                                                                                 \
+		texture = zb->texture_levels[ZB_textureLevel(zb, dsdx, dtdx, (GLint)((dszdy - (ss) * (GLfloat)dzdy) * (zinv)),                                           \
+													 (GLint)((dtzdy - (tt) * (GLfloat)dzdy) * (zinv)))];
+#else
+#define TEXTURE_SELECT_LEVEL(ss, tt, zinv) /* one level */
+#endif
 
 
 #if 1
 
+/* the NB_INTERP pixels between two perspective corrections */
+#define PUT_PIXEL8_SCALAR()                                                                                                                                    \
+	{                                                                                                                                                          \
+		PUT_PIXEL(0); /*the_x++;*/                                                                                                                             \
+		PUT_PIXEL(1); /*the_x++;*/                                                                                                                             \
+		PUT_PIXEL(2); /*the_x++;*/                                                                                                                             \
+		PUT_PIXEL(3); /*the_x++;*/                                                                                                                             \
+		PUT_PIXEL(4); /*the_x++;*/                                                                                                                             \
+		PUT_PIXEL(5); /*the_x++;*/                                                                                                                             \
+		PUT_PIXEL(6); /*the_x++;*/                                                                                                                             \
+		PUT_PIXEL(7); /*the_x-=7;*/                                                                                                                            \
+	}
+#define PUT_PIXEL8_LANES()                                                                                                                                     \
+	if (LANES_OK) {                                                                                                                                            \
+		register GLint i;                                                                                                                                      \
+		TGL_SIMD_LOOP                                                                                                                                          \
+		for (i = 0; i < NB_INTERP; i++)                                                                                                                        \
+			PUT_LANE(i);                                                                                                                                       \
+		z += NB_INTERP * dzdx;                                                                                                                                 \
+		OR1G1B1SKIP(NB_INTERP)                                                                                                                                 \
+	} else                                                                                                                                                     \
+		PUT_PIXEL8_SCALAR()
+
+#if TGL_FEATURE_LIT_TEXTURES == 1
+#define RGB_MIX_LANE(_i, tpix) RGB_MIX_FUNC((or1 + (_i) * drdx), (og1 + (_i) * dgdx), (ob1 + (_i) * dbdx), tpix)
+#else
+#define RGB_MIX_LANE(_i, tpix) (tpix)
+#endif
+
 #define DRAW_LINE_TRI_TEXTURED()                                                                                                                               \
 	{                                                                                                                                                          \
 		register GLushort* pz;                                                                                                                                 \
 		register PIXEL* pp;                                                                                                                                    \
 		register GLuint s, t, z;                                                                                                                               \
-		register GLint n;                                                                                                                                      \
+		register GLint n, skip;                                                                                                                                \
 		OR1OG1OB1DECL                                                                                                                                          \
 		GLfloat sz, tz, fzl, zinv;                                                                                                                             \
 		n = (x2 >> 16) - x1;                                                                                                                                   \
+		if ((x2 >> 16) >= zb->clip_xmax)                                                                                                                       \
+			n = zb->clip_xmax - 1 - x1;                                                                                                                        \
+		skip = zb->clip_xmin - x1;                                                                                                                             \
 		fzl = (GLfloat)z1;                                                                                                                                     \
 		zinv = 1.0 / fzl;                                                                                                                                      \
 		pp = (PIXEL*)((GLbyte*)pp1 + x1 * PSZB);                                                                                                               \
@@ -281,6 +533,50 @@ void ZB_setTexture(ZBuffer* zb, PIXEL* texture) { zb->current_texture = texture;
 		z = z1;                                                                                                                                                \
 		sz = sz1;                                                                                                                                              \
 		tz = tz1;                                                                                                                                              \
+		if (skip > 0) {                                                                                                                                        \
+			/*Step up to the clip rectangle exactly like the drawing loop below would.*/                                                                       \
+			while (skip >= NB_INTERP && n >= (NB_INTERP - 1)) {                                                                                                \
+				fzl += fndzdx;                                                                                                                                 \
+				zinv = 1.0 / fzl;                                                                                                                              \
+				z += NB_INTERP * dzdx;                                                                                                                         \
+				OR1G1B1SKIP(NB_INTERP)                                                                                                                         \
+				pz += NB_INTERP;                                                                                                                               \
+				pp += NB_INTERP;                                                                                                                               \
+				n -= NB_INTERP;                                                                                                                                \
+				skip -= NB_INTERP;                                                                                                                             \
+				sz += ndszdx;                                                                                                                                  \
+				tz += ndtzdx;                                                                                                                                  \
+			}                                                                                                                                                  \
+			if (skip > 0 && n >= (NB_INTERP - 1)) {                                                                                                            \
+				register GLint dsdx, dtdx;                                                                                                                     \
+				{                                                                                                                                              \
+					GLfloat ss, tt;                                                                                                                            \
+					ss = (sz * zinv);                                                                                                                          \
+					tt = (tz * zinv);                                                                                                                          \
+					s = (GLint)ss;                                                                                                                             \
+					t = (GLint)tt;                                                                                                                             \
+					dsdx = (GLint)((dszdx - ss * fdzdx) * zinv);                                                                                               \
+					dtdx = (GLint)((dtzdx - tt * fdzdx) * zinv);                                                                                               \
+					TEXTURE_SELECT_LEVEL(ss, tt, zinv)                                                                                                         \
+				}                                                                                                                                              \
+				fzl += fndzdx;                                                                                                                                 \
+				zinv = 1.0 / fzl;                                                                                                                              \
+				z += skip * dzdx;                                                                                                                              \
+				s += skip * dsdx;                                                                                                                              \
+				t += skip * dtdx;                                                                                                                              \
+				OR1G1B1SKIP(skip)                                                                                                                              \
+				pz += skip;                                                                                                                                    \
+				pp += skip;                                                                                                                                    \
+				n -= NB_INTERP;                                                                                                                                \
+				for (skip = NB_INTERP - skip; skip > 0; skip--) {                                                                                              \
+					PUT_PIXEL(0);                                                                                                                              \
+					pz += 1;                                                                                                                                   \
+					pp++;                                                                                                                                      \
+				}                                                                                                                                              \
+				sz += ndszdx;                                                                                                                                  \
+				tz += ndtzdx;                                                                                                                                  \
+			}                                                                                                                                                  \
+		}                                                                                                                                                      \
 		while (n >= (NB_INTERP - 1)) {                                                                                                                         \
 			register GLint dsdx, dtdx;                                                                                                                         \
 			{                                                                                                                                                  \
@@ -291,17 +587,11 @@ void ZB_setTexture(ZBuffer* zb, PIXEL* texture) { zb->current_texture = texture;
 				t = (GLint)tt;                                                                                                                                 \
 				dsdx = (GLint)((dszdx - ss * fdzdx) * zinv);                                                                                                   \
 				dtdx = (GLint)((dtzdx - tt * fdzdx) * zinv);                                                                                                   \
+				TEXTURE_SELECT_LEVEL(ss, tt, zinv)                                                                                                             \
 			}                                                                                                                                                  \
 			fzl += fndzdx;                                                                                                                                     \
 			zinv = 1.0 / fzl;                                                                                                                                  \
-			PUT_PIXEL(0); /*the_x++;*/                                                                                                                         \
-			PUT_PIXEL(1); /*the_x++;*/                                                                                                                         \
-			PUT_PIXEL(2); /*the_x++;*/                                                                                                                         \
-			PUT_PIXEL(3); /*the_x++;*/                                                                                                                         \
-			PUT_PIXEL(4); /*the_x++;*/                                                                                                                         \
-			PUT_PIXEL(5); /*the_x++;*/                                                                                                                         \
-			PUT_PIXEL(6); /*the_x++;*/                                                                                                                         \
-			PUT_PIXEL(7); /*the_x-=7;*/                                                                                                                        \
+			PUT_PIXEL8();                                                                                                                                      \
 			pz += NB_INTERP;                                                                                                                                   \
 			pp += NB_INTERP; /*the_x+=NB_INTERP * PSZB;*/                                                                                                      \
 			n -= NB_INTERP;                                                                                                                                    \
@@ -318,6 +608,16 @@ void ZB_setTexture(ZBuffer* zb, PIXEL* texture) { zb->current_texture = texture;
 				t = (GLint)tt;                                                                                                                                 \
 				dsdx = (GLint)((dszdx - ss * fdzdx) * zinv);                                                                                                   \
 				dtdx = (GLint)((dtzdx - tt * fdzdx) * zinv);                                                                                                   \
+				TEXTURE_SELECT_LEVEL(ss, tt, zinv)                                                                                                             \
+			}                                                                                                                                                  \
+			if (skip > 0) {                                                                                                                                    \
+				z += skip * dzdx;                                                                                                                              \
+				s += skip * dsdx;                                                                                                                              \
+				t += skip * dtdx;                                                                                                                              \
+				OR1G1B1SKIP(skip)                                                                                                                              \
+				pz += skip;                                                                                                                                    \
+				pp += skip;                                                                                                                                    \
+				n -= skip;                                                                                                                                     \
 			}                                                                                                                                                  \
 			while (n >= 0) {                                                                                                                                   \
 				PUT_PIXEL(0);                                                                                                                                  \
@@ -330,7 +630,7 @@ void ZB_setTexture(ZBuffer* zb, PIXEL* texture) { zb->current_texture = texture;
 	} 
 
 void ZB_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
-	PIXEL* texture;
+	ZBTexture texture;
 
 	GLubyte zbdw = zb->depth_write;
 	GLubyte zbdt = zb->depth_test;
@@ -361,9 +661,14 @@ void ZB_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoi
 	og1 += dgdx;                                                                                                                                               \
 	or1 += drdx;                                                                                                                                               \
 	ob1 += dbdx;
+#define OR1G1B1SKIP(_n)                                                                                                                                        \
+	og1 += (_n) * dgdx;                                                                                                                                        \
+	or1 += (_n) * drdx;                                                                                                                                        \
+	ob1 += (_n) * dbdx;
 #else
 #define OR1OG1OB1DECL /*A comment*/
 #define OR1G1B1INCR   /*Another comment*/
+#define OR1G1B1SKIP(_n) /*And another*/
 #define or1 COLOR_MULT_MASK
 #define og1 COLOR_MULT_MASK
 #define ob1 COLOR_MULT_MASK
@@ -404,6 +709,7 @@ void ZB_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoi
 		OR1G1B1INCR                                                                                                                                            \
 	}
 #endif
+#define PUT_PIXEL8() PUT_PIXEL8_SCALAR()
 #define DRAW_LINE()                                                                                                                                            \
 	{ DRAW_LINE_TRI_TEXTURED() }
 
@@ -411,7 +717,7 @@ void ZB_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoi
 }
 
 void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
-	PIXEL* texture;
+	ZBTexture texture;
 	
 	GLubyte zbdw = zb->depth_write;
 	GLubyte zbdt = zb->depth_test;
@@ -440,9 +746,14 @@ void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBu
 	og1 += dgdx;                                                                                                                                               \
 	or1 += drdx;                                                                                                                                               \
 	ob1 += dbdx;
+#define OR1G1B1SKIP(_n)                                                                                                                                        \
+	og1 += (_n) * dgdx;                                                                                                                                        \
+	or1 += (_n) * drdx;                                                                                                                                        \
+	ob1 += (_n) * dbdx;
 #else
 #define OR1OG1OB1DECL /*A comment*/
 #define OR1G1B1INCR   /*Another comment*/
+#define OR1G1B1SKIP(_n) /*And another*/
 #define or1 COLOR_MULT_MASK
 #define og1 COLOR_MULT_MASK
 #define ob1 COLOR_MULT_MASK
@@ -482,9 +793,103 @@ void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBu
 		OR1G1B1INCR                                                                                                                                            \
 	}
 #endif
+
+#define PUT_LANE(_i)                                                                                                                                           \
+	{                                                                                                                                                          \
+		register GLuint zz = (z + (_i) * dzdx) >> ZB_POINT_Z_FRAC_BITS;                                                                                        \
+		register GLuint ls = s + (_i) * dsdx, lt = t + (_i) * dtdx;                                                                                            \
+		PIXEL c = TEXTURE_SAMPLE(texture, ls, lt);                                                                                                             \
+		register GLint draw = ZCMPLANE(zz, pz[_i], c);                                                                                                         \
+		pp[_i] = draw ? RGB_MIX_LANE(_i, c) : pp[_i];                                                                                                          \
+		if (zbdw)                                                                                                                                              \
+			pz[_i] = draw ? zz : pz[_i];                                                                                                                       \
+	}
+#if TGL_FEATURE_SIMD_SPANS == 1
+#define PUT_PIXEL8() PUT_PIXEL8_LANES()
+#else
+#define PUT_PIXEL8() PUT_PIXEL8_SCALAR()
+#endif
 #define DRAW_LINE()                                                                                                                                            \
 	{ DRAW_LINE_TRI_TEXTURED() }
 #include "ztriangle.h"
 }
 
 #endif 
+
+#if TGL_FEATURE_SPECIALIZED_KERNELS == 1
+
+/* The kernels define these again */
+#undef NB_INTERP
+#undef OR1OG1OB1DECL
+#undef OR1G1B1INCR
+#undef OR1G1B1SKIP
+#undef or1
+#undef og1
+#undef ob1
+
+/* The kernels never stipple */
+#undef LANES_OK
+#define LANES_OK 1
+
+#define TGL_KERNEL_NAME(b, s) TGL_KERNEL_NAME_(b, s)
+#define TGL_KERNEL_NAME_(b, s) ZB_fillTriangleKernel##b##_##s
+
+/* Blend mode 0 is no blending, 1 is GL_FUNC_ADD(GL_ONE, GL_ONE), 2 is GL_FUNC_REVERSE_SUBTRACT(GL_ONE, GL_ONE) */
+#define TGL_KERNEL_BLEND 0
+#include "ztrikernels.h"
+#if TGL_FEATURE_BLEND == 1
+#define TGL_KERNEL_BLEND 1
+#include "ztrikernels.h"
+#define TGL_KERNEL_BLEND 2
+#include "ztrikernels.h"
+#define ZB_NB_KERNEL_BLENDS 3
+#else
+#define ZB_NB_KERNEL_BLENDS 1
+#endif
+
+#define TGL_KERNEL_ROW(b)                                                                                                                                      \
+	{                                                                                                                                                          \
+		TGL_KERNEL_NAME(b, 0), TGL_KERNEL_NAME(b, 1), TGL_KERNEL_NAME(b, 2), TGL_KERNEL_NAME(b, 3), TGL_KERNEL_NAME(b, 4), TGL_KERNEL_NAME(b, 5),              \
+			TGL_KERNEL_NAME(b, 6), TGL_KERNEL_NAME(b, 7), TGL_KERNEL_NAME(b, 8), TGL_KERNEL_NAME(b, 9), TGL_KERNEL_NAME(b, 10), TGL_KERNEL_NAME(b, 11)         \
+	}
+
+/* [blend mode][fill * 4 + depth_write * 2 + depth_test] */
+static const ZB_fillTriangleFunc ZB_kernels[ZB_NB_KERNEL_BLENDS][12] = {
+	TGL_KERNEL_ROW(0),
+#if TGL_FEATURE_BLEND == 1
+	TGL_KERNEL_ROW(1),
+	TGL_KERNEL_ROW(2),
+#endif
+};
+
+ZB_fillTriangleFunc ZB_selectTriangleFunc(ZBuffer* zb, GLint fill) {
+	GLint blend = 0;
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+	if (zb->dostipple)
+		return NULL;
+#endif
+#if TGL_FEATURE_BLEND == 1
+	if (zb->enable_blend) {
+		/* TGL_BLEND_FUNC treats unknown values as GL_FUNC_ADD and GL_ONE */
+		GLuint eq = zb->blendeq, sf = zb->sfactor, df = zb->dfactor;
+		if (eq != GL_FUNC_SUBTRACT && eq != GL_FUNC_REVERSE_SUBTRACT)
+			eq = GL_FUNC_ADD;
+		if (sf != GL_ONE_MINUS_SRC_COLOR && sf != GL_ZERO)
+			sf = GL_ONE;
+		if (df != GL_ONE_MINUS_DST_COLOR && df != GL_ZERO)
+			df = GL_ONE;
+		/* src + 0 or src - 0 is the same as not blending, except for flat triangles (see ztrikernel.h) */
+		if (sf == GL_ONE && df == GL_ZERO && eq != GL_FUNC_REVERSE_SUBTRACT && fill != ZB_FILL_FLAT)
+			blend = 0;
+		else if (sf == GL_ONE && df == GL_ONE && eq == GL_FUNC_ADD)
+			blend = 1;
+		else if (sf == GL_ONE && df == GL_ONE && eq == GL_FUNC_REVERSE_SUBTRACT)
+			blend = 2;
+		else
+			return NULL;
+	}
+#endif
+	return ZB_kernels[blend][fill * 4 + (zb->depth_write ? 2 : 0) + (zb->depth_test ? 1 : 0)];
+}
+
+#endif
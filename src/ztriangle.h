@@ -19,6 +19,12 @@ Things to keep in mind:
  7) Fewer variables is usually better
  */
 
+#if TGL_FEATURE_SMALL_TRIANGLES == 1
+#include "zsmalltri.h"
+#endif
+#if TGL_FEATURE_HALFSPACE_RASTER == 1
+#include "zhalfspace.h"
+#else
 {
 	GLfloat fdx1, fdx2, fdy1, fdy2;
 	GLushort* pz1;
@@ -26,9 +32,7 @@ Things to keep in mind:
 
 	GLint part;
 	GLint dx1, dy1, dx2, dy2;
-#if TGL_FEATURE_POLYGON_STIPPLE == 1
 	GLint the_y;
-#endif
 	GLint error, derror;
 	GLint x1, dxdy_min, dxdy_max;
 	/* warning: x2 is multiplied by 2^16 */
@@ -69,6 +73,23 @@ Things to keep in mind:
 		p2 = t;
 	}
 
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+	if (zb->depth_test && ZB_hzHidden(zb, p0, p1, p2))
+		return;
+#endif
+#if TGL_FEATURE_HIERARCHICAL_Z == 1 || TGL_FEATURE_LAZY_CLEAR == 1
+	{
+		GLint xmin = p0->x, xmax = p0->x;
+		if (p1->x < xmin) xmin = p1->x;
+		if (p1->x > xmax) xmax = p1->x;
+		if (p2->x < xmin) xmin = p2->x;
+		if (p2->x > xmax) xmax = p2->x;
+		ZB_resolveClear(zb, xmin, p0->y, xmax, p2->y);
+		if (zb->depth_write)
+			ZB_hzDirty(zb, xmin, p0->y, xmax, p2->y);
+	}
+#endif
+
 	/* we compute dXdx and dXdy for all GLinterpolated values */
 	fdx1 = p1->x - p0->x; 
 	fdy1 = p1->y - p0->y; 
@@ -167,9 +188,7 @@ Things to keep in mind:
 	/* screen coordinates */
 
 	pp1 = (PIXEL*)(zb->pbuf) + zb->xsize * p0->y; 
-#if TGL_FEATURE_POLYGON_STIPPLE == 1
 	the_y = p0->y;
-#endif
 	pz1 = zb->zbuf + p0->y * zb->xsize;
 
 	DRAW_INIT();
@@ -281,11 +300,12 @@ Things to keep in mind:
 		}						   /*End of lifetime for ZBufferpoints*/
 		/* we draw all the scan line of the part */
 
-		while (nb_lines > 0) {
+		/* lines outside of the clip rectangle are stepped over, but not drawn */
+		while (nb_lines > 0 && the_y < zb->clip_ymax) {
 			nb_lines--;
 #ifndef DRAW_LINE
 			/* generic draw line */
-			{
+			if (the_y >= zb->clip_ymin) {
 				register PIXEL* pp;
 				register GLint n;
 #ifdef INTERP_Z
@@ -303,6 +323,8 @@ Things to keep in mind:
 #endif
 
 				n = (x2 >> 16) - x1;
+				if ((x2 >> 16) >= zb->clip_xmax)
+					n = zb->clip_xmax - 1 - x1;
 				
 				pp = (PIXEL*)pp1 + x1;
 #ifdef INTERP_Z
@@ -321,6 +343,37 @@ Things to keep in mind:
 #ifdef INTERP_STZ
 
 
+#endif
+				if (x1 < zb->clip_xmin) {
+					/* skip to the clip rectangle. Same result as stepping pixel by pixel. */
+					register GLint skip = zb->clip_xmin - x1;
+					n -= skip;
+					pp += skip;
+#ifdef INTERP_Z
+					pz += skip;
+					z += skip * dzdx;
+#endif
+#ifdef INTERP_RGB
+					or1 += skip * drdx;
+					og1 += skip * dgdx;
+					ob1 += skip * dbdx;
+#endif
+#ifdef INTERP_ST
+					s += skip * dsdx;
+					t += skip * dtdx;
+#endif
+				}
+#if TGL_FEATURE_SIMD_SPANS == 1 && defined(PUT_LANE)
+				if (LANES_OK) {
+					/* the whole span at once, one lane per pixel */
+					register GLint i;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+					for (i = 0; i <= n; i++)
+						PUT_LANE(i);
+					n = -1;
+				}
 #endif
 				while (n >= 3) {
 					PUT_PIXEL(0); /*the_x++;*/
@@ -346,7 +399,8 @@ Things to keep in mind:
 				}
 			}
 #else
-			DRAW_LINE();
+			if (the_y >= zb->clip_ymin)
+				DRAW_LINE();
 #endif
 
 			/* left edge */
@@ -396,14 +450,14 @@ Things to keep in mind:
 			/* screen coordinates */
 			
 			pp1 += zb->xsize;
-#if TGL_FEATURE_POLYGON_STIPPLE == 1
 			the_y++;
-#endif
 			pz1 += zb->xsize;
 		}
 	}
 }
 
+#endif
+
 #undef INTERP_Z
 #undef INTERP_RGB
 #undef INTERP_ST
@@ -412,3 +466,5 @@ Things to keep in mind:
 #undef DRAW_INIT
 #undef DRAW_LINE
 #undef PUT_PIXEL
+#undef PUT_LANE
+#undef PUT_PIXEL8
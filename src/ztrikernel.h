@@ -0,0 +1,224 @@
+/*
+ * One state-specialized triangle kernel, see TGL_FEATURE_SPECIALIZED_KERNELS.
+ * Included by ztrikernels.h with TGL_KERNEL_BLEND (index of the blend mode, 0 = no blending) and
+ * TGL_KERNEL_STATE = fill * 4 + depth_write * 2 + depth_test (fill is ZB_FILL_FLAT, SMOOTH or TEXTURE).
+ * The pixel code is the same as the generic functions in ztriangle.c, but every per-pixel
+ * state test is on a constant, so the compiler removes it. Polygon stipple is never enabled here.
+ */
+
+#define TGL_KERNEL_DT (TGL_KERNEL_STATE & 1)
+#define TGL_KERNEL_DW ((TGL_KERNEL_STATE >> 1) & 1)
+#define TGL_KERNEL_FILL (TGL_KERNEL_STATE >> 2)
+
+#define TGL_KZCMP(z, zpix) ((!TGL_KERNEL_DT) || (z >= zpix))
+
+#if TGL_KERNEL_BLEND == 0
+#define TGL_KERNEL_BLEND_VARS /* a comment */
+#define TGL_KERNEL_WRITE(source, dest) TGL_NO_BLEND_FUNC(source, dest)
+#define TGL_KERNEL_WRITE_RGB(rr, gg, bb, dest) TGL_NO_BLEND_FUNC_RGB(rr, gg, bb, dest)
+#else
+#if TGL_KERNEL_BLEND == 1
+#define TGL_KERNEL_BLEND_VARS const GLuint zbblendeq = GL_FUNC_ADD, sfactor = GL_ONE, dfactor = GL_ONE;
+#elif TGL_KERNEL_BLEND == 2
+#define TGL_KERNEL_BLEND_VARS const GLuint zbblendeq = GL_FUNC_REVERSE_SUBTRACT, sfactor = GL_ONE, dfactor = GL_ONE;
+#endif
+#define TGL_KERNEL_WRITE(source, dest) TGL_BLEND_FUNC(source, dest)
+#define TGL_KERNEL_WRITE_RGB(rr, gg, bb, dest) TGL_BLEND_FUNC_RGB(rr, gg, bb, dest)
+#endif
+
+static void TGL_KERNEL_NAME(TGL_KERNEL_BLEND, TGL_KERNEL_STATE)(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+#if TGL_KERNEL_FILL == ZB_FILL_FLAT && TGL_KERNEL_BLEND == 0
+	PIXEL color = RGB_TO_PIXEL(p2->r, p2->g, p2->b);
+#elif TGL_KERNEL_FILL == ZB_FILL_FLAT
+	PIXEL color;
+#elif TGL_KERNEL_FILL == ZB_FILL_TEXTURE
+	ZBTexture texture;
+#endif
+	TGL_KERNEL_BLEND_VARS
+
+#define INTERP_Z
+
+#if TGL_KERNEL_FILL == ZB_FILL_FLAT
+
+/* like the generic functions, the blended flat color is taken after the vertices are sorted */
+#if TGL_KERNEL_BLEND == 0
+#define DRAW_INIT()                                                                                                                                            \
+	{}
+#else
+#define DRAW_INIT()                                                                                                                                            \
+	{ color = RGB_TO_PIXEL(p2->r, p2->g, p2->b); }
+#endif
+
+#define PUT_PIXEL(_a)                                                                                                                                          \
+	{                                                                                                                                                          \
+		{                                                                                                                                                      \
+			register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                                                                                                    \
+			if (TGL_KZCMP(zz, pz[_a])) {                                                                                                                       \
+				TGL_KERNEL_WRITE(color, (pp[_a]))                                                                                                              \
+				if (TGL_KERNEL_DW)                                                                                                                             \
+					pz[_a] = zz;                                                                                                                               \
+			}                                                                                                                                                  \
+		}                                                                                                                                                      \
+		z += dzdx;                                                                                                                                             \
+	}
+#define PUT_LANE(_i)                                                                                                                                           \
+	{                                                                                                                                                          \
+		register GLuint zz = (z + (_i) * dzdx) >> ZB_POINT_Z_FRAC_BITS;                                                                                        \
+		register GLint draw = TGL_KZCMP(zz, pz[_i]);                                                                                                           \
+		PIXEL lc = pp[_i];                                                                                                                                     \
+		TGL_KERNEL_WRITE(color, lc)                                                                                                                            \
+		pp[_i] = draw ? lc : pp[_i];                                                                                                                           \
+		if (TGL_KERNEL_DW)                                                                                                                                     \
+			pz[_i] = draw ? zz : pz[_i];                                                                                                                       \
+	}
+
+
+#elif TGL_KERNEL_FILL == ZB_FILL_SMOOTH
+
+#define INTERP_RGB
+
+#define DRAW_INIT()                                                                                                                                            \
+	{}
+
+#define PUT_PIXEL(_a)                                                                                                                                          \
+	{                                                                                                                                                          \
+		{                                                                                                                                                      \
+			register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                                                                                                    \
+			if (TGL_KZCMP(zz, pz[_a])) {                                                                                                                       \
+				TGL_KERNEL_WRITE_RGB(or1, og1, ob1, (pp[_a]));                                                                                                 \
+				if (TGL_KERNEL_DW)                                                                                                                             \
+					pz[_a] = zz;                                                                                                                               \
+			}                                                                                                                                                  \
+		}                                                                                                                                                      \
+		z += dzdx;                                                                                                                                             \
+		og1 += dgdx;                                                                                                                                           \
+		or1 += drdx;                                                                                                                                           \
+		ob1 += dbdx;                                                                                                                                           \
+	}
+#define PUT_LANE(_i)                                                                                                                                           \
+	{                                                                                                                                                          \
+		register GLuint zz = (z + (_i) * dzdx) >> ZB_POINT_Z_FRAC_BITS;                                                                                        \
+		register GLint draw = TGL_KZCMP(zz, pz[_i]);                                                                                                           \
+		register GLint lr = or1 + (_i) * drdx, lg = og1 + (_i) * dgdx, lb = ob1 + (_i) * dbdx;                                                                 \
+		PIXEL lc = pp[_i];                                                                                                                                     \
+		TGL_KERNEL_WRITE_RGB(lr, lg, lb, lc);                                                                                                                  \
+		pp[_i] = draw ? lc : pp[_i];                                                                                                                           \
+		if (TGL_KERNEL_DW)                                                                                                                                     \
+			pz[_i] = draw ? zz : pz[_i];                                                                                                                       \
+	}
+
+
+#else
+
+#define INTERP_STZ
+#define INTERP_RGB
+#define NB_INTERP 8
+
+#define DRAW_INIT()                                                                                                                                            \
+	{                                                                                                                                                          \
+		texture = zb->current_texture;                                                                                                                         \
+		fdzdx = (GLfloat)dzdx;                                                                                                                                 \
+		fndzdx = NB_INTERP * fdzdx;                                                                                                                            \
+		ndszdx = NB_INTERP * dszdx;                                                                                                                            \
+		ndtzdx = NB_INTERP * dtzdx;                                                                                                                            \
+	}
+#if TGL_FEATURE_LIT_TEXTURES == 1
+#define OR1OG1OB1DECL                                                                                                                                          \
+	register GLint or1, og1, ob1;                                                                                                                              \
+	or1 = r1;                                                                                                                                                  \
+	og1 = g1;                                                                                                                                                  \
+	ob1 = b1;
+#define OR1G1B1INCR                                                                                                                                            \
+	og1 += dgdx;                                                                                                                                               \
+	or1 += drdx;                                                                                                                                               \
+	ob1 += dbdx;
+#define OR1G1B1SKIP(_n)                                                                                                                                        \
+	og1 += (_n) * dgdx;                                                                                                                                        \
+	or1 += (_n) * drdx;                                                                                                                                        \
+	ob1 += (_n) * dbdx;
+#else
+#define OR1OG1OB1DECL /*A comment*/
+#define OR1G1B1INCR   /*Another comment*/
+#define OR1G1B1SKIP(_n) /*And another*/
+#define or1 COLOR_MULT_MASK
+#define og1 COLOR_MULT_MASK
+#define ob1 COLOR_MULT_MASK
+#endif
+
+#if TGL_FEATURE_NO_DRAW_COLOR != 1
+#define PUT_PIXEL(_a)                                                                                                                                          \
+	{                                                                                                                                                          \
+		{                                                                                                                                                      \
+			register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                                                                                                    \
+			if (TGL_KZCMP(zz, pz[_a])) {                                                                                                                       \
+				TGL_KERNEL_WRITE(RGB_MIX_FUNC(or1, og1, ob1, (TEXTURE_SAMPLE(texture, s, t))), (pp[_a]));                                                      \
+				if (TGL_KERNEL_DW)                                                                                                                             \
+					pz[_a] = zz;                                                                                                                               \
+			}                                                                                                                                                  \
+		}                                                                                                                                                      \
+		z += dzdx;                                                                                                                                             \
+		s += dsdx;                                                                                                                                             \
+		t += dtdx;                                                                                                                                             \
+		OR1G1B1INCR                                                                                                                                            \
+	}
+#else
+#define PUT_PIXEL(_a)                                                                                                                                          \
+	{                                                                                                                                                          \
+		{                                                                                                                                                      \
+			register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                                                                                                    \
+			PIXEL c = TEXTURE_SAMPLE(texture, s, t);                                                                                                           \
+			if (TGL_KZCMP(zz, pz[_a]) NODRAWTEST(c)) {                                                                                                         \
+				TGL_KERNEL_WRITE(RGB_MIX_FUNC(or1, og1, ob1, c), (pp[_a]));                                                                                    \
+				if (TGL_KERNEL_DW)                                                                                                                             \
+					pz[_a] = zz;                                                                                                                               \
+			}                                                                                                                                                  \
+		}                                                                                                                                                      \
+		z += dzdx;                                                                                                                                             \
+		s += dsdx;                                                                                                                                             \
+		t += dtdx;                                                                                                                                             \
+		OR1G1B1INCR                                                                                                                                            \
+	}
+#endif
+
+#define PUT_LANE(_i)                                                                                                                                           \
+	{                                                                                                                                                          \
+		register GLuint zz = (z + (_i) * dzdx) >> ZB_POINT_Z_FRAC_BITS;                                                                                        \
+		register GLuint ls = s + (_i) * dsdx, lt = t + (_i) * dtdx;                                                                                            \
+		PIXEL c = TEXTURE_SAMPLE(texture, ls, lt);                                                                                                             \
+		register GLint draw = TGL_KZCMP(zz, pz[_i]) NODRAWTEST(c);                                                                                             \
+		PIXEL lc = pp[_i];                                                                                                                                     \
+		TGL_KERNEL_WRITE(RGB_MIX_LANE(_i, c), lc);                                                                                                             \
+		pp[_i] = draw ? lc : pp[_i];                                                                                                                           \
+		if (TGL_KERNEL_DW)                                                                                                                                     \
+			pz[_i] = draw ? zz : pz[_i];                                                                                                                       \
+	}
+#if TGL_FEATURE_SIMD_SPANS == 1
+#define PUT_PIXEL8() PUT_PIXEL8_LANES()
+#else
+#define PUT_PIXEL8() PUT_PIXEL8_SCALAR()
+#endif
+#define DRAW_LINE()                                                                                                                                            \
+	{ DRAW_LINE_TRI_TEXTURED() }
+
+#endif
+
+#include "ztriangle.h"
+}
+
+#if TGL_KERNEL_FILL == ZB_FILL_TEXTURE
+#undef NB_INTERP
+#undef OR1OG1OB1DECL
+#undef OR1G1B1INCR
+#undef OR1G1B1SKIP
+#undef or1
+#undef og1
+#undef ob1
+#endif
+#undef TGL_KERNEL_DT
+#undef TGL_KERNEL_DW
+#undef TGL_KERNEL_FILL
+#undef TGL_KZCMP
+#undef TGL_KERNEL_BLEND_VARS
+#undef TGL_KERNEL_WRITE
+#undef TGL_KERNEL_WRITE_RGB
+#undef TGL_KERNEL_STATE
@@ -0,0 +1,31 @@
+/*
+ * All the state-specialized kernels for one blend mode, see ztrikernel.h.
+ * Included by ztriangle.c with TGL_KERNEL_BLEND defined.
+ */
+
+#define TGL_KERNEL_STATE 0
+#include "ztrikernel.h"
+#define TGL_KERNEL_STATE 1
+#include "ztrikernel.h"
+#define TGL_KERNEL_STATE 2
+#include "ztrikernel.h"
+#define TGL_KERNEL_STATE 3
+#include "ztrikernel.h"
+#define TGL_KERNEL_STATE 4
+#include "ztrikernel.h"
+#define TGL_KERNEL_STATE 5
+#include "ztrikernel.h"
+#define TGL_KERNEL_STATE 6
+#include "ztrikernel.h"
+#define TGL_KERNEL_STATE 7
+#include "ztrikernel.h"
+#define TGL_KERNEL_STATE 8
+#include "ztrikernel.h"
+#define TGL_KERNEL_STATE 9
+#include "ztrikernel.h"
+#define TGL_KERNEL_STATE 10
+#include "ztrikernel.h"
+#define TGL_KERNEL_STATE 11
+#include "ztrikernel.h"
+
+#undef TGL_KERNEL_BLEND